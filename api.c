@@ -44,6 +44,7 @@
 #include "config.h"
 #include "logger.h"
 #include "helper.h"
+#include "metrics.h"
 
 /* Import modules */
 #include "tempsensor/tempsensor_json_api.h"
@@ -52,8 +53,12 @@
 #include "gpio/gpio_json_api.h"
 #include "kunio/kunio_json_api.h"
 #include "bluecherry/bluecherry_json_api.h"
+#include "pwm/pwm_json_api.h"
 
 #include "rfid/pn532/rfid_pn532_json_api.h"
+#include "events/events_sse.h"
+#include "websocket/websocket.h"
+#include "trace.h"
 
 /* HTTP response codes */
 const struct http_response r_ok 	= { 200, "OK" };
@@ -63,7 +68,7 @@ const struct http_response r_error 	= { 500, "Internal server error" };
 /**
  * The get handlers table
  */
-const struct f_entry get_handlers[7] = {
+const struct f_entry get_handlers[9] = {
     { "wifi", 5, wifi_get_router },
     { "tempsensor", 11, tempsensor_get_router },
     { "gpio", 5, gpio_get_router },
@@ -71,23 +76,48 @@ const struct f_entry get_handlers[7] = {
     { "system", 7, system_get_router },
     { "bluecherry", 11, bluecherry_get_router },
     { "rfid", 5, rfid_pn532_get_router },
+    { "trace", 6, trace_get_records },
+    { "pwm", 4, pwm_get_router },
 };
 
+static json_object* api_post_batch(struct client *cl, char *request);
+
 /**
  * The post handlers table
  */
-const struct f_entry post_handlers[3] = {
+const struct f_entry post_handlers[5] = {
+    { "batch", 6, api_post_batch },
     { "wifi", 5, wifi_post_router },
     { "tempsensor", 11, tempsensor_post_router },
     { "bluecherry", 11, bluecherry_post_router },
+    { "gpio", 5, gpio_post_router },
 };
 
 /**
  * The put handlers table
  */
-const struct f_entry put_handlers[2] = {
+const struct f_entry put_handlers[3] = {
     { "gpio", 5, gpio_put_router },
     { "kunio", 6, kunio_put_router },
+    { "pwm", 4, pwm_put_router },
+};
+
+/**
+ * The stream handlers table, these GET handlers write their own response
+ */
+const struct f_entry stream_handlers[3] = {
+    { "events", 7, events_sse_handle_request },
+    { "metrics", 8, metrics_handle_request },
+    { "ws", 3, websocket_handle_request },
+};
+
+/**
+ * The versioned GET resources, their version changes whenever their response
+ * does. A cached response is validated without calling the handler.
+ */
+const struct v_entry version_handlers[2] = {
+    { "gpio/layout", gpio_layout_version },
+    { "wifi/scan", wifi_scan_version },
 };
 
 /* Lookup table for method handle lookup */
@@ -97,68 +127,356 @@ const struct f_entry* handlers[] = {
     [UH_HTTP_MSG_PUT] = put_handlers
 };
 
+/* Start time of the server, makes version based entity tags unique */
+static time_t api_epoch;
+
+static void write_response(struct client *cl, int code, const char *summary, const char *etag)
+{
+	/* Write header and body in one go, this ends the request */
+	client_write_response(cl, code, summary, "application/json", etag,
+		cl->response, strlen(cl->response));
+	free(cl->response);
+	cl->response = NULL;
+}
+
+/**
+ * Create the entity tag of a versioned resource.
+ * @url the request part of the url
+ * @etag buffer of API_ETAG_LEN bytes to place the entity tag in
+ * @return false when the resource has no version counter
+ */
+static bool api_version_etag(const char *url, char *etag)
+{
+	size_t i, len;
+
+	for(i = 0; i < sizeof(version_handlers)/sizeof(struct v_entry); ++i) {
+		len = strlen(version_handlers[i].name);
+		if(!strncmp(url, version_handlers[i].name, len) &&
+		   (url[len] == '\0' || url[len] == '?' || url[len] == '/')) {
+			if(!api_epoch)
+				api_epoch = time(NULL);
+			snprintf(etag, API_ETAG_LEN, "\"%lx-v%x\"",
+				(unsigned long) api_epoch, version_handlers[i].version());
+			return true;
+		}
+	}
 
-static void write_response(struct client *cl, int code, const char *summary)
+	return false;
+}
+
+/**
+ * Create the entity tag of a serialized response, a 32 bit FNV-1a hash
+ * of the body together with its length.
+ * @body the serialized response
+ * @len the length of the response
+ * @etag buffer of API_ETAG_LEN bytes to place the entity tag in
+ */
+static void api_body_etag(const char *body, size_t len, char *etag)
 {
-	/* Write response */
-	write_http_header(cl, code, summary);
-	ustream_printf(cl->us, "Content-Type: application/json\r\n");
-	ustream_printf(cl->us, "Content-Length: %i\r\n\r\n", strlen(cl->response));
-
-	/* Stop if this is a header only request */
-	if (cl->request.method == UH_HTTP_MSG_HEAD) {
-		free(cl->response);
-		request_done(cl);
-		return;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < len; ++i) {
+		hash ^= (unsigned char) body[i];
+		hash *= 16777619u;
 	}
-        
-        ustream_printf(cl->us, "%s", cl->response);
-        free(cl->response);
-        request_done(cl);
-        return;
+
+	snprintf(etag, API_ETAG_LEN, "\"%x-%x\"", (unsigned int) len, hash);
 }
 
 /**
- * Handle api requests
+ * Check the If-None-Match header of the request against an entity tag.
  * @cl the client who sent the request
- * @url the request URL
- * @pi info concerning the path
+ * @etag the entity tag of the current response
+ * @return true when the client has the current response cached
  */
-void api_handle_request(struct client *cl, char *url)
+static bool api_if_none_match(struct client *cl, const char *etag)
 {
-	json_object *response = NULL;                                       /* The response */
-        const struct f_entry* api_handler = NULL;                           /* The handler structure */
-        json_object* (*handler)(struct client *, char *request) = NULL;     /* The handler function */
+	static const struct blobmsg_policy hdr_policy = { "if-none-match", BLOBMSG_TYPE_STRING };
+	struct blob_attr *tb;
+	size_t len = strlen(etag);
+	const char *p;
+
+	blobmsg_parse(&hdr_policy, 1, &tb, blob_data(cl->hdr.head), blob_len(cl->hdr.head));
+	if(!tb)
+		return false;
+
+	/* The header holds a list of, possibly weak, entity tags or "*" */
+	for(p = blobmsg_data(tb); *p; ) {
+		while(*p == ' ' || *p == ',')
+			p++;
+		if(!strncmp(p, "W/", 2))
+			p += 2;
+
+		if(*p == '*')
+			return true;
+		if(!strncmp(p, etag, len) && (p[len] == '\0' || p[len] == ',' || p[len] == ' '))
+			return true;
+
+		while(*p && *p != ',')
+			p++;
+	}
 
-	/* Search the correct handler */
-	switch(cl->request.method) {
+	return false;
+}
+
+/**
+ * Answer a request with 304 Not Modified.
+ * @cl the client who sent the request
+ * @etag the entity tag of the current response
+ */
+static void api_not_modified(struct client *cl, const char *etag)
+{
+	metric_inc(&metric_api_not_modified);
+	client_write_response(cl, 304, "Not Modified", NULL, etag, NULL, 0);
+}
+
+/**
+ * Search the handler for a method and url and execute it.
+ * @cl the client who sent the request
+ * @method the HTTP method of the request
+ * @url the request url
+ * @offset the offset at which the method starts in the url
+ * @route receives the name of the matched handler, may be NULL
+ * @return the response of the handler, NULL when there is none
+ */
+static json_object* api_call(struct client *cl, int method, char *url, size_t offset, const char **route)
+{
+	const struct f_entry* api_handler = NULL;                           /* The handler structure */
+	json_object* (*handler)(struct client *, char *request) = NULL;     /* The handler function */
+
+	switch(method) {
 		case UH_HTTP_MSG_GET:
-			api_handler = api_get_function(url, conf->api_str_len, get_handlers, sizeof(get_handlers)/sizeof(struct f_entry));
+			api_handler = api_get_function(url, offset, get_handlers, sizeof(get_handlers)/sizeof(struct f_entry));
 			break;
 		case UH_HTTP_MSG_POST:
-			api_handler = api_get_function(url, conf->api_str_len, post_handlers, sizeof(post_handlers)/sizeof(struct f_entry));
+			api_handler = api_get_function(url, offset, post_handlers, sizeof(post_handlers)/sizeof(struct f_entry));
 			break;
 		case UH_HTTP_MSG_PUT:
-			api_handler = api_get_function(url, conf->api_str_len, put_handlers, sizeof(put_handlers)/sizeof(struct f_entry));
+			api_handler = api_get_function(url, offset, put_handlers, sizeof(put_handlers)/sizeof(struct f_entry));
 			break;
 		default:
 			api_handler = NULL;
 			break;
 	}
-        
+
 	/* If a handler is found execute it */
 	if(api_handler){
-            handler = api_handler->function;
-            response = handler(cl, url + conf->api_str_len + api_handler->url_offset);
+		if(route)
+			*route = api_handler->name;
+		handler = api_handler->function;
+		return handler(cl, url + offset + api_handler->url_offset);
 	}
 
+	return NULL;
+}
+
+/**
+ * Check a flag in the query string of a request. The flag is set when
+ * the parameter is present without a value or with a value other than
+ * "0" or "false".
+ * @request the request part of the url
+ * @name the parameter name
+ * @return true when the flag is set
+ */
+static bool api_query_flag(const char *request, const char *name)
+{
+	const char *param = strchr(request, '?');
+	size_t len = strlen(name);
+	size_t vlen;
+
+	while(param) {
+		param++;
+		if(!strncmp(param, name, len) && (param[len] == '\0' || param[len] == '&' || param[len] == '=')) {
+			if(param[len] != '=')
+				return true;
+
+			param += len + 1;
+			vlen = strcspn(param, "&");
+			return !((vlen == 1 && !strncmp(param, "0", 1)) || (vlen == 5 && !strncmp(param, "false", 5)));
+		}
+		param = strchr(param, '&');
+	}
+
+	return false;
+}
+
+/**
+ * Execute a list of API requests in one go. The body is a JSON array of
+ * operations like {"method": "PUT", "path": "gpio/state/7/1", "body": {...}}.
+ * The path is relative to the API prefix. With the "atomic" query
+ * parameter the batch stops at the first failing operation.
+ * @cl the client who sent the request
+ * @request the request part of the url
+ * @return an array with the status and body of every operation
+ */
+static json_object* api_post_batch(struct client *cl, char *request)
+{
+	json_object *ops, *op, *result, *response, *results;
+	json_object *j_method, *j_path, *j_body;
+	bool atomic = api_query_flag(request, "atomic");
+	bool failed = false;
+	char path[API_CALL_MAX_LEN + 256];
+	const char *str;
+	int method, i, n;
+
+	ops = client_get_json_body(cl);
+	if(!ops || !json_object_is_type(ops, json_type_array) ||
+	   json_object_array_length(ops) > API_BATCH_MAX) {
+		if(ops)
+			json_object_put(ops);
+		cl->http_status = r_bad_req;
+		return NULL;
+	}
+
+	results = json_object_new_array();
+	n = json_object_array_length(ops);
+	for(i = 0; i < n; ++i) {
+		op = json_object_array_get_idx(ops, i);
+		result = json_object_new_object();
+		response = NULL;
+		json_object_array_add(results, result);
+
+		/* Skip the remaining operations of a failed atomic batch */
+		if(failed) {
+			json_object_object_add(result, "status", json_object_new_int(424));
+			continue;
+		}
+
+		/* Find the method and the path of the operation */
+		method = -1;
+		if(json_object_object_get_ex(op, "method", &j_method)) {
+			str = json_object_get_string(j_method);
+			if(!strcasecmp(str, "GET"))
+				method = UH_HTTP_MSG_GET;
+			else if(!strcasecmp(str, "POST"))
+				method = UH_HTTP_MSG_POST;
+			else if(!strcasecmp(str, "PUT"))
+				method = UH_HTTP_MSG_PUT;
+		}
+
+		str = NULL;
+		if(json_object_object_get_ex(op, "path", &j_path))
+			str = json_object_get_string(j_path);
+
+		/* Accept paths with and without the API prefix */
+		if(str && helper_str_startswith((char*) str, conf->api_prefix, 0))
+			str += conf->api_str_len - 1;
+		while(str && *str == '/')
+			str++;
+
+		cl->http_status = r_bad_req;
+		if(method >= 0 && str && strlen(str) < sizeof(path) &&
+		   !helper_str_startswith((char*) str, "batch", 0)) {
+			/* The operation body is handed to the handler as request body */
+			if(json_object_object_get_ex(op, "body", &j_body)) {
+				cl->body = json_object_get(j_body);
+				json_object_object_del(op, "body");
+			}
+
+			strcpy(path, str);
+			response = api_call(cl, method, path, 0, NULL);
+
+			/* Release the body when the handler did not take it */
+			json_object_put(client_get_json_body(cl));
+		}
+
+		/* Handlers returning nothing mean the request was not supported */
+		if(!response && cl->http_status.code == r_ok.code)
+			cl->http_status = r_bad_req;
+
+		json_object_object_add(result, "status", json_object_new_int(cl->http_status.code));
+		json_object_object_add(result, "body", response);
+
+		if(atomic && cl->http_status.code != r_ok.code)
+			failed = true;
+	}
+
+	json_object_put(ops);
+	cl->http_status = r_ok;
+	return results;
+}
+
+/**
+ * Record the duration of an API request.
+ * @method the HTTP method of the request
+ * @route the name of the handler, "unknown" when there was none
+ * @start the start time of the request
+ */
+static void api_observe(int method, const char *route, uint64_t start)
+{
+	char labels[API_CALL_MAX_LEN + 32];
+	struct metric *m;
+
+	snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", route, http_methods[method]);
+	m = metrics_get(METRIC_HISTOGRAM, "dpt_api_request_duration_seconds",
+		"Duration of API requests by route and method.", labels);
+	if(m)
+		metric_observe(m, metrics_now() - start);
+}
+
+/**
+ * Handle api requests
+ * @cl the client who sent the request
+ * @url the request URL
+ * @pi info concerning the path
+ */
+void api_handle_request(struct client *cl, char *url)
+{
+	json_object *response = NULL;                                       /* The response */
+        const struct f_entry* api_handler = NULL;                           /* The handler structure */
+        bool (*stream_handler)(struct client *, char *request) = NULL;      /* The stream handler function */
+        const char *route = "unknown";                                      /* The name of the handler */
+        int method = cl->request.method;                                    /* The method of the request */
+        uint64_t start = metrics_now();                                     /* The start of the request */
+        char etag[API_ETAG_LEN];                                            /* The entity tag of the response */
+        bool versioned = false;                                             /* True when the etag is version based */
+
+	/* Stream handlers take care of the complete response */
+	if(cl->request.method == UH_HTTP_MSG_GET) {
+		api_handler = api_get_function(url, conf->api_str_len, stream_handlers, sizeof(stream_handlers)/sizeof(struct f_entry));
+		if(api_handler) {
+			stream_handler = api_handler->function;
+			if(stream_handler(cl, url + conf->api_str_len + api_handler->url_offset))
+				return;
+		}
+
+		/* Validate versioned resources before building the response */
+		versioned = api_version_etag(url + conf->api_str_len, etag);
+		if(versioned && api_if_none_match(cl, etag)) {
+			api_handler = api_get_function(url, conf->api_str_len, get_handlers, sizeof(get_handlers)/sizeof(struct f_entry));
+			api_not_modified(cl, etag);
+			api_observe(method, api_handler ? api_handler->name : route, start);
+			return;
+		}
+	}
+
+	/* Search and execute the correct handler */
+	response = api_call(cl, cl->request.method, url, conf->api_str_len, &route);
+
 	/* Write response when there is one */
 	if(response){
 		/* Get the string representation of the JSON object */
 		const char* stringResponse = json_object_to_json_string(response);
+		size_t len = strlen(stringResponse);
+
+		/* Successful GET responses can be validated by the client */
+		if(method == UH_HTTP_MSG_GET && cl->http_status.code == r_ok.code) {
+			if(!versioned)
+				api_body_etag(stringResponse, len, etag);
+
+			if(api_if_none_match(cl, etag)) {
+				json_object_put(response);
+				api_not_modified(cl, etag);
+				api_observe(method, route, start);
+				return;
+			}
+		} else {
+			etag[0] = '\0';
+		}
 
 		/* Copy the response to the response buffer */
-		cl->response = (char*) malloc((strlen(stringResponse)+1)*sizeof(char));
+		cl->response = (char*) malloc((len+1)*sizeof(char));
 		strcpy(cl->response, stringResponse);
 
 		/* Free the JSON object */
@@ -167,6 +485,7 @@ void api_handle_request(struct client *cl, char *url)
 		/* Handle bad request */
 		cl->http_status = r_bad_req;
 		const char* stringResponse = "Request not supported by server.";
+		etag[0] = '\0';
 
 		/* Copy the response to the response buffer */
 		cl->response = (char*) malloc((strlen(stringResponse)+1)*sizeof(char));
@@ -174,7 +493,8 @@ void api_handle_request(struct client *cl, char *url)
 	}
 
 	/* Write the response */
-	write_response(cl, cl->http_status.code, cl->http_status.message);
+	write_response(cl, cl->http_status.code, cl->http_status.message, etag[0] ? etag : NULL);
+	api_observe(method, route, start);
 }
 
 /**
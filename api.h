@@ -45,6 +45,14 @@ struct f_entry {
 	void* function;
 };
 
+/**
+ * Struct mapping a GET resource to the version counter of its response
+ */
+struct v_entry {
+	const char name[API_CALL_MAX_LEN];
+	unsigned int (*version)(void);
+};
+
 /**
  * Handle api requests
  * @cl the client who sent the request
@@ -0,0 +1,632 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   loadgen.c
+ * Created on October 18, 2026, 3:20 PM
+ */
+
+/*
+ * HTTP load generator for the breakout server. Every connection keeps a
+ * number of requests in flight (pipelining) on a keep-alive connection.
+ * The requests are taken round robin from a request file with lines like:
+ *
+ *     GET /index.html
+ *     PUT /api/gpio/state/7/1
+ *     POST /api/batch [{"method":"GET","path":"gpio/layout"}]
+ *
+ * The throughput and latency percentiles are reported at the end, the
+ * resident memory of the server is sampled every second when its pid is
+ * given. The TCP segments with data received from the server are taken
+ * from the TCP_INFO of every connection, so the segments per response can
+ * be compared without a packet capture.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <arpa/inet.h>
+
+#define MAX_REQUESTS    256             /* Maximum number of requests in the request file */
+#define MAX_PIPELINE    64              /* Maximum number of pipelined requests */
+#define RECV_BUF_SIZE   65536           /* Receive buffer per connection */
+
+/**
+ * A prepared request
+ */
+struct request {
+    char *data;                         /* The raw request */
+    int len;                            /* The length of the raw request */
+};
+
+/**
+ * A connection to the server
+ */
+struct conn {
+    int fd;                             /* The socket */
+    int inflight;                       /* Number of requests waiting for a response */
+    int next_req;                       /* The next request to send from the mix */
+    uint64_t sent[MAX_PIPELINE];        /* Send times of the requests in flight */
+    int sent_head;                      /* Oldest request in flight */
+    char *out;                          /* Data waiting to be sent */
+    int out_len;                        /* Length of the data waiting to be sent */
+    int out_off;                        /* Offset of the data already sent */
+    char buf[RECV_BUF_SIZE];            /* Received data */
+    int buf_len;                        /* Length of the received data */
+    long body_left;                     /* Body bytes of the current response or chunk still to skip */
+    bool chunked;                       /* The current response has a chunked body */
+    bool close;                         /* The server closes after this response */
+};
+
+/* Options */
+static const char *host = "127.0.0.1";
+static int port = 18080;
+static int concurrency = 16;
+static int pipeline = 1;
+static int duration = 10;
+static int server_pid = 0;
+static const char *request_file = NULL;
+static bool wait_server = false;
+
+/* The request mix */
+static struct request requests[MAX_REQUESTS];
+static int n_requests = 0;
+
+/* Results */
+static uint32_t *samples = NULL;
+static size_t n_samples = 0;
+static size_t samples_size = 0;
+static unsigned long errors = 0;
+static unsigned long reconnects = 0;
+static uint64_t body_bytes = 0;
+static uint64_t segments = 0;
+static struct sockaddr_in addr;
+
+/**
+ * Get a monotonic timestamp.
+ * @return the time in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Get the resident memory of a process.
+ * @param pid the process id.
+ * @return the resident memory in kB, -1 when unknown.
+ */
+static long read_rss(int pid)
+{
+    char path[64], line[256];
+    long rss = -1;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %ld", &rss) == 1)
+            break;
+    }
+
+    fclose(f);
+    return rss;
+}
+
+/**
+ * Add a request to the mix.
+ * @param method the request method.
+ * @param path the request path.
+ * @param body the request body, NULL for none.
+ */
+static void add_request(const char *method, const char *path, const char *body)
+{
+    struct request *r = &requests[n_requests++];
+    int blen = body ? strlen(body) : 0;
+
+    if (body) {
+        r->len = asprintf(&r->data, "%s %s HTTP/1.1\r\nHost: %s\r\n"
+                "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                method, path, host, blen, body);
+    } else {
+        r->len = asprintf(&r->data, "%s %s HTTP/1.1\r\nHost: %s\r\n\r\n", method, path, host);
+    }
+}
+
+/**
+ * Load the request mix from a file.
+ * @param file the request file.
+ * @return true on success.
+ */
+static bool load_requests(const char *file)
+{
+    char line[4096], method[16], path[1024];
+    int offset;
+    FILE *f;
+
+    if (file == NULL) {
+        add_request("GET", "/", NULL);
+        return true;
+    }
+
+    f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f) && n_requests < MAX_REQUESTS) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '#' || !line[0])
+            continue;
+
+        if (sscanf(line, "%15s %1023s %n", method, path, &offset) < 2) {
+            fprintf(stderr, "Malformed request line: %s\n", line);
+            continue;
+        }
+
+        add_request(method, path, line[offset] ? line + offset : NULL);
+    }
+
+    fclose(f);
+    return n_requests > 0;
+}
+
+/**
+ * Record a latency sample.
+ * @param ns the latency in nanoseconds.
+ */
+static void add_sample(uint64_t ns)
+{
+    if (n_samples == samples_size) {
+        samples_size = samples_size ? samples_size * 2 : 65536;
+        samples = realloc(samples, samples_size * sizeof(*samples));
+    }
+
+    /* Samples are stored in microseconds */
+    samples[n_samples++] = ns / 1000;
+}
+
+/**
+ * Count the segments with data received on a connection before it is
+ * closed, the handshake and bare acknowledgements are not counted.
+ * @param c the connection.
+ */
+static void conn_count_segments(struct conn *c)
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    memset(&info, 0, sizeof(info));
+    if (getsockopt(c->fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+        segments += info.tcpi_data_segs_in;
+}
+
+/**
+ * Open the connection to the server.
+ * @param c the connection.
+ * @return true on success.
+ */
+static bool conn_open(struct conn *c)
+{
+    int one = 1;
+
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0)
+        return false;
+
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return false;
+    }
+
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+    c->inflight = 0;
+    c->sent_head = 0;
+    c->buf_len = 0;
+    c->body_left = 0;
+    c->chunked = false;
+    c->close = false;
+    c->out_len = 0;
+    c->out_off = 0;
+
+    return true;
+}
+
+/**
+ * Queue requests until the pipeline is full.
+ * @param c the connection.
+ */
+static void conn_fill(struct conn *c)
+{
+    uint64_t now = now_ns();
+    int len = c->out_len - c->out_off;
+
+    /* Keep unsent data in front */
+    memmove(c->out, c->out + c->out_off, len);
+    c->out_off = 0;
+    c->out_len = len;
+
+    while (c->inflight < pipeline) {
+        struct request *r = &requests[c->next_req];
+
+        c->next_req = (c->next_req + 1) % n_requests;
+        memcpy(c->out + c->out_len, r->data, r->len);
+        c->out_len += r->len;
+        c->sent[(c->sent_head + c->inflight) % MAX_PIPELINE] = now;
+        c->inflight++;
+    }
+}
+
+/**
+ * Write the queued requests.
+ * @param c the connection.
+ * @return false when the connection failed.
+ */
+static bool conn_write(struct conn *c)
+{
+    while (c->out_off < c->out_len) {
+        ssize_t n = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+
+        if (n < 0)
+            return errno == EAGAIN;
+
+        c->out_off += n;
+    }
+
+    return true;
+}
+
+/**
+ * Complete the oldest response in flight.
+ * @param c the connection.
+ */
+static void conn_complete(struct conn *c)
+{
+    add_sample(now_ns() - c->sent[c->sent_head]);
+    c->sent_head = (c->sent_head + 1) % MAX_PIPELINE;
+    c->inflight--;
+}
+
+/**
+ * Parse the received responses, both Content-Length and chunked bodies.
+ * @param c the connection.
+ * @return the number of completed responses, -1 on a protocol error.
+ */
+static int conn_parse(struct conn *c)
+{
+    int done = 0;
+    int off = 0;
+
+    c->buf[c->buf_len] = 0;
+
+    while (off < c->buf_len) {
+        char *hdr = c->buf + off;
+        char *end, *cl;
+        int status;
+
+        /* Skip the body of the current response or chunk */
+        if (c->body_left) {
+            long skip = c->body_left < c->buf_len - off ? c->body_left : c->buf_len - off;
+
+            c->body_left -= skip;
+            off += skip;
+            if (c->body_left)
+                break;
+
+            if (!c->chunked) {
+                done++;
+                conn_complete(c);
+            }
+            continue;
+        }
+
+        /* The next chunk size line, the last chunk ends with the trailers */
+        if (c->chunked) {
+            char *eol = strstr(hdr, "\r\n");
+            char *ptr;
+            long size;
+
+            if (eol == NULL)
+                break;
+
+            size = strtol(hdr, &ptr, 16);
+            if (ptr == hdr || size < 0)
+                return -1;
+
+            if (size) {
+                /* The chunk data is followed by a CRLF */
+                c->body_left = size + 2;
+                body_bytes += size;
+                off = eol + 2 - c->buf;
+                continue;
+            }
+
+            if (!strncmp(eol + 2, "\r\n", 2)) {
+                end = eol + 4;
+            } else {
+                end = strstr(eol + 2, "\r\n\r\n");
+                if (end == NULL)
+                    break;
+                end += 4;
+            }
+
+            off = end - c->buf;
+            c->chunked = false;
+            done++;
+            conn_complete(c);
+            continue;
+        }
+
+        /* Wait for the complete header */
+        end = strstr(hdr, "\r\n\r\n");
+        if (end == NULL)
+            break;
+        *end = 0;
+
+        if (sscanf(hdr, "HTTP/1.%*d %d", &status) != 1)
+            return -1;
+        if (status >= 500)
+            errors++;
+
+        cl = strcasestr(hdr, "\r\nContent-Length:");
+        c->body_left = cl ? strtol(cl + 17, NULL, 10) : 0;
+        c->chunked = strcasestr(hdr, "\r\nTransfer-Encoding: chunked") != NULL;
+        if (c->chunked)
+            c->body_left = 0;
+        body_bytes += c->body_left;
+        if (strcasestr(hdr, "\r\nConnection: close"))
+            c->close = true;
+
+        /* Restore the terminator, chunk parsing searches past it */
+        *end = '\r';
+        off = end + 4 - c->buf;
+
+        /* Responses without body are complete now */
+        if (!c->body_left && !c->chunked) {
+            done++;
+            conn_complete(c);
+        }
+    }
+
+    memmove(c->buf, c->buf + off, c->buf_len - off);
+    c->buf_len -= off;
+
+    return done;
+}
+
+/**
+ * Print the usage of the load generator.
+ * @param name the program name.
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-H host] [-p port] [-c connections] [-P pipeline]\n"
+            "          [-d seconds] [-f requestfile] [-r serverpid] [-w]\n", name);
+}
+
+/**
+ * Compare two samples for sorting.
+ */
+static int cmp_sample(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Get a percentile of the sorted samples.
+ * @param p the percentile, between 0 and 1.
+ * @return the sample in microseconds.
+ */
+static uint32_t percentile(double p)
+{
+    size_t i = (size_t) (p * n_samples);
+
+    if (i >= n_samples)
+        i = n_samples - 1;
+
+    return samples[i];
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event ev, events[64];
+    struct conn *conns;
+    struct hostent *he;
+    uint64_t start, end, next_report;
+    unsigned long last_samples = 0;
+    long rss, max_rss = -1;
+    int ep, opt, i, n, second = 0;
+
+    while ((opt = getopt(argc, argv, "H:p:c:P:d:f:r:w")) != -1) {
+        switch (opt) {
+        case 'H': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'c': concurrency = atoi(optarg); break;
+        case 'P': pipeline = atoi(optarg); break;
+        case 'd': duration = atoi(optarg); break;
+        case 'f': request_file = optarg; break;
+        case 'r': server_pid = atoi(optarg); break;
+        case 'w': wait_server = true; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (concurrency < 1 || pipeline < 1 || pipeline > MAX_PIPELINE || duration < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    he = gethostbyname(host);
+    if (he == NULL) {
+        fprintf(stderr, "Unknown host %s\n", host);
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    memcpy(&addr.sin_addr, he->h_addr_list[0], sizeof(addr.sin_addr));
+
+    if (!load_requests(request_file))
+        return EXIT_FAILURE;
+
+    conns = calloc(concurrency, sizeof(*conns));
+    ep = epoll_create1(0);
+
+    /* Wait up to five seconds for the server to come up */
+    for (i = 0; i < concurrency; ++i) {
+        struct conn *c = &conns[i];
+        int tries = wait_server ? 50 : 1;
+
+        while (!conn_open(c) && --tries)
+            usleep(100000);
+
+        if (c->fd < 0) {
+            perror("connect");
+            return EXIT_FAILURE;
+        }
+
+        c->out = malloc(MAX_PIPELINE * 4096 * 2);
+        c->next_req = i % n_requests;
+        conn_fill(c);
+        conn_write(c);
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    printf("%d connections, pipeline %d, %d requests in the mix, %d seconds\n",
+            concurrency, pipeline, n_requests, duration);
+
+    start = now_ns();
+    end = start + (uint64_t) duration * 1000000000ULL;
+    next_report = start + 1000000000ULL;
+
+    while (now_ns() < end) {
+        n = epoll_wait(ep, events, 64, 100);
+
+        for (i = 0; i < n; ++i) {
+            struct conn *c = events[i].data.ptr;
+            ssize_t r = read(c->fd, c->buf + c->buf_len, RECV_BUF_SIZE - 1 - c->buf_len);
+
+            if (r < 0 && errno == EAGAIN)
+                continue;
+
+            if (r > 0) {
+                c->buf_len += r;
+                if (conn_parse(c) < 0)
+                    r = 0;
+            }
+
+            /* Reconnect when the server closed or failed the connection */
+            if (r <= 0 || (c->close && !c->inflight)) {
+                if (r <= 0)
+                    errors++;
+                epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                conn_count_segments(c);
+                close(c->fd);
+                reconnects++;
+                if (!conn_open(c))
+                    return EXIT_FAILURE;
+
+                ev.events = EPOLLIN;
+                ev.data.ptr = c;
+                epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+            }
+
+            if (c->inflight < pipeline && !c->close) {
+                conn_fill(c);
+                if (!conn_write(c))
+                    errors++;
+            }
+        }
+
+        /* Report progress every second */
+        if (now_ns() >= next_report) {
+            rss = server_pid ? read_rss(server_pid) : -1;
+            if (rss > max_rss)
+                max_rss = rss;
+
+            printf("%3d s: %8lu req/s", ++second, (unsigned long) (n_samples - last_samples));
+            if (rss >= 0)
+                printf(", server RSS %ld kB", rss);
+            printf("\n");
+
+            last_samples = n_samples;
+            next_report += 1000000000ULL;
+        }
+    }
+
+    if (!n_samples) {
+        fprintf(stderr, "No responses received\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < concurrency; ++i)
+        conn_count_segments(&conns[i]);
+
+    qsort(samples, n_samples, sizeof(*samples), cmp_sample);
+
+    printf("\nrequests:   %zu\n", n_samples);
+    printf("throughput: %.0f req/s\n", n_samples / ((now_ns() - start) / 1e9));
+    printf("errors:     %lu\n", errors);
+    printf("reconnects: %lu\n", reconnects);
+    printf("body bytes: %llu\n", (unsigned long long) body_bytes);
+    printf("segments:   %.2f per response\n", (double) segments / n_samples);
+    printf("latency:    p50 %u us, p99 %u us, p999 %u us, max %u us\n",
+            percentile(0.5), percentile(0.99), percentile(0.999), samples[n_samples - 1]);
+    if (max_rss >= 0)
+        printf("server RSS: %ld kB max\n", max_rss);
+
+    return EXIT_SUCCESS;
+}
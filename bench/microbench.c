@@ -0,0 +1,556 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   microbench.c
+ * Created on October 18, 2026, 9:30 AM
+ */
+
+/*
+ * Microbenchmarks for the functions that run on every request. Every
+ * benchmark is measured twice:
+ *
+ *   warm  the operation runs in a tight loop, the caches hold the code and
+ *         the input data. The loop is timed as a whole.
+ *   cold  a buffer larger than the last level cache is walked before every
+ *         operation, which is then timed on its own. Expect the overhead of
+ *         the clock itself (tens of nanoseconds) in these numbers.
+ *
+ * Cycles are read from the hardware cycle counter through perf_event_open,
+ * they are reported as "-" when the kernel does not allow it.
+ *
+ * The static functions of file.c and client.c are reached by including
+ * those files, the benchmark is linked with the other server sources.
+ *
+ * The GPIO cases compare the cached sysfs descriptors with opening the
+ * file for every operation. They need a hardware root (-r), for example
+ * the tree of a running hwsim. The gpio_toggle cases compare a sysfs
+ * write with a write to the set or clear register of the GPIO block.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "../file.c"
+#include "../client.c"
+#include "../helper.h"
+#include "../gpio/gpio.h"
+#include "../gpio/gpio_mmio.h"
+
+#define BENCH_MIN_TIME      200000000LL         /* Minimum duration of a warm run in nanoseconds */
+#define BENCH_COLD_RUNS     200                 /* Number of cold operations */
+#define BENCH_EVICT_SIZE    (16 * 1024 * 1024)  /* Cache eviction buffer size */
+
+/** Globals normally defined in main.c */
+char uh_buf[WORKING_BUFF_SIZE] = { 0 };
+struct ubus_context *ubus_ctx = NULL;
+
+/**
+ * A benchmark case
+ */
+struct bench {
+    const char *name;                   /* Name of the function under test */
+    const char *variant;                /* Description of the input */
+    void (*setup)(struct bench *b);     /* Prepare the input, may be NULL */
+    void (*run)(struct bench *b);       /* Perform the operation once */
+    const void *arg;                    /* Case specific input */
+    int size;                           /* Case specific input size */
+    bool hardware;                      /* Needs a hardware root, see -r */
+};
+
+/** Result sink so the compiler cannot drop the operations */
+static volatile uintptr_t sink;
+
+/** Cycle counter file descriptor, -1 when not available */
+static int cycles_fd = -1;
+
+/** Cache eviction buffer */
+static unsigned char *evict_buf;
+
+/** Input and output buffers shared by the cases */
+static char in_buf[16384];
+static char out_buf[65536];
+static char **str_array;
+static int str_count;
+static char *serialized;
+static int b64_len;
+static struct client bench_client;
+static config bench_conf;
+
+/**
+ * Get a monotonic timestamp. 
+ * @return the time in nanoseconds. 
+ */
+static long long bench_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Read the cycle counter of this thread. 
+ * @return the number of cycles, 0 when not available. 
+ */
+static long long bench_cycles(void)
+{
+    long long cycles = 0;
+
+    if(cycles_fd >= 0 && read(cycles_fd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        cycles = 0;
+    }
+
+    return cycles;
+}
+
+/**
+ * Open the hardware cycle counter for this thread. 
+ */
+static void bench_open_cycles(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    cycles_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Walk the eviction buffer so the caches no longer hold the benchmark data. 
+ */
+static void bench_evict(void)
+{
+    unsigned long sum = 0;
+    int i;
+
+    for(i = 0; i < BENCH_EVICT_SIZE; i += 64) {
+        evict_buf[i]++;
+        sum += evict_buf[i];
+    }
+    sink = sum;
+}
+
+/**
+ * Fill the input buffer with a repeating pattern. 
+ * @param pattern the pattern to repeat. 
+ * @param len the number of bytes to fill. 
+ */
+static void fill_input(const char *pattern, int len)
+{
+    int plen = strlen(pattern);
+    int i;
+
+    for(i = 0; i < len; ++i) {
+        in_buf[i] = pattern[i % plen];
+    }
+    in_buf[len] = '\0';
+}
+
+static void setup_plain(struct bench *b)
+{
+    fill_input("abcdefghijklmnopqrstuvwxyz0123456789", b->size);
+}
+
+static void setup_escaped(struct bench *b)
+{
+    fill_input("%2Fpath%20with%3Fquery%26", b->size);
+}
+
+static void setup_binary(struct bench *b)
+{
+    fill_input("\x01\xfe/ ?&=%\x80", b->size);
+}
+
+static void setup_b64(struct bench *b)
+{
+    char raw[sizeof(in_buf)];
+    int i;
+
+    for(i = 0; i < b->size; ++i) {
+        raw[i] = i * 7;
+    }
+    b64_len = uh_b64encode(in_buf, sizeof(in_buf), raw, b->size);
+}
+
+static void run_urldecode(struct bench *b)
+{
+    sink = uh_urldecode(out_buf, sizeof(out_buf), in_buf, b->size);
+}
+
+static void run_urlencode(struct bench *b)
+{
+    sink = uh_urlencode(out_buf, sizeof(out_buf), in_buf, b->size);
+}
+
+static void run_b64encode(struct bench *b)
+{
+    sink = uh_b64encode(out_buf, sizeof(out_buf), in_buf, b->size);
+}
+
+static void run_b64decode(struct bench *b)
+{
+    sink = uh_b64decode(out_buf, sizeof(out_buf), in_buf, b64_len);
+}
+
+static void run_canonpath(struct bench *b)
+{
+    sink = (uintptr_t) canonpath((const char*) b->arg, out_buf);
+}
+
+static void run_mime_lookup(struct bench *b)
+{
+    sink = (uintptr_t) file_mime_lookup((const char*) b->arg);
+}
+
+static void run_startswith(struct bench *b)
+{
+    sink = helper_str_startswith(in_buf, (const char*) b->arg, 0);
+}
+
+static void setup_startswith(struct bench *b)
+{
+    fill_input((const char*) b->arg, b->size);
+}
+
+static void setup_str_array(struct bench *b)
+{
+    char item[32];
+    int i;
+
+    for(i = 0; i < str_count; ++i) {
+        free(str_array[i]);
+    }
+
+    str_array = realloc(str_array, b->size * sizeof(char*));
+    for(i = 0; i < b->size; ++i) {
+        snprintf(item, sizeof(item), "ssid-network-%d", i);
+        str_array[i] = strdup(item);
+    }
+    str_count = b->size;
+
+    free(serialized);
+    serialized = helper_serialize_str_array(str_array, b->size);
+}
+
+static void run_serialize(struct bench *b)
+{
+    char *s = helper_serialize_str_array(str_array, b->size);
+    sink = (uintptr_t) s;
+    free(s);
+}
+
+static void run_unserialize(struct bench *b)
+{
+    /* The input is tokenised in place */
+    char *s = strdup(serialized);
+    struct chararray *arr = helper_unserialize_str_array(s);
+    sink = arr->len;
+    helper_free_char_array(arr);
+    free(s);
+}
+
+/** A typical browser request header */
+static const char * const header_lines[] = {
+    "Host: 192.168.1.1",
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36",
+    "Accept: application/json, text/plain, */*",
+    "Accept-Language: en-US,en;q=0.9,nl;q=0.8",
+    "Accept-Encoding: gzip, deflate",
+    "Connection: keep-alive",
+    "Referer: http://192.168.1.1/index.html",
+    "Content-Length: 0",
+    "If-None-Match: \"1a2b-5f3e-65f0a1b2\"",
+    "Cache-Control: no-cache",
+    NULL
+};
+
+static void run_parse_header(struct bench *b)
+{
+    char line[256];
+    int i;
+
+    /* The parser lowercases and splits the line in place */
+    blob_buf_init(&bench_client.hdr, 0);
+    memset(&bench_client.request, 0, sizeof(bench_client.request));
+    for(i = 0; header_lines[i]; ++i) {
+        strcpy(line, header_lines[i]);
+        client_parse_header(&bench_client, line);
+    }
+    sink = bench_client.request.ua;
+}
+
+static void setup_gpio(struct bench *b)
+{
+    gpio_claim(b->size, "bench", GPIO_SHARED);
+    gpio_set_direction(b->size, GPIO_OUT);
+}
+
+static void run_gpio_get_state(struct bench *b)
+{
+    sink = gpio_get_state(b->size);
+}
+
+static void run_gpio_set_state(struct bench *b)
+{
+    sink = gpio_set_state(b->size, GPIO_HIGH);
+}
+
+/* The uncached access, opening the sysfs file for every operation */
+static void run_gpio_get_open(struct bench *b)
+{
+    char path[PATH_MAX];
+    char state = 0;
+    int fd;
+
+    helper_hw_path(path, sizeof(path), "/sys/class/gpio/gpio%d/value", b->size);
+    fd = open(path, O_RDONLY);
+    if(fd >= 0) {
+        sink = read(fd, &state, 1);
+        close(fd);
+    }
+    sink = state;
+}
+
+static void run_gpio_set_open(struct bench *b)
+{
+    char path[PATH_MAX];
+    int fd;
+
+    helper_hw_path(path, sizeof(path), "/sys/class/gpio/gpio%d/value", b->size);
+    fd = open(path, O_WRONLY);
+    if(fd >= 0) {
+        sink = write(fd, "1", 1);
+        close(fd);
+    }
+}
+
+static void setup_gpio_mmio(struct bench *b)
+{
+    static bool mapped = false;
+
+    if(!mapped) {
+        mapped = gpio_mmio_open("ar9331");
+    }
+    gpio_mmio_set_direction(b->size, GPIO_OUT);
+}
+
+static void run_gpio_toggle(struct bench *b)
+{
+    static int state = GPIO_LOW;
+
+    state = state == GPIO_LOW ? GPIO_HIGH : GPIO_LOW;
+    sink = gpio_set_state(b->size, state);
+}
+
+static void run_gpio_toggle_mmio(struct bench *b)
+{
+    static uint32_t states = 0;
+
+    states ^= GPIO_MASK(b->size);
+    gpio_mmio_set_states(GPIO_MASK(b->size), states);
+}
+
+/** All benchmark cases */
+static struct bench benches[] = {
+    { "uh_urldecode", "plain 16B", setup_plain, run_urldecode, NULL, 16 },
+    { "uh_urldecode", "plain 256B", setup_plain, run_urldecode, NULL, 256 },
+    { "uh_urldecode", "plain 4KiB", setup_plain, run_urldecode, NULL, 4096 },
+    { "uh_urldecode", "escaped 256B", setup_escaped, run_urldecode, NULL, 256 },
+    { "uh_urldecode", "escaped 4KiB", setup_escaped, run_urldecode, NULL, 4096 },
+    { "uh_urlencode", "plain 256B", setup_plain, run_urlencode, NULL, 256 },
+    { "uh_urlencode", "binary 256B", setup_binary, run_urlencode, NULL, 256 },
+    { "uh_urlencode", "binary 4KiB", setup_binary, run_urlencode, NULL, 4096 },
+    { "uh_b64encode", "16B", setup_plain, run_b64encode, NULL, 16 },
+    { "uh_b64encode", "4KiB", setup_plain, run_b64encode, NULL, 4096 },
+    { "uh_b64decode", "16B", setup_b64, run_b64decode, NULL, 16 },
+    { "uh_b64decode", "4KiB", setup_b64, run_b64decode, NULL, 4096 },
+    { "canonpath", "short", NULL, run_canonpath, "/www/index.html", 0 },
+    { "canonpath", "dot segments", NULL, run_canonpath, "/www/./js//lib/../app/./../../css/style.css", 0 },
+    { "canonpath", "deep", NULL, run_canonpath, "/www/a/b/c/d/e/f/g/h/i/j/k/l/m/n/o/p/q/r/s/t/u/v/w/x/y/z/file.txt", 0 },
+    { "file_mime_lookup", "first entry", NULL, run_mime_lookup, "/www/docs/readme.txt", 0 },
+    { "file_mime_lookup", "html", NULL, run_mime_lookup, "/www/index.html", 0 },
+    { "file_mime_lookup", "js", NULL, run_mime_lookup, "/www/js/app.js", 0 },
+    { "file_mime_lookup", "unknown", NULL, run_mime_lookup, "/www/firmware/image.bin.unknown", 0 },
+    { "helper_serialize_str_array", "2 items", setup_str_array, run_serialize, NULL, 2 },
+    { "helper_serialize_str_array", "16 items", setup_str_array, run_serialize, NULL, 16 },
+    { "helper_serialize_str_array", "128 items", setup_str_array, run_serialize, NULL, 128 },
+    { "helper_unserialize_str_array", "2 items", setup_str_array, run_unserialize, NULL, 2 },
+    { "helper_unserialize_str_array", "16 items", setup_str_array, run_unserialize, NULL, 16 },
+    { "helper_unserialize_str_array", "128 items", setup_str_array, run_unserialize, NULL, 128 },
+    { "helper_str_startswith", "4B prefix", setup_startswith, run_startswith, "gpio", 64 },
+    { "helper_str_startswith", "40B prefix", setup_startswith, run_startswith, "wifi/scan/networks/available/ssid/detail", 64 },
+    { "client_parse_header", "10 lines", NULL, run_parse_header, NULL, 0 },
+    { "gpio_get_state", "cached fd", setup_gpio, run_gpio_get_state, NULL, 7, true },
+    { "gpio_get_state", "open/close", setup_gpio, run_gpio_get_open, NULL, 7, true },
+    { "gpio_set_state", "cached fd", setup_gpio, run_gpio_set_state, NULL, 7, true },
+    { "gpio_set_state", "open/close", setup_gpio, run_gpio_set_open, NULL, 7, true },
+    { "gpio_toggle", "sysfs", setup_gpio, run_gpio_toggle, NULL, 7, true },
+    { "gpio_toggle", "registers", setup_gpio_mmio, run_gpio_toggle_mmio, NULL, 7, true },
+};
+
+/**
+ * Run a benchmark case with warm caches. 
+ * @param b the case to run. 
+ * @param ns the time per operation in nanoseconds. 
+ * @param cycles the cycles per operation. 
+ */
+static void bench_warm(struct bench *b, double *ns, double *cycles)
+{
+    long long iterations = 16;
+    long long start, end, c_start, c_end, i;
+
+    /* Warm up and find an iteration count that runs long enough */
+    while(true) {
+        c_start = bench_cycles();
+        start = bench_ns();
+        for(i = 0; i < iterations; ++i) {
+            b->run(b);
+        }
+        end = bench_ns();
+        c_end = bench_cycles();
+
+        if(end - start >= BENCH_MIN_TIME) {
+            break;
+        }
+        iterations *= end - start < BENCH_MIN_TIME / 16 ? 16 : 2;
+    }
+
+    *ns = (double) (end - start) / iterations;
+    *cycles = (double) (c_end - c_start) / iterations;
+}
+
+/**
+ * Run a benchmark case with cold caches. 
+ * @param b the case to run. 
+ * @param ns the time per operation in nanoseconds. 
+ * @param cycles the cycles per operation. 
+ */
+static void bench_cold(struct bench *b, double *ns, double *cycles)
+{
+    long long total = 0, c_total = 0, start, c_start;
+    int i;
+
+    for(i = 0; i < BENCH_COLD_RUNS; ++i) {
+        bench_evict();
+        c_start = bench_cycles();
+        start = bench_ns();
+        b->run(b);
+        total += bench_ns() - start;
+        c_total += bench_cycles() - c_start;
+    }
+
+    *ns = (double) total / BENCH_COLD_RUNS;
+    *cycles = (double) c_total / BENCH_COLD_RUNS;
+}
+
+/**
+ * Print one result line. 
+ */
+static void bench_report(struct bench *b, const char *mode, double ns, double cycles)
+{
+    if(cycles_fd >= 0) {
+        printf("%-30s %-16s %-5s %12.1f %12.1f\n", b->name, b->variant, mode, ns, cycles);
+    } else {
+        printf("%-30s %-16s %-5s %12.1f %12s\n", b->name, b->variant, mode, ns, "-");
+    }
+}
+
+/**
+ * Print the usage of the microbenchmarks.
+ * @param name the program name.
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-f filter] [-w] [-r hardware root]\n"
+            "  -f  only run functions whose name contains the filter\n"
+            "  -w  only run with warm caches\n"
+            "  -r  run the GPIO cases against a tree made by hwsim\n", name);
+}
+
+/**
+ * Microbenchmark entry point. 
+ */
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    bool warm_only = false;
+    double ns, cycles;
+    size_t i;
+    int opt;
+
+    while((opt = getopt(argc, argv, "f:wr:")) != -1) {
+        switch(opt) {
+            case 'f': filter = optarg; break;
+            case 'w': warm_only = true; break;
+            case 'r': bench_conf.hardware_root = optarg; conf = &bench_conf; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    evict_buf = calloc(1, BENCH_EVICT_SIZE);
+    if(!evict_buf) {
+        return EXIT_FAILURE;
+    }
+    bench_open_cycles();
+
+    printf("%-30s %-16s %-5s %12s %12s\n", "function", "input", "cache", "ns/op", "cycles/op");
+    for(i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+        struct bench *b = &benches[i];
+
+        if((filter && !strstr(b->name, filter)) || (b->hardware && !conf)) {
+            continue;
+        }
+
+        if(b->setup) {
+            b->setup(b);
+        }
+
+        bench_warm(b, &ns, &cycles);
+        bench_report(b, "warm", ns, cycles);
+
+        if(!warm_only) {
+            bench_cold(b, &ns, &cycles);
+            bench_report(b, "cold", ns, cycles);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
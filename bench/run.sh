@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Start the hardware simulator and the breakout server on a loopback port
+# with the bench docroot and a stub configuration, then run the load
+# generator against it.
+#
+# Usage: run.sh <server binary> <loadgen binary> <hwsim binary> [loadgen options]
+
+SERVER="$1"
+LOADGEN="$2"
+HWSIM="$3"
+shift 3
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+PORT=${BENCH_PORT:-18080}
+WORK=$(mktemp -d)
+
+# The docroot gets a generated script of about 16 kB next to the page
+mkdir -p "$WORK/www"
+cp "$BENCH_DIR/www/"* "$WORK/www/"
+awk 'BEGIN {
+    print "/* Generated filler script for the load test, about 16 kB */"
+    for (i = 0; i < 375; i++)
+        printf "function f%d(a, b) { return a * %d + b; }\n", i, (i * 7919) % 1000
+}' > "$WORK/www/app.js"
+
+sed -e "s|@PORT@|$PORT|" \
+    -e "s|@DOCROOT@|$WORK/www|" \
+    -e "s|@DATABASE@|$WORK/bench.db|" \
+    -e "s|@HWROOT@|$WORK/hw|" \
+    "$BENCH_DIR/bench.json.in" > "$WORK/bench.json"
+
+"$HWSIM" "$WORK/hw" > "$WORK/hwsim.log" 2>&1 &
+SIM=$!
+
+# Wait for the simulated tree before the server touches it
+while [ ! -e "$WORK/hw/dev/spidev0.1" ] && kill -0 "$SIM" 2>/dev/null; do
+    sleep 0.1
+done
+
+"$SERVER" "$WORK/bench.json" > "$WORK/server.log" 2>&1 &
+PID=$!
+
+"$LOADGEN" -w -p "$PORT" -r "$PID" -f "$BENCH_DIR/requests.txt" "$@"
+RC=$?
+
+kill "$PID" "$SIM" 2>/dev/null
+wait "$PID" "$SIM" 2>/dev/null
+rm -rf "$WORK"
+
+exit $RC
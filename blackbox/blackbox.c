@@ -0,0 +1,176 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   blackbox.c
+ * Created on October 18, 2026, 4:45 PM
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "blackbox.h"
+
+/** Event descriptions for the decoder */
+const struct blackbox_event_info blackbox_events[__BB_MAX] = {
+    [BB_START] = { "start", { "pid", "entries" } },
+    [BB_CRASH] = { "crash", { "signal", "address" } },
+    [BB_ACCEPT] = { "accept", { "client", "port", "clients" } },
+    [BB_REQUEST] = { "request", { "client", "method", "status" } },
+    [BB_CLOSE] = { "close", { "client", "requests" } },
+    [BB_LONGRUNNER] = { "longrunner", { "runner", "duration_us" } },
+    [BB_GPIO_STATE] = { "gpio_state", { "pin", "state" } },
+    [BB_GPIO_DIR] = { "gpio_dir", { "pin", "direction" } },
+    [BB_I2C_ERROR] = { "i2c_error", { "bus", "errno" } },
+    [BB_PWM] = { "pwm", { "pin", "frequency", "duty" } },
+};
+
+/** The mapped blackbox, NULL when not recording */
+static struct blackbox_header *header;
+static struct blackbox_entry *ring;
+
+/** Cached thread id of the calling thread */
+static __thread uint16_t thread_id;
+
+/* Signals recorded as crash */
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+/**
+ * Record a fatal signal and let it take its default action.
+ */
+static void blackbox_crash(int sig, siginfo_t *info, void *context)
+{
+    blackbox_record(BB_CRASH, sig, (uint32_t) (uintptr_t) info->si_addr, 0);
+    raise(sig);
+}
+
+/**
+ * Map the blackbox file and start recording. An existing ring with the
+ * same layout is continued so the history before a crash is kept.
+ * @param path the file to map, preferably on a RAM backed filesystem.
+ * @return true on success.
+ */
+bool blackbox_init(const char *path)
+{
+    size_t size = sizeof(struct blackbox_header) + BLACKBOX_ENTRIES * sizeof(struct blackbox_entry);
+    struct timespec mono, real;
+    struct sigaction sa;
+    void *map;
+    size_t i;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    ring = (struct blackbox_entry*) ((struct blackbox_header*) map + 1);
+
+    /* Start over when the file holds something else */
+    if (((struct blackbox_header*) map)->magic != BLACKBOX_MAGIC ||
+        ((struct blackbox_header*) map)->version != BLACKBOX_VERSION ||
+        ((struct blackbox_header*) map)->entries != BLACKBOX_ENTRIES) {
+        memset(map, 0, size);
+        ((struct blackbox_header*) map)->magic = BLACKBOX_MAGIC;
+        ((struct blackbox_header*) map)->version = BLACKBOX_VERSION;
+        ((struct blackbox_header*) map)->entries = BLACKBOX_ENTRIES;
+    }
+
+    /* Remember how to turn the monotonic timestamps into wall clock time */
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    ((struct blackbox_header*) map)->offset_sec = real.tv_sec - mono.tv_sec;
+    ((struct blackbox_header*) map)->offset_usec = (real.tv_nsec - mono.tv_nsec) / 1000;
+
+    __atomic_store_n(&header, (struct blackbox_header*) map, __ATOMIC_RELEASE);
+
+    /* Record fatal signals before the process goes down */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = blackbox_crash;
+    sa.sa_flags = SA_SIGINFO | SA_RESETHAND;
+    sigemptyset(&sa.sa_mask);
+    for (i = 0; i < sizeof(crash_signals) / sizeof(crash_signals[0]); ++i)
+        sigaction(crash_signals[i], &sa, NULL);
+
+    blackbox_record(BB_START, getpid(), BLACKBOX_ENTRIES, 0);
+    return true;
+}
+
+/**
+ * Append an entry to the blackbox. This never blocks and can be called
+ * from any thread and from signal handlers.
+ * @param event the blackbox event.
+ * @param a0 the first argument.
+ * @param a1 the second argument.
+ * @param a2 the third argument.
+ */
+void blackbox_record(enum blackbox_event event, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    struct blackbox_header *hdr = __atomic_load_n(&header, __ATOMIC_ACQUIRE);
+    struct blackbox_entry *e;
+    struct timespec ts;
+    uint32_t pos;
+
+    if (!hdr)
+        return;
+
+    if (!thread_id)
+        thread_id = syscall(SYS_gettid);
+
+    pos = __atomic_fetch_add(&hdr->head, 1, __ATOMIC_RELAXED);
+    e = &ring[pos & (BLACKBOX_ENTRIES - 1)];
+
+    /* Invalidate the entry before it is rewritten */
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    e->event = event;
+    e->thread = thread_id;
+    e->sec = ts.tv_sec;
+    e->usec = ts.tv_nsec / 1000;
+    e->args[0] = a0;
+    e->args[1] = a1;
+    e->args[2] = a2;
+    e->args[3] = 0;
+
+    __atomic_store_n(&e->seq, pos + 1, __ATOMIC_RELEASE);
+}
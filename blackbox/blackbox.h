@@ -0,0 +1,111 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   blackbox.h
+ * Created on October 18, 2026, 4:45 PM
+ */
+
+#ifndef BLACKBOX_H_
+#define BLACKBOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BLACKBOX_MAGIC          0x42425044      /* "DPBB" */
+#define BLACKBOX_VERSION        1               /* Layout version of the ring */
+#define BLACKBOX_ENTRIES        4096            /* Number of entries, must be a power of two */
+#define BLACKBOX_ARGS           4               /* Number of arguments of an entry */
+
+/* Blackbox events */
+enum blackbox_event {
+    BB_START,                   /* The server started: pid, entries */
+    BB_CRASH,                   /* A fatal signal was caught: signal, address */
+    BB_ACCEPT,                  /* A client connected: client, port, clients */
+    BB_REQUEST,                 /* A request was answered: client, method, status */
+    BB_CLOSE,                   /* A client was closed: client, requests */
+    BB_LONGRUNNER,              /* A longrunner run finished: runner, duration in us */
+    BB_GPIO_STATE,              /* A GPIO output was set: pin, state */
+    BB_GPIO_DIR,                /* A GPIO direction was set: pin, direction */
+    BB_I2C_ERROR,               /* An I2C transfer failed: bus, errno */
+    BB_PWM,                     /* A PWM channel was set or stopped: pin, frequency, duty */
+    __BB_MAX,
+};
+
+/**
+ * The header at the start of the blackbox file
+ */
+struct blackbox_header {
+    uint32_t magic;             /* BLACKBOX_MAGIC */
+    uint32_t version;           /* BLACKBOX_VERSION */
+    uint32_t entries;           /* Number of entries in the ring */
+    uint32_t head;              /* Next ring position, incremented atomically */
+    int32_t offset_sec;         /* Realtime minus monotonic clock at the last start */
+    int32_t offset_usec;
+    uint32_t reserved[2];
+};
+
+/**
+ * An entry in the ring, the sequence number is written last so a torn
+ * entry can be recognised after a crash
+ */
+struct blackbox_entry {
+    uint32_t seq;               /* Ring position plus one, 0 while written */
+    uint16_t event;             /* The blackbox event */
+    uint16_t thread;            /* Low bits of the thread id */
+    uint32_t sec;               /* Monotonic clock seconds */
+    uint32_t usec;              /* Monotonic clock microseconds */
+    uint32_t args[BLACKBOX_ARGS];
+};
+
+/**
+ * Description of a blackbox event for the decoder
+ */
+struct blackbox_event_info {
+    const char *name;
+    const char *args[BLACKBOX_ARGS];
+};
+
+extern const struct blackbox_event_info blackbox_events[__BB_MAX];
+
+/**
+ * Map the blackbox file and start recording. An existing ring with the
+ * same layout is continued so the history before a crash is kept.
+ * @param path the file to map, preferably on a RAM backed filesystem.
+ * @return true on success.
+ */
+bool blackbox_init(const char *path);
+
+/**
+ * Append an entry to the blackbox. This never blocks and can be called
+ * from any thread and from signal handlers.
+ * @param event the blackbox event.
+ * @param a0 the first argument.
+ * @param a1 the second argument.
+ * @param a2 the third argument.
+ */
+void blackbox_record(enum blackbox_event event, uint32_t a0, uint32_t a1, uint32_t a2);
+
+#endif
@@ -0,0 +1,156 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   blackbox_dump.c
+ * Created on October 18, 2026, 5:20 PM
+ */
+
+/*
+ * Decoder for the blackbox ring, prints the recorded events oldest first.
+ * Usage: blackbox-dump [-n count] [file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blackbox.h"
+#include "../config.h"
+
+/**
+ * Print a single entry.
+ * @param hdr the blackbox header.
+ * @param e the entry to print.
+ * @param pos the ring position of the entry.
+ */
+static void dump_entry(const struct blackbox_header *hdr, const struct blackbox_entry *e, uint32_t pos)
+{
+    long usec = (long) e->usec + hdr->offset_usec;
+    time_t sec = (time_t) e->sec + hdr->offset_sec;
+    char stamp[32];
+    struct tm tm;
+    int i;
+
+    if (e->seq != pos + 1) {
+        printf("%10u <torn>\n", pos);
+        return;
+    }
+
+    if (usec < 0) {
+        usec += 1000000;
+        --sec;
+    } else if (usec >= 1000000) {
+        usec -= 1000000;
+        ++sec;
+    }
+
+    localtime_r(&sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%10u %s.%06ld [%5u] ", pos, stamp, usec, e->thread);
+
+    if (e->event >= __BB_MAX) {
+        printf("event%u %u %u %u %u\n", e->event, e->args[0], e->args[1], e->args[2], e->args[3]);
+        return;
+    }
+
+    printf("%-12s", blackbox_events[e->event].name);
+    for (i = 0; i < BLACKBOX_ARGS && blackbox_events[e->event].args[i]; ++i) {
+        if (e->event == BB_CRASH && i == 1)
+            printf(" %s=0x%08x", blackbox_events[e->event].args[i], e->args[i]);
+        else
+            printf(" %s=%u", blackbox_events[e->event].args[i], e->args[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = BLACKBOX_PATH;
+    const struct blackbox_header *hdr;
+    const struct blackbox_entry *ring;
+    uint32_t count = BLACKBOX_ENTRIES;
+    uint32_t head, first, pos;
+    struct stat st;
+    void *map;
+    int fd, ch;
+
+    while ((ch = getopt(argc, argv, "n:")) != -1) {
+        switch (ch) {
+        case 'n':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n count] [file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind < argc)
+        path = argv[optind];
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    if (st.st_size < (off_t) sizeof(struct blackbox_header)) {
+        fprintf(stderr, "%s: not a blackbox\n", path);
+        return 1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    hdr = map;
+    ring = (const struct blackbox_entry*) (hdr + 1);
+    if (hdr->magic != BLACKBOX_MAGIC || hdr->version != BLACKBOX_VERSION ||
+        (hdr->entries & (hdr->entries - 1)) ||
+        st.st_size < (off_t) (sizeof(*hdr) + hdr->entries * sizeof(*ring))) {
+        fprintf(stderr, "%s: not a blackbox or unsupported version\n", path);
+        return 1;
+    }
+
+    /* Only the last entries of the ring are still present */
+    head = hdr->head;
+    if (count > hdr->entries)
+        count = hdr->entries;
+    first = head > count ? head - count : 0;
+
+    for (pos = first; pos != head; ++pos)
+        dump_entry(hdr, &ring[pos & (hdr->entries - 1)], pos);
+
+    munmap(map, st.st_size);
+    return 0;
+}
@@ -31,6 +31,7 @@
 #include <json-c/json.h>
 
 #include "../uhttpd.h"
+#include "../client.h"
 #include "../logger.h"
 #include "../helper.h"
 #include "bluecherry.h"
@@ -79,7 +80,7 @@ json_object* bluecherry_post_router(struct client *cl, char *request) {
  */
 json_object* bluecherry_post_login_user(struct client *cl, char *request) {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_username = NULL;
     json_object *j_password = NULL;
@@ -119,7 +120,7 @@ json_object* bluecherry_post_login_user(struct client *cl, char *request) {
  */
 json_object* bluecherry_post_init_device(struct client *cl, char *request) {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_username = NULL;
     json_object *j_password = NULL;
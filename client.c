@@ -28,6 +28,10 @@
  * Created on May 10, 2014, 5:28 PM
  */
 
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <libubox/blobmsg.h>
 #include <ctype.h>
 
@@ -35,6 +39,8 @@
 #include "listen.h"
 #include "uhttpd.h"
 #include "client.h"
+#include "metrics.h"
+#include "blackbox/blackbox.h"
 
 /* The list of connected clients */
 static LIST_HEAD(clients);
@@ -61,42 +67,199 @@ const char * const http_methods[] = {
 };
 
 /**
- * Write a http header to a client
- * @client the client to write the header to
- * @code the http status code t o write
- * @summary the http status code info, for example if code = 200, summary = "Ok"
+ * Cork or uncork the client socket. While the socket is corked the kernel
+ * only sends full segments, so a header followed by a small body leaves in
+ * one packet. Uncorking flushes whatever is still queued.
+ * @cl the client owning the socket
+ * @cork true to cork the socket, false to flush it
  */
-void write_http_header(struct client *cl, int code, const char *summary)
+static void client_set_cork(struct client *cl, bool cork)
+{
+	int val = cork;
+
+	if (cl->corked == cork)
+		return;
+
+	setsockopt(cl->sfd.fd.fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val));
+	cl->corked = cork;
+}
+
+/**
+ * Flush data held back by the corked socket. Streaming responses which
+ * outlive the request must call this after writing their header.
+ * @cl the client to flush
+ */
+void client_flush(struct client *cl)
+{
+	client_set_cork(cl, false);
+}
+
+/**
+ * Format the status line and the connection headers into a buffer.
+ * @cl the client the header is meant for
+ * @buf the buffer to format the header in
+ * @len the size of the buffer
+ * @code the http status code to write
+ * @summary the http status code info
+ * @return the number of characters placed in the buffer
+ */
+static int format_http_header(struct client *cl, char *buf, int len, int code, const char *summary)
 {
 	struct http_request *r = &cl->request;
 	const char *enc = "Transfer-Encoding: chunked\r\n";
-	const char *conn;
+	int n;
+
+	metrics_count_status(code);
+	cl->trace.status = code;
+	if (!cl->trace.handler_end)
+		trace_mark(&cl->trace.handler_end);
 
 	/* If no chunked transfer is used, remove the encoding line */
 	if (!uh_use_chunked(cl))
 		enc = "";
 
 	/* Check if connection should be closed or kept open after request */
-	if (r->connection_close)
-		conn = "Connection: close";
+	if (r->connection_close) {
+		n = snprintf(buf, len, "%s %03i %s\r\nConnection: close\r\n%s",
+			http_versions[r->version], code, summary, enc);
+	} else {
+		/* This is a Keep-Alive connection, also send the keep alive time */
+		n = snprintf(buf, len, "%s %03i %s\r\nConnection: Keep-Alive\r\n%sKeep-Alive: timeout=%d\r\n",
+			http_versions[r->version], code, summary, enc, conf->keep_alive_time);
+	}
+
+	n = min(n, len - 1);
+	return n + trace_server_timing(cl, buf + n, len - n);
+}
+
+/**
+ * Write a http header to a client
+ * @client the client to write the header to
+ * @code the http status code t o write
+ * @summary the http status code info, for example if code = 200, summary = "Ok"
+ */
+void write_http_header(struct client *cl, int code, const char *summary)
+{
+	char buf[256];
+	int len;
+
+	/* Hold back partial segments until the request is done */
+	client_set_cork(cl, true);
+
+	/* Send the header to the client in one write */
+	len = format_http_header(cl, buf, sizeof(buf), code, summary);
+	ustream_write(cl->us, buf, len, true);
+	metric_add(&metric_bytes_out, len);
+}
+
+/**
+ * Write two buffers to the client socket with a single writev call. When
+ * the stream still has pending data, or not everything could be written,
+ * the remainder is queued on the stream so ordering is preserved.
+ * @cl the client to write to
+ * @hdr the first buffer, usually the response header
+ * @hlen the length of the first buffer
+ * @body the second buffer, may be NULL
+ * @blen the length of the second buffer
+ */
+static void client_writev(struct client *cl, const char *hdr, int hlen, const char *body, int blen)
+{
+	struct iovec iov[2] = {
+		{ .iov_base = (void *) hdr, .iov_len = hlen },
+		{ .iov_base = (void *) body, .iov_len = blen },
+	};
+	ssize_t written = 0;
+
+	if (cl->state == CLIENT_STATE_CLEANUP)
+		return;
+
+	tw_timer_set(&cl->idle, conf->network_timeout * 1000);
+	metric_add(&metric_bytes_out, hlen + (body ? blen : 0));
+
+	/* Only bypass the stream when nothing is queued on it */
+	if (!cl->tls && !ustream_pending_data(cl->us, true)) {
+		do {
+			written = writev(cl->sfd.fd.fd, iov, body && blen ? 2 : 1);
+		} while (written < 0 && errno == EINTR);
+
+		/* Let the stream handle (and report) the error */
+		if (written < 0)
+			written = 0;
+	}
+
+	/* Queue what the kernel did not take */
+	if (written < hlen) {
+		ustream_write(cl->us, hdr + written, hlen - written, true);
+		written = 0;
+	} else {
+		written -= hlen;
+	}
+
+	if (body && blen > written)
+		ustream_write(cl->us, body + written, blen - written, false);
+}
+
+/**
+ * Write a complete response with a body that is already in memory. The
+ * header block is assembled in one buffer and flushed together with the
+ * body. The request is finished afterwards.
+ * @cl the client to write the response to
+ * @code the http status code to write
+ * @summary the http status code info
+ * @type the content type of the body
+ * @etag the entity tag of the body, may be NULL
+ * @body the response body
+ * @len the length of the response body
+ */
+void client_write_response(struct client *cl, int code, const char *summary,
+		const char *type, const char *etag, const char *body, int len)
+{
+	char hdr[512];
+	int hlen;
+
+	/* Assemble the complete header block */
+	hlen = format_http_header(cl, hdr, sizeof(hdr), code, summary);
+	if (etag)
+		hlen += snprintf(hdr + hlen, sizeof(hdr) - hlen, "ETag: %s\r\n", etag);
+
+	/* A 304 response has no body, it refers to the cached one */
+	if (code == 304)
+		hlen += snprintf(hdr + hlen, sizeof(hdr) - hlen, "\r\n");
 	else
-		conn = "Connection: Keep-Alive";
+		hlen += snprintf(hdr + hlen, sizeof(hdr) - hlen,
+			"Content-Type: %s\r\nContent-Length: %d\r\n\r\n", type, len);
+	hlen = min(hlen, sizeof(hdr) - 1);
+
+	/* Do not send a body for header only requests */
+	if (cl->request.method == UH_HTTP_MSG_HEAD)
+		len = 0;
 
-	/* Send the header to the client */
-	ustream_printf(cl->us, "%s %03i %s\r\n%s\r\n%s",
-		http_versions[cl->request.version],
-		code, summary, conn, enc);
+	client_writev(cl, hdr, hlen, body, len);
+	request_done(cl);
+}
+
+/**
+ * Free the request body and its parser.
+ * @cl the client to free the body from
+ */
+static void client_free_body(struct client *cl)
+{
+	if (cl->tok) {
+		json_tokener_free(cl->tok);
+		cl->tok = NULL;
+	}
 
-	/* If this is a Keep-Alive connection, send the keep alive time */
-	if (!r->connection_close)
-		ustream_printf(cl->us, "Keep-Alive: timeout=%d\r\n", conf->keep_alive_time);
+	if (cl->body) {
+		json_object_put(cl->body);
+		cl->body = NULL;
+	}
 }
 
 /**
  * Close this client connection
  * @client the client to close the connection from
  */
-static void close_connection(struct client *cl)
+void close_connection(struct client *cl)
 {
 	cl->state = CLIENT_STATE_CLOSE;
 	cl->us->eof = true;
@@ -118,12 +281,12 @@ static void dispatch_done(struct client *cl)
 /**
  * This function is called when a client times out. The connection
  * should then be closed.
- * @timeout: the timeout event from the uloop event loop
+ * @timer: the idle timer from the timer wheel
  */
-static void timeout_event_handler(struct uloop_timeout *timeout)
+static void timeout_event_handler(struct tw_timer *timer)
 {
 	/* Get the client that caused the timeout event */
-	struct client *cl = container_of(timeout, struct client, timeout);
+	struct client *cl = container_of(timer, struct client, idle);
 
 	/* Close the connection */
 	close_connection(cl);
@@ -143,9 +306,8 @@ static void polling_event_handler(struct uloop_timeout *timeout)
 	/* Set timeout when the client had made request, network timeout otherwise */
 	int msec = cl->requests > 0 ? conf->keep_alive_time : conf->network_timeout;
 
-	/* Install closing event handler on the connection */
-	cl->timeout.cb = timeout_event_handler;
-	uloop_timeout_set(&cl->timeout, msec * 1000);
+	/* Arm the idle timer which closes the connection */
+	tw_timer_set(&cl->idle, msec * 1000);
 	cl->us->notify_read(cl->us, 0);
 }
 
@@ -166,9 +328,16 @@ static void poll_connection(struct client *cl)
  */
 void request_done(struct client *cl)
 {
-	/* Send EOF to client and free dispatch resources */
+	/* The trace is reset when the request is done */
+	int status = cl->trace.status;
+
+	/* Send EOF to client, flush the socket and free dispatch resources */
 	uh_chunk_eof(cl);
+	client_set_cork(cl, false);
 	dispatch_done(cl);
+	client_free_body(cl);
+	trace_request_done(cl);
+	blackbox_record(BB_REQUEST, cl->id, cl->request.method, status);
 
 	/* Set the dispatch pointers to zero */
 	memset(&cl->dispatch, 0, sizeof(cl->dispatch));
@@ -227,23 +396,17 @@ void __printf(4,5) client_send_error(struct client *cl, int code, const char *su
     char buf[256];
     int len;
     
-    /* Write header with error code */
-    write_http_header(cl, code, summary);
-    ustream_printf(cl->us, "Content-Type: text/html\r\n");
-    
     /* Prepare buffer */
-    len = snprintf(buf, 256, "<h1>%s</h1>", summary);
+    len = snprintf(buf, sizeof(buf), "<h1>%s</h1>", summary);
     if(format) {
         va_start(arg, format);
-        len += snprintf(buf + len, 256 - len, format, arg);
+        len += vsnprintf(buf + len, sizeof(buf) - len, format, arg);
         va_end(arg);
     }
+    len = min(len, sizeof(buf) - 1);
 
-    ustream_printf(cl->us, "Content-Length: %d\r\n\r\n", len);
-    ustream_printf(cl->us, "%s", buf);
-    
-    /* End the request */
-    request_done(cl);
+    /* Write header and error page at once, this ends the request */
+    client_write_response(cl, code, summary, "text/html", NULL, buf, len);
 }
 
 
@@ -317,7 +480,7 @@ static int parse_client_request(struct client *cl, char *data)
 	req->version = h_version;
 
 	/* Close connection when needed */
-	if (req->version < UH_HTTP_VER_1_1 || req->method == UH_HTTP_MSG_POST)
+	if (req->version < UH_HTTP_VER_1_1)
 		req->connection_close = true;
 
 	/* Set the state as header parsed */
@@ -353,6 +516,7 @@ static bool client_init_handler(struct client *cl, char *buf, int len)
 	blob_buf_init(&cl->hdr, 0);
 	cl->state = parse_client_request(cl, buf);
 	ustream_consume(cl->us, newline + 2 - buf);
+	trace_mark(&cl->trace.request);
 
 	/* Return an error when the header is malformed */
 	if (cl->state == CLIENT_STATE_DONE)
@@ -361,6 +525,72 @@ static bool client_init_handler(struct client *cl, char *buf, int len)
 	return true;
 }
 
+/**
+ * Receive a part of the request body. The body is fed to a JSON parser
+ * as it arrives so it never has to be kept as a whole.
+ * @cl the client who sent the data
+ * @data the received part of the body
+ * @len the length of the data
+ * @return the number of bytes handled
+ */
+static int client_body_data(struct client *cl, const char *data, int len)
+{
+	cl->body_len += len;
+	tw_timer_set(&cl->idle, conf->network_timeout * 1000);
+
+	/* Chunked bodies are only known to be too large while receiving */
+	if (cl->body_len > conf->max_body_size) {
+		cl->dispatch.data_send = NULL;
+		cl->dispatch.data_done = NULL;
+		client_free_body(cl);
+		header_error(cl, 413, "Request Entity Too Large");
+		return len;
+	}
+
+	/* Data after a complete or malformed body is ignored */
+	if (cl->body || (cl->tok && json_tokener_get_error(cl->tok) != json_tokener_continue))
+		return len;
+
+	if (!cl->tok)
+		cl->tok = json_tokener_new();
+
+	cl->body = json_tokener_parse_ex(cl->tok, data, len);
+	return len;
+}
+
+/**
+ * Called when the complete request body is received.
+ * @cl the client who sent the body
+ */
+static void client_body_done(struct client *cl)
+{
+	/* Finish parsing values which only end at the end of the input */
+	if (!cl->body && cl->tok && json_tokener_get_error(cl->tok) == json_tokener_continue)
+		cl->body = json_tokener_parse_ex(cl->tok, "", 1);
+
+	if (cl->tok) {
+		json_tokener_free(cl->tok);
+		cl->tok = NULL;
+	}
+
+	tw_timer_cancel(&cl->idle);
+	uh_handle_request(cl);
+}
+
+/**
+ * Take the JSON body of the request. The caller owns the returned
+ * reference.
+ * @cl the client who sent the request
+ * @return the parsed body, NULL when there is none or it is malformed
+ */
+json_object* client_get_json_body(struct client *cl)
+{
+	json_object *body = cl->body;
+
+	cl->body = NULL;
+	return body;
+}
+
 /**
  * This function should be called when header
  * parsing is complete.
@@ -370,6 +600,14 @@ static void client_header_complete(struct client *cl)
 {
 	struct http_request *r = &cl->request;
 
+	trace_mark(&cl->trace.headers);
+
+	/* Refuse bodies which are known to be too large up front */
+	if (r->content_length > conf->max_body_size) {
+		header_error(cl, 413, "Request Entity Too Large");
+		return;
+	}
+
 	/* If a contiuation is expected return status 100 */
 	if (r->expect_cont)
 		ustream_printf(cl->us, "HTTP/1.1 100 Continue\r\n\r\n");
@@ -390,6 +628,15 @@ static void client_header_complete(struct client *cl)
 		break;
 	}
 
+	/* Collect the body before the request is handled */
+	if (r->content_length || r->transfer_chunked) {
+		cl->body_len = 0;
+		tw_timer_set(&cl->idle, conf->network_timeout * 1000);
+		cl->dispatch.data_send = client_body_data;
+		cl->dispatch.data_done = client_body_done;
+		return;
+	}
+
 	uh_handle_request(cl);
 }
 
@@ -407,7 +654,7 @@ static void client_parse_header(struct client *cl, char *data)
 
 	/* Parse post data if there is any */
 	if (!*data) {
-		uloop_timeout_cancel(&cl->timeout);
+		tw_timer_cancel(&cl->idle);
 		cl->state = CLIENT_STATE_DATA;
 		client_header_complete(cl);
 		return;
@@ -546,7 +793,6 @@ void client_post_data(struct client *cl)
 
 		/* Nullterminate the string */
 		*sep = 0;
-		printf("Separator: %s\r\n", sep);
 
 		r->content_length = strtoul(buf + offset, &sep, 16);
 		r->transfer_chunked++;
@@ -569,10 +815,10 @@ void client_post_data(struct client *cl)
 	/* Read the parameter into the buffer */
 	buf = ustream_get_read_buf(cl->us, &len);
 	if (!r->content_length && !r->transfer_chunked && cl->state != CLIENT_STATE_DONE) {
+		/* The request can be finished by the data_done handler */
+		cl->state = CLIENT_STATE_DONE;
 		if (cl->dispatch.data_done)
 			cl->dispatch.data_done(cl);
-
-		cl->state = CLIENT_STATE_DONE;
 	}
 }
 
@@ -605,17 +851,7 @@ static bool client_header_handler(struct client *cl, char *buf, int len)
 		return false;
 	}
 
-	/* Nullterminate the string buffer on newline when
-	 * newline is not followed by another newline. Otherwise
-	 * buffer contains post data
-	 */
-	if(!strstr(newline + 2, "\r\n")){
-		// Save the found post data
-		cl->ispostdata = true;
-		cl->postdata = (char*) realloc(cl->postdata, (strlen(newline+2)+1)*sizeof(char));
-		strcpy(cl->postdata, newline + 2);
-	}
-
+	/* Nullterminate the string buffer on newline */
 	*newline = 0;
 
 	/* Parse the header */
@@ -633,11 +869,35 @@ static bool client_header_handler(struct client *cl, char *buf, int len)
 	return true;
 }
 
+/**
+ * Handler called for data on a connection which switched protocols.
+ * The data is passed to the dispatcher, which returns how much of it
+ * could be handled.
+ * @cl the client who sent the data
+ * @buf the buffer containing the data
+ * @len the length of the data
+ */
+static bool client_upgraded_handler(struct client *cl, char *buf, int len)
+{
+	int consumed;
+
+	if (!cl->dispatch.data_send)
+		return false;
+
+	consumed = cl->dispatch.data_send(cl, buf, len);
+	if (consumed <= 0)
+		return false;
+
+	ustream_consume(cl->us, consumed);
+	return true;
+}
+
 typedef bool (*read_cb_t)(struct client *cl, char *buf, int len);
 static read_cb_t read_cbs[] = {
 	[CLIENT_STATE_INIT] 	= client_init_handler,
 	[CLIENT_STATE_HEADER] 	= client_header_handler,
 	[CLIENT_STATE_DATA] 	= client_data_handler,
+	[CLIENT_STATE_UPGRADED]	= client_upgraded_handler,
 };
 
 /**
@@ -664,7 +924,8 @@ void read_from_client(struct client *cl)
 		/* Call different handlers and parse */
 		if (!read_cbs[cl->state](cl, str, len)) {
 			if (len == us->r.buffer_len &&
-			    cl->state != CLIENT_STATE_DATA)
+			    cl->state != CLIENT_STATE_DATA &&
+			    cl->state != CLIENT_STATE_UPGRADED)
 				header_error(cl, 413, "Request Entity Too Large");
 			break;
 		}
@@ -683,13 +944,15 @@ static void client_close(struct client *cl)
 		return;
 	}
 
+	blackbox_record(BB_CLOSE, cl->id, cl->requests, 0);
+
 	/* Free all resources */
-	if(cl->ispostdata)
-		free(cl->postdata);
+	client_free_body(cl);
 	client_done = true;
 	n_clients--;
 	dispatch_done(cl);
 	uloop_timeout_cancel(&cl->timeout);
+	tw_timer_cancel(&cl->idle);
 	ustream_free(&cl->sfd.stream);
 	close(cl->sfd.fd.fd);
 	list_del(&cl->list);
@@ -732,6 +995,7 @@ static void client_ustream_read_handler(struct ustream *s, int bytes)
 {
 	struct client *cl = container_of(s, struct client, sfd.stream);
 
+	metric_add(&metric_bytes_in, bytes);
 	read_from_client(cl);
 }
 
@@ -745,6 +1009,9 @@ static void client_ustream_write_handler(struct ustream *s, int bytes)
 {
 	struct client *cl = container_of(s, struct client, sfd.stream);
 
+	if (cl->trace_seq && !ustream_pending_data(s, true))
+		trace_flushed(cl);
+
 	if (cl->dispatch.write_cb)
 		cl->dispatch.write_cb(cl);
 }
@@ -793,6 +1060,7 @@ bool accept_client(int fd, bool tls)
 	int sfd;
 	static int client_id = 0;
 	struct sockaddr_in6 addr;
+	int one = 1;
 
 	/* If the list has no space enlarge it with one */
 	if (!next_client)
@@ -807,16 +1075,21 @@ bool accept_client(int fd, bool tls)
 		return false;
 
 	set_addr(&cl->peer_addr, &addr);
+	trace_mark(&cl->trace.accept);
 	sl = sizeof(addr);
 	getsockname(sfd, (struct sockaddr *) &addr, &sl);
 	set_addr(&cl->srv_addr, &addr);
 
 	/* Attach all handlers */
+	cl->idle.cb = timeout_event_handler;
 	cl->us = &cl->sfd.stream;
 	cl->us->notify_read = client_ustream_read_handler;
 	cl->us->notify_write = client_ustream_write_handler;
 	cl->us->notify_state = client_notify_state_handler;
 
+	/* Send small responses without waiting for outstanding ACKs */
+	setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
 	/* Initialise stream for string data */
 	cl->us->string_data = true;
 	ustream_fd_init(&cl->sfd, sfd);
@@ -829,6 +1102,7 @@ bool accept_client(int fd, bool tls)
 	next_client = NULL;
 	n_clients++;
 	cl->id = client_id++;
+	blackbox_record(BB_ACCEPT, cl->id, cl->peer_addr.port, n_clients);
 
 	return true;
 }
@@ -31,6 +31,8 @@
 #ifndef CLIENT_H_
 #define CLIENT_H_
 
+#include <json-c/json.h>
+
 /**
  * Write a http header to a client
  * @cl the client to write the header to
@@ -39,6 +41,28 @@
  */
 void write_http_header(struct client *cl, int code, const char *summary);
 
+/**
+ * Flush data held back by the corked socket. Streaming responses which
+ * outlive the request must call this after writing their header.
+ * @cl the client to flush
+ */
+void client_flush(struct client *cl);
+
+/**
+ * Write a complete response with a body that is already in memory. The
+ * header block is assembled in one buffer and flushed together with the
+ * body. The request is finished afterwards.
+ * @cl the client to write the response to
+ * @code the http status code to write
+ * @summary the http status code info
+ * @type the content type of the body
+ * @etag the entity tag of the body, may be NULL
+ * @body the response body
+ * @len the length of the response body
+ */
+void client_write_response(struct client *cl, int code, const char *summary,
+        const char *type, const char *etag, const char *body, int len);
+
 /**
  * Signal a request is done and set the connection to wait
  * for another request from the client.
@@ -46,6 +70,12 @@ void write_http_header(struct client *cl, int code, const char *summary);
  */
 void request_done(struct client *cl);
 
+/**
+ * Close this client connection once all pending data is written
+ * @cl the client to close the connection from
+ */
+void close_connection(struct client *cl);
+
 /**
  * Send an error message to the browser
  * @cl the client to send the error message to
@@ -64,6 +94,14 @@ void __printf(4, 5) send_client_error(struct client *cl, int code, const char *s
  */
 void __printf(4,5) client_send_error(struct client *cl, int code, const char *summary, const char *format, ...);
 
+/**
+ * Take the JSON body of the request. The body is parsed while it is
+ * received, the caller owns the returned reference.
+ * @cl the client who sent the request
+ * @return the parsed body, NULL when there is none or it is malformed
+ */
+json_object* client_get_json_body(struct client *cl);
+
 /**
  * Parse client POST data.
  * @cl the client who sent de data
@@ -39,9 +39,12 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <stdint.h>
+#include <limits.h>
 
 #include "i2c.h"
 #include "../logger.h"
+#include "../helper.h"
+#include "../blackbox/blackbox.h"
 
 /* 
  * Array containing file descriptors for i2c-buses. This 
@@ -102,6 +105,12 @@ bool i2c_enable_device(int busno, int sda, int scl)
 {
     char buff[256];
     
+    // The simulator provides the bus device nodes itself
+    if(helper_hw_simulated()) {
+        log_message(LOG_DEBUG, "i2c_enable_device: simulated hardware, not loading i2c-gpio-custom\r\n");
+        return true;
+    }
+    
     // Generate the insmod command
     sprintf(buff, "insmod i2c-gpio-custom bus%d=%d,%d,%d", busno, busno, sda, scl);
     log_message(LOG_DEBUG, "executing: %s\r\n", buff);
@@ -118,8 +127,9 @@ bool i2c_enable_device(int busno, int sda, int scl)
  */
 bool i2c_open_bus(int busno)
 {
-    char buff[16];
+    char buff[PATH_MAX];
     int fd;
+    int flags = O_RDWR;
     
     if(!_i2c_busno_in_range(busno)) {
         log_message(LOG_ERROR, "i2c_open_bus: bus number (%d) is out of range, maximum is %d\r\n", busno, I2C_MAX_BUSES);
@@ -127,10 +137,17 @@ bool i2c_open_bus(int busno)
     }
     
     // Generate the bus file path
-    sprintf(buff, "/dev/i2c-%d", busno);
+    if(!helper_hw_path(buff, sizeof(buff), "/dev/i2c-%d", busno)) {
+        return false;
+    }
+    
+    // A simulated bus is a loopback FIFO, an empty one must not block
+    if(helper_hw_simulated()) {
+        flags |= O_NONBLOCK;
+    }
 
     // Try to open the I2C device 
-    fd = open(buff, O_RDWR);
+    fd = open(buff, flags);
     if(fd < 0) {
         return false;
     }
@@ -168,6 +185,12 @@ bool i2c_set_slave_address(int busno, uint8_t address)
         log_message(LOG_ERROR, "i2c_set_slave_address: the bus number (%d) is out of range or the bus is not yet open\r\n", busno);
         return false;
     }
+    
+    // The loopback bus has no slave devices to address
+    if(helper_hw_simulated()) {
+        return true;
+    }
+    
     return ioctl(fd, I2C_SLAVE, address) >= 0;
 }
 
@@ -190,6 +213,7 @@ bool i2c_write_bytes(int busno, uint8_t* byte, int len)
     int r = write(fd, byte, len);
     
     if(r == -1) {
+        blackbox_record(BB_I2C_ERROR, busno, errno, 0);
         log_message(LOG_ERROR, "I2C write got an error [%d]: %s\r\n", errno, strerror(errno));
         return false;
     }
@@ -215,7 +239,13 @@ int i2c_read(int busno, uint8_t* buffer, int len)
     errno = 0;
     int r = read(fd, buffer, len);
     
+    // Nothing was looped back yet on the simulated bus
+    if(r == -1 && errno == EAGAIN && helper_hw_simulated()) {
+        return 0;
+    }
+    
     if(r == -1){
+        blackbox_record(BB_I2C_ERROR, busno, errno, 0);
         log_message(LOG_ERROR, "I2C read got an error [%d]: %s\r\n", errno, strerror(errno));
     }
     
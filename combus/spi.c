@@ -34,10 +34,53 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <limits.h>
 #include <linux/spi/spidev.h>
 
 #include "spi.h"
 #include "../config.h"
+#include "../helper.h"
+
+/**
+ * Perform an SPI ioctl. On simulated hardware the device is a loopback FIFO,
+ * settings are accepted as they are and a transfer reads back what it wrote.
+ * @dev the SPI device to use.
+ * @request the SPI ioctl request.
+ * @arg the argument of the request.
+ *
+ * @return the result of the request, -1 on error.
+ */
+static int _spi_ioctl(int dev, unsigned long request, void *arg)
+{
+	struct spi_ioc_transfer *tr = (struct spi_ioc_transfer*) arg;
+	uint32_t done = 0;
+
+	if(!helper_hw_simulated()) {
+		return ioctl(dev, request, arg);
+	}
+
+	switch(request) {
+		case SPI_IOC_RD_MAX_SPEED_HZ:
+			*((uint32_t*) arg) = SPI_DEFAULT_SPEED;
+			return 0;
+		case SPI_IOC_RD_BITS_PER_WORD:
+			*((uint8_t*) arg) = SPI_DEFAULT_BITS;
+			return 0;
+		case SPI_IOC_MESSAGE(1):
+			/* Loop back in pipe sized chunks so the FIFO never fills */
+			while(done < tr->len) {
+				uint32_t chunk = tr->len - done > PIPE_BUF ? PIPE_BUF : tr->len - done;
+				if(write(dev, (uint8_t*) (unsigned long) tr->tx_buf + done, chunk) != chunk ||
+				   read(dev, (uint8_t*) (unsigned long) tr->rx_buf + done, chunk) != chunk) {
+					return -1;
+				}
+				done += chunk;
+			}
+			return tr->len;
+		default:
+			return 0;
+	}
+}
 
 /* Initialise the SPI device.
  * @mode select the SPI mode (mode 0 = 0b00, mode 1 = 0b01, mode 2 = 0b01, mode 3 = 0b11)
@@ -49,25 +92,29 @@ int spi_init(uint32_t mode, uint8_t bits, uint32_t speed)
 {
 	/* The SPI device file descriptor */
 	int dev;
+	char path[PATH_MAX];
 
 	/* Try to open the SPI device */
-	dev = open(SPI_DEVICE, O_RDWR);
+	if(!helper_hw_path(path, sizeof(path), SPI_DEVICE)) {
+		return -1;
+	}
+	dev = open(path, O_RDWR);
 	if(dev < 0) {
 		return -1;
 	}
 
 	/* Set the SPI mode */
-	if(ioctl(dev, SPI_IOC_WR_MODE, &mode) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_WR_MODE, &mode) == -1) {
 		return -1;
 	}
 
 	/* Set the number of bits per word */
-	if(ioctl(dev, SPI_IOC_WR_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_WR_BITS_PER_WORD, &bits) == -1) {
 		return -1;
 	}
 
 	/* Set the maximum bus speed in Hz */
-	if(ioctl(dev, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
 		return -1;
 	}
 
@@ -88,12 +135,12 @@ int spi_byte_send_8(int dev, uint8_t byte)
 	uint8_t rx;
 
 	/* Get speed settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
 		return -1;
 	}
 
 	/* Get bits per word settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
 		return -1;
 	}
 
@@ -108,7 +155,7 @@ int spi_byte_send_8(int dev, uint8_t byte)
 	};
 
 	/* Try to transfer the data */
-	if(ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
+	if(_spi_ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
 		return -1;
 	}
 
@@ -134,12 +181,12 @@ int spi_data_send_8(int dev, uint8_t data[], int size)
 	uint8_t *rx = (uint8_t*) malloc(size*sizeof(uint8_t));
 
 	/* Get speed settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
 		return -1;
 	}
 
 	/* Get bits per word settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
 		return -1;
 	}
 
@@ -154,7 +201,7 @@ int spi_data_send_8(int dev, uint8_t data[], int size)
 	};
 
 	/* Try to transfer the data */
-	if(ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
+	if(_spi_ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
 		return -1;
 	}
 
@@ -183,12 +230,12 @@ int spi_data_send_16(int dev, uint16_t data[], int size)
 	uint16_t *rx = (uint16_t*) malloc(size*sizeof(uint16_t));
 
 	/* Get speed settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
 		return -1;
 	}
 
 	/* Get bits per word settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
 		return -1;
 	}
 
@@ -203,7 +250,7 @@ int spi_data_send_16(int dev, uint16_t data[], int size)
 	};
 
 	/* Try to transfer the data */
-	if(ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
+	if(_spi_ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
 		return -1;
 	}
 
@@ -236,12 +283,12 @@ spidata_8* spi_data_read_8(int dev, uint32_t size)
 	uint8_t *tx = (uint8_t*) calloc(size, sizeof(uint8_t));
 
 	/* Get speed settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
 		return NULL;
 	}
 
 	/* Get bits per word settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
 		return NULL;
 	}
 
@@ -256,7 +303,7 @@ spidata_8* spi_data_read_8(int dev, uint32_t size)
 	};
 
 	/* Try to transfer the data */
-	if(ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
+	if(_spi_ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
 		return NULL;
 	}
 
@@ -289,12 +336,12 @@ spidata_16* spi_data_read_16(int dev, uint32_t size)
 	uint16_t *tx = (uint16_t*) calloc(size, sizeof(uint16_t));
 
 	/* Get speed settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
 		return NULL;
 	}
 
 	/* Get bits per word settings for the device */
-	if(ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
+	if(_spi_ioctl(dev, SPI_IOC_RD_BITS_PER_WORD, &bits) == -1) {
 		return NULL;
 	}
 
@@ -309,7 +356,7 @@ spidata_16* spi_data_read_16(int dev, uint32_t size)
 	};
 
 	/* Try to transfer the data */
-	if(ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
+	if(_spi_ioctl(dev, SPI_IOC_MESSAGE(1), &tr) < 1){
 		return NULL;
 	}
 
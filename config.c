@@ -59,6 +59,19 @@ json_object *j_config;
  *     "listen_port": <port>,
  *     "keep_alive_time" : <keep alive time>,
  *     "network_timeout" : <network timeout>,
+ *     "max_body_size" : <maximum request body size, optional>,
+ *     "longrunners" : true/false, optional,
+ *     "hardware_root" : "/tmp/hwsim", optional,
+ *     "tracing" : true/false, optional,
+ *     "log_level" : "error"/"warning"/"info"/"debug", optional,
+ *     "blackbox_path" : "/dev/shm/dpt-breakout.bb", optional,
+ *     "gpio_backend" : "sysfs"/"chardev", optional,
+ *     "gpio_chip" : "/dev/gpiochip0", optional,
+ *     "gpio_sample_interval" : <milliseconds, 0 to disable>, optional,
+ *     "gpio_mmio" : [<GPIO port>, ...], optional,
+ *     "gpio_soc" : "ar9331"/"ar9341"/"ar9344"/"qca9531"/"qca9533", optional,
+ *     "gpio_long_press" : <milliseconds, more than 0>, optional,
+ *     "gpio_double_press" : <milliseconds, more than 0>, optional,
  * 
  *     "index_file" : "index.html",
  *     "document_root" : "/www",
@@ -87,6 +100,18 @@ bool config_parse(const char *configfile) {
     /* Put in default configuration */
     conf->ubus_timeout = UBUS_TIMEOUT;
     conf->stumon_heartbeat_interval = STUMON_HEARTBEAT_INTERVAL;
+    conf->max_body_size = MAX_BODY_SIZE;
+    conf->longrunners = true;
+    conf->hardware_root = "";
+    conf->tracing = false;
+    conf->blackbox_path = BLACKBOX_PATH;
+    conf->gpio_backend = GPIO_BACKEND;
+    conf->gpio_chip = GPIO_CHIP;
+    conf->gpio_sample_interval = GPIO_SAMPLE_INTERVAL;
+    conf->gpio_mmio_pins = 0;
+    conf->gpio_soc = GPIO_SOC;
+    conf->gpio_long_press = GPIO_LONG_PRESS_MS;
+    conf->gpio_double_press = GPIO_DOUBLE_PRESS_MS;
     
     json_object *j_daemon;
     json_object *j_listen_port;
@@ -139,6 +164,93 @@ bool config_parse(const char *configfile) {
     conf->stumon_reader_id = json_object_get_string(j_reader_id);
     conf->stumon_reader_key = json_object_get_string(j_reader_key);
     
+    /* Optional configuration */
+    json_object *j_max_body_size;
+    if(json_object_object_get_ex(j_config, "max_body_size", &j_max_body_size)) {
+        conf->max_body_size = json_object_get_int(j_max_body_size);
+    }
+    
+    json_object *j_longrunners;
+    if(json_object_object_get_ex(j_config, "longrunners", &j_longrunners)) {
+        conf->longrunners = json_object_get_boolean(j_longrunners);
+    }
+    
+    json_object *j_hardware_root;
+    if(json_object_object_get_ex(j_config, "hardware_root", &j_hardware_root)) {
+        conf->hardware_root = json_object_get_string(j_hardware_root);
+    }
+    
+    json_object *j_tracing;
+    if(json_object_object_get_ex(j_config, "tracing", &j_tracing)) {
+        conf->tracing = json_object_get_boolean(j_tracing);
+    }
+    
+    json_object *j_log_level;
+    if(json_object_object_get_ex(j_config, "log_level", &j_log_level)) {
+        int level = log_parse_level(json_object_get_string(j_log_level));
+        if(level < 0) {
+            fprintf(stderr, "Unknown log level: %s\n", json_object_get_string(j_log_level));
+        } else {
+            log_level = level;
+        }
+    }
+    
+    json_object *j_blackbox_path;
+    if(json_object_object_get_ex(j_config, "blackbox_path", &j_blackbox_path)) {
+        conf->blackbox_path = json_object_get_string(j_blackbox_path);
+    }
+    
+    json_object *j_gpio_backend;
+    if(json_object_object_get_ex(j_config, "gpio_backend", &j_gpio_backend)) {
+        conf->gpio_backend = json_object_get_string(j_gpio_backend);
+    }
+    
+    json_object *j_gpio_chip;
+    if(json_object_object_get_ex(j_config, "gpio_chip", &j_gpio_chip)) {
+        conf->gpio_chip = json_object_get_string(j_gpio_chip);
+    }
+    
+    json_object *j_gpio_sample_interval;
+    if(json_object_object_get_ex(j_config, "gpio_sample_interval", &j_gpio_sample_interval)) {
+        conf->gpio_sample_interval = json_object_get_int(j_gpio_sample_interval);
+    }
+    
+    json_object *j_gpio_mmio;
+    if(json_object_object_get_ex(j_config, "gpio_mmio", &j_gpio_mmio)) {
+        int i;
+        for(i = 0; i < json_object_array_length(j_gpio_mmio); ++i) {
+            int gpio = json_object_get_int(json_object_array_get_idx(j_gpio_mmio, i));
+            if(gpio >= 0 && gpio < 32) {
+                conf->gpio_mmio_pins |= 1u << gpio;
+            }
+        }
+    }
+    
+    json_object *j_gpio_soc;
+    if(json_object_object_get_ex(j_config, "gpio_soc", &j_gpio_soc)) {
+        conf->gpio_soc = json_object_get_string(j_gpio_soc);
+    }
+    
+    json_object *j_gpio_long_press;
+    if(json_object_object_get_ex(j_config, "gpio_long_press", &j_gpio_long_press)) {
+        int ms = json_object_get_int(j_gpio_long_press);
+        if(ms <= 0) {
+            fprintf(stderr, "Invalid gpio_long_press: %d, keeping %d ms\n", ms, conf->gpio_long_press);
+        } else {
+            conf->gpio_long_press = ms;
+        }
+    }
+    
+    json_object *j_gpio_double_press;
+    if(json_object_object_get_ex(j_config, "gpio_double_press", &j_gpio_double_press)) {
+        int ms = json_object_get_int(j_gpio_double_press);
+        if(ms <= 0) {
+            fprintf(stderr, "Invalid gpio_double_press: %d, keeping %d ms\n", ms, conf->gpio_double_press);
+        } else {
+            conf->gpio_double_press = ms;
+        }
+    }
+    
     return true;
 }
 
@@ -32,10 +32,28 @@
 #define CONFIG_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Compiled configuration */
 #define API_CALL_MAX_LEN                50                                      /* Maximum length of an API uri */
+#define API_BATCH_MAX                   64                                      /* Maximum number of operations in a batch request */
+#define API_ETAG_LEN                    32                                      /* Maximum length of an API response entity tag */
+#define MAX_BODY_SIZE                   65536                                   /* Default maximum size of a request body */
 #define CONFIG_BUFF_SIZE                1024                                    /* Maximum length of a configuration line */
+#define GPIO_EDGE_POLL_MS               50                                      /* Poll interval for ports without edge interrupts */
+#define PWM_MAX_CHANNELS                8                                       /* Maximum number of software PWM channels */
+#define PWM_MAX_FREQUENCY               200                                     /* Maximum software PWM frequency in Hz on sysfs and chardev ports */
+#define PWM_MAX_FREQUENCY_MMIO          10000                                   /* Maximum software PWM frequency in Hz on bit-banged ports */
+#define PWM_PRIORITY                    80                                      /* Real-time priority of the PWM thread */
+#define PWM_MAX_SLEEP_MS                10                                      /* Longest PWM sleep, bounds the delay of channel changes */
+#define GPIO_PULSE_MAX                  4096                                    /* Maximum number of pending GPIO pulses */
+#define GPIO_PULSE_PRIORITY             70                                      /* Real-time priority of the pulse scheduler thread */
+#define GPIO_WAVE_MAX                   8                                       /* Maximum number of running GPIO waveforms */
+#define GPIO_WAVE_MAX_STEPS             1024                                    /* Maximum number of steps of a GPIO waveform */
+#define GPIO_WAVE_PRIORITY              75                                      /* Real-time priority of the waveform executor thread */
+#define GPIO_WAVE_MIN_DELAY             500                                     /* Shortest waveform step in microseconds on sysfs and chardev ports */
+#define GPIO_WAVE_MIN_DELAY_MMIO        20                                      /* Shortest waveform step in microseconds on bit-banged ports */
+#define GPIO_DEBOUNCE_MAX_MS            1000                                    /* Longest GPIO debounce time in milliseconds */
 #define LOCAL_FIRMWARE_FILE             "/etc/dpt-firmware-version"             /* Location of the DPT-Firmware version file */ 
 #define CURL_USER_AGENT                 "dptboard-agent/1.0"                    /* User agent fo the DPT-Board when accessing external services */
 #define UBUS_NETWORK                    "network"                               /* ubus network daemon name */
@@ -51,6 +69,13 @@
 #define DOCUMENT_ROOT			"/www"                                  /* The document root */
 #define API_PATH			"/api"                                  /* The API uri */
 #define LISTEN_PORT			"80"                                    /* Port to listen to for incoming requests */
+#define BLACKBOX_PATH                   "/dev/shm/dpt-breakout.bb"              /* The crash surviving event ring */
+#define GPIO_BACKEND                    "sysfs"                                 /* The GPIO backend, "sysfs" or "chardev" */
+#define GPIO_CHIP                       "/dev/gpiochip0"                        /* The GPIO chip for the chardev backend */
+#define GPIO_SAMPLE_INTERVAL            500                                     /* Milliseconds between GPIO snapshot samples */
+#define GPIO_SOC                        "ar9331"                                /* The SoC of the memory mapped GPIO registers */
+#define GPIO_LONG_PRESS_MS              1000                                    /* Milliseconds a button is held for a long press */
+#define GPIO_DOUBLE_PRESS_MS            400                                     /* Longest release between the presses of a double press */
 
 /* Hardware SPI settings */
 #define SPI_DEVICE			"/dev/spidev0.1"                        /* The SPI device the server should use */
@@ -83,6 +108,7 @@
 #define STUMON_RFID_SCL                 20                                      /* The StuMON RFID reader SCL line */ 
 #define STUMON_RFID_IRQ                 19                                      /* The StuMON RFID reader IRQ line */
 #define STUMON_RFID_RST                 6                                       /* The StuMON RFID reader RST line */
+#define STUMON_DEBOUNCE_MS              20                                      /* Debounce time of the StuMON buttons in milliseconds */
 
 /* Dynamic configuration structure */
 typedef struct{
@@ -93,6 +119,18 @@ typedef struct{
     int keep_alive_time;                    /* Time in seconds for Keep-Alive connections */
     int network_timeout;                    /* The number of seconds before timeout is detected */
     int max_connections;                    /* The maximum number of connections to this server */
+    int max_body_size;                      /* The maximum size of a request body in bytes */
+    bool longrunners;                       /* When false no longrunner threads are started */
+    const char* hardware_root;              /* Prefix for sysfs and device paths, empty on real hardware */
+    bool tracing;                           /* When true requests are traced and get a Server-Timing header */
+    const char* blackbox_path;              /* The blackbox event ring file, empty to disable */
+    const char* gpio_backend;               /* The GPIO backend, "sysfs" or "chardev" */
+    const char* gpio_chip;                  /* The GPIO chip character device */
+    int gpio_sample_interval;               /* Milliseconds between GPIO snapshot samples, 0 to disable */
+    uint32_t gpio_mmio_pins;                /* GPIO ports driven through the SoC registers */
+    const char* gpio_soc;                   /* The SoC of the GPIO registers */
+    int gpio_long_press;                    /* Milliseconds a button is held for a long press */
+    int gpio_double_press;                  /* Longest release in milliseconds between the presses of a double press */
     
     const char* index_file;                 /* The file that is served by default */
     const char* document_root;              /* The document root */
@@ -39,18 +39,44 @@
 #include "database.h"
 #include "../config.h"
 #include "../logger.h"
+#include "../metrics.h"
 
 /* References to installed DAO modules for initializing*/
 #include "../firmware/firmware_dao.h"
 #include "../gpio/gpio_dao.h"
 #include "db_keyvalue.h"
 
+/**
+ * Record the duration of a finished statement.
+ * @param arg not used.
+ * @param sql the statement text.
+ * @param ns the duration of the statement in nanoseconds.
+ */
+static void dao_profile(void *arg, const char *sql, sqlite3_uint64 ns) {
+    metric_observe(&metric_db_duration, ns / 1000);
+}
+
+/**
+ * Install the statement profiler on every new database connection.
+ * @param db the new connection.
+ * @param err_msg not used.
+ * @param api not used.
+ * @return SQLITE_OK.
+ */
+static int dao_install_profile(sqlite3 *db, char **err_msg, const void *api) {
+    sqlite3_profile(db, dao_profile, NULL);
+    return SQLITE_OK;
+}
+
 /*
  * Create the database if it doesn't exist and migrate otherways.
  */
 int dao_create_db(void) {
     sqlite3 *db;
 
+    /* Time all statements, the DAO modules open their own connections */
+    sqlite3_auto_extension((void (*)(void)) dao_install_profile);
+
     /* Check if the file exists */
     if (access(conf->database, F_OK) != -1) {
         /* The database file exists, check if it can be opened */
@@ -0,0 +1,244 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   events.c
+ * Created on October 18, 2026, 2:05 PM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <libubox/uloop.h>
+
+#include "../logger.h"
+#include "events.h"
+
+/**
+ * Topic names, indexed by topic bit
+ */
+static const char* const topic_names[] = {
+    "gpio",
+    "rfid",
+    "stumon",
+    "wifi",
+};
+
+/* Events waiting to be delivered from the event loop */
+static LIST_HEAD(queue);
+static int queue_len = 0;
+static unsigned int next_id = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The subscribers, only touched from the event loop */
+static LIST_HEAD(subscribers);
+
+/* Pipe waking up the event loop */
+static int wake_fd = -1;
+static struct uloop_fd wake_ufd;
+
+/**
+ * Deliver all queued events to the subscribers.
+ * @param fd the wake up pipe.
+ * @param events the uloop events.
+ */
+static void events_deliver(struct uloop_fd *fd, unsigned int events)
+{
+    struct event_subscriber *sub, *tmp;
+    struct event *ev, *next;
+    char buf[64];
+    LIST_HEAD(pending);
+
+    /* Drain the wake up pipe */
+    while (read(fd->fd, buf, sizeof(buf)) > 0);
+
+    /* Take the queue */
+    pthread_mutex_lock(&queue_lock);
+    list_for_each_entry_safe(ev, next, &queue, list) {
+        list_move_tail(&ev->list, &pending);
+    }
+    queue_len = 0;
+    pthread_mutex_unlock(&queue_lock);
+
+    list_for_each_entry_safe(ev, next, &pending, list) {
+        list_for_each_entry_safe(sub, tmp, &subscribers, list) {
+            if (sub->topics & ev->topic)
+                sub->cb(sub, ev);
+        }
+
+        list_del(&ev->list);
+        free(ev);
+    }
+}
+
+/**
+ * Initialize the event bus. This must be called after the uloop event
+ * loop is initialized.
+ * @return true on success.
+ */
+bool events_init(void)
+{
+    int fds[2];
+
+    if (pipe(fds) < 0) {
+        log_message(LOG_ERROR, "Could not create event bus pipe\r\n");
+        return false;
+    }
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    wake_ufd.fd = fds[0];
+    wake_ufd.cb = events_deliver;
+    uloop_fd_add(&wake_ufd, ULOOP_READ);
+    wake_fd = fds[1];
+
+    return true;
+}
+
+/**
+ * Publish an event. This can be called from any thread, the event is
+ * delivered to the subscribers from the event loop.
+ * @param topic the topic of the event.
+ * @param data the event data, the reference is taken over.
+ */
+void events_publish(int topic, json_object *data)
+{
+    const char *str;
+    struct event *ev;
+    bool wake;
+    int len;
+
+    /* Nobody can listen before the bus is running */
+    if (wake_fd < 0) {
+        json_object_put(data);
+        return;
+    }
+
+    str = json_object_to_json_string(data);
+    len = strlen(str);
+
+    ev = malloc(sizeof(*ev) + len + 1);
+    if (ev == NULL) {
+        json_object_put(data);
+        return;
+    }
+
+    ev->topic = topic;
+    ev->len = len;
+    memcpy(ev->data, str, len + 1);
+    json_object_put(data);
+
+    pthread_mutex_lock(&queue_lock);
+
+    /* Drop the oldest event when the event loop can not keep up */
+    if (queue_len >= EVENT_QUEUE_MAX) {
+        struct event *old = list_first_entry(&queue, struct event, list);
+        list_del(&old->list);
+        free(old);
+        queue_len--;
+    }
+
+    ev->id = next_id++;
+    list_add_tail(&ev->list, &queue);
+    wake = queue_len++ == 0;
+
+    pthread_mutex_unlock(&queue_lock);
+
+    /* Only the first queued event needs to wake the loop */
+    if (wake && write(wake_fd, "e", 1) < 0 && errno != EAGAIN)
+        log_message(LOG_WARNING, "Could not wake up the event loop\r\n");
+}
+
+/**
+ * Subscribe to events, must be called from the event loop.
+ * @param sub the subscriber with topics and callback filled in.
+ */
+void events_subscribe(struct event_subscriber *sub)
+{
+    list_add_tail(&sub->list, &subscribers);
+}
+
+/**
+ * Unsubscribe from events, must be called from the event loop.
+ * @param sub the subscriber to remove.
+ */
+void events_unsubscribe(struct event_subscriber *sub)
+{
+    if (sub->list.next)
+        list_del(&sub->list);
+}
+
+/**
+ * Get the name of a single topic.
+ * @param topic the topic.
+ * @return the topic name.
+ */
+const char* events_topic_name(int topic)
+{
+    int i;
+
+    for (i = 0; i < sizeof(topic_names) / sizeof(topic_names[0]); ++i) {
+        if (topic == (1 << i))
+            return topic_names[i];
+    }
+
+    return "unknown";
+}
+
+/**
+ * Parse a comma separated list of topic names.
+ * @param list the topic names, for example "gpio,rfid".
+ * @return the topic mask, 0 when no known topic was found.
+ */
+int events_parse_topics(const char *list)
+{
+    int topics = 0;
+    size_t len;
+    int i;
+
+    while (*list) {
+        len = strcspn(list, ",&");
+
+        for (i = 0; i < sizeof(topic_names) / sizeof(topic_names[0]); ++i) {
+            if (len == strlen(topic_names[i]) && !strncmp(list, topic_names[i], len))
+                topics |= 1 << i;
+        }
+
+        list += len;
+        if (*list != ',')
+            break;
+        ++list;
+    }
+
+    return topics;
+}
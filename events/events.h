@@ -0,0 +1,117 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   events.h
+ * Created on October 18, 2026, 2:05 PM
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <json-c/json.h>
+#include <libubox/list.h>
+
+/* Event topics, can be combined into a subscription mask */
+#define EVENT_TOPIC_GPIO        (1 << 0)        /* GPIO pin changes */
+#define EVENT_TOPIC_RFID        (1 << 1)        /* RFID tag reads */
+#define EVENT_TOPIC_STUMON      (1 << 2)        /* StuMON score changes */
+#define EVENT_TOPIC_WIFI        (1 << 3)        /* WiFi state changes */
+#define EVENT_TOPIC_ALL         0x0F            /* All topics */
+
+#define EVENT_QUEUE_MAX         256             /* Maximum queued events before dropping */
+
+/**
+ * A published event
+ */
+struct event {
+    struct list_head list;      /* The event queue */
+    int topic;                  /* The topic of this event */
+    unsigned int id;            /* Sequence number of this event */
+    int len;                    /* The length of the serialized data */
+    char data[];                /* The event data serialized as JSON */
+};
+
+struct event_subscriber;
+
+/**
+ * Callback delivering an event to a subscriber.
+ * @param sub the subscriber.
+ * @param ev the event, only valid during the callback.
+ */
+typedef void (*event_handler)(struct event_subscriber *sub, const struct event *ev);
+
+/**
+ * An event subscriber
+ */
+struct event_subscriber {
+    struct list_head list;      /* The subscriber list */
+    int topics;                 /* Mask of subscribed topics */
+    event_handler cb;           /* Called for every matching event */
+};
+
+/**
+ * Initialize the event bus. This must be called after the uloop event
+ * loop is initialized.
+ * @return true on success.
+ */
+bool events_init(void);
+
+/**
+ * Publish an event. This can be called from any thread, the event is
+ * delivered to the subscribers from the event loop.
+ * @param topic the topic of the event.
+ * @param data the event data, the reference is taken over.
+ */
+void events_publish(int topic, json_object *data);
+
+/**
+ * Subscribe to events, must be called from the event loop.
+ * @param sub the subscriber with topics and callback filled in.
+ */
+void events_subscribe(struct event_subscriber *sub);
+
+/**
+ * Unsubscribe from events, must be called from the event loop.
+ * @param sub the subscriber to remove.
+ */
+void events_unsubscribe(struct event_subscriber *sub);
+
+/**
+ * Get the name of a single topic.
+ * @param topic the topic.
+ * @return the topic name.
+ */
+const char* events_topic_name(int topic);
+
+/**
+ * Parse a comma separated list of topic names.
+ * @param list the topic names, for example "gpio,rfid".
+ * @return the topic mask, 0 when no known topic was found.
+ */
+int events_parse_topics(const char *list);
+
+#endif
@@ -0,0 +1,150 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   events_sse.c
+ * Created on October 18, 2026, 2:05 PM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../uhttpd.h"
+#include "../client.h"
+#include "../logger.h"
+#include "events.h"
+#include "events_sse.h"
+
+/**
+ * A client listening on the event stream
+ */
+struct sse_client {
+    struct event_subscriber sub;        /* The event bus subscription */
+    struct tw_timer keepalive;          /* Timer sending keep alive comments */
+    struct client *cl;                  /* The client owning the stream */
+};
+
+/**
+ * Write an event to the stream.
+ * @param sub the subscription of the stream.
+ * @param ev the event to write.
+ */
+static void sse_send_event(struct event_subscriber *sub, const struct event *ev)
+{
+    struct sse_client *sc = container_of(sub, struct sse_client, sub);
+    struct ustream *us = sc->cl->us;
+
+    if (sc->cl->state == CLIENT_STATE_CLEANUP)
+        return;
+
+    /* Drop events for clients that do not keep up */
+    if (ustream_pending_data(us, true) > SSE_MAX_PENDING)
+        return;
+
+    ustream_printf(us, "id: %u\nevent: %s\ndata: ", ev->id, events_topic_name(ev->topic));
+    ustream_write(us, ev->data, ev->len, true);
+    ustream_write(us, "\n\n", 2, false);
+}
+
+/**
+ * Send a comment to keep proxies from closing the idle stream.
+ * @param timeout the keep alive timer.
+ */
+static void sse_keepalive(struct tw_timer *timeout)
+{
+    struct sse_client *sc = container_of(timeout, struct sse_client, keepalive);
+
+    if (sc->cl->state != CLIENT_STATE_CLEANUP)
+        ustream_write(sc->cl->us, ":\n\n", 3, false);
+
+    tw_timer_set(timeout, SSE_KEEPALIVE_TIME);
+}
+
+/**
+ * Free the stream when the client goes away.
+ * @param cl the client owning the stream.
+ */
+static void sse_free(struct client *cl)
+{
+    struct sse_client *sc = cl->dispatch.req_data;
+
+    events_unsubscribe(&sc->sub);
+    tw_timer_cancel(&sc->keepalive);
+    free(sc);
+    cl->dispatch.req_data = NULL;
+}
+
+/**
+ * Turn the request into a Server-Sent Events stream. The topics are
+ * selected with the query string, for example events?topics=gpio,rfid.
+ * Without topics all events are sent.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return true when the response was handled.
+ */
+bool events_sse_handle_request(struct client *cl, char *request)
+{
+    struct sse_client *sc;
+    char *query = strstr(request, "topics=");
+    int topics = EVENT_TOPIC_ALL;
+
+    if (query) {
+        topics = events_parse_topics(query + 7);
+        if (!topics) {
+            client_send_error(cl, 400, "Bad Request", "Unknown event topic");
+            return true;
+        }
+    }
+
+    sc = calloc(1, sizeof(*sc));
+    if (sc == NULL) {
+        client_send_error(cl, 500, "Internal Server Error", NULL);
+        return true;
+    }
+
+    /* The stream ends when the connection closes */
+    cl->request.connection_close = true;
+    write_http_header(cl, 200, "OK");
+    ustream_printf(cl->us, "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\nretry: 2000\n\n");
+    client_flush(cl);
+
+    /* Stop reading requests and never time out the stream */
+    tw_timer_cancel(&cl->idle);
+    cl->state = CLIENT_STATE_DONE;
+
+    sc->cl = cl;
+    sc->sub.topics = topics;
+    sc->sub.cb = sse_send_event;
+    sc->keepalive.cb = sse_keepalive;
+    events_subscribe(&sc->sub);
+    tw_timer_set(&sc->keepalive, SSE_KEEPALIVE_TIME);
+
+    cl->dispatch.req_data = sc;
+    cl->dispatch.req_free = sse_free;
+
+    log_message(LOG_DEBUG, "Client %d subscribed to events (0x%x)\r\n", cl->id, topics);
+    return true;
+}
@@ -35,6 +35,8 @@
 #include "config.h"
 #include "api.h"
 #include "logger.h"
+#include "httpdate.h"
+#include "metrics.h"
 
 /* Pending HTTP requests */
 static LIST_HEAD(pending_requests);
@@ -292,25 +294,6 @@ static const char * make_file_etag(struct stat *s, char *buf, int len) {
     return buf;
 }
 
-static time_t uh_file_date2unix(const char *date) {
-    struct tm t;
-
-    memset(&t, 0, sizeof (t));
-
-    if (strptime(date, "%a, %d %b %Y %H:%M:%S %Z", &t) != NULL)
-        return timegm(&t);
-
-    return 0;
-}
-
-static char * uh_file_unix2date(time_t ts, char *buf, int len) {
-    struct tm *t = gmtime(&ts);
-
-    strftime(buf, len, "%a, %d %b %Y %H:%M:%S GMT", t);
-
-    return buf;
-}
-
 static char *uh_file_header(struct client *cl, int idx) {
     if (!cl->dispatch.file.hdr[idx])
         return NULL;
@@ -322,12 +305,13 @@ static void uh_file_response_ok_hdrs(struct client *cl, struct stat *s) {
     char buf[128];
 
     if (s) {
-        ustream_printf(cl->us, "ETag: %s\r\n", make_file_etag(s, buf, sizeof (buf)));
-        ustream_printf(cl->us, "Last-Modified: %s\r\n",
-                uh_file_unix2date(s->st_mtime, buf, sizeof (buf)));
+        ustream_printf(cl->us, "ETag: %s\r\nLast-Modified: %s\r\nDate: %s\r\n",
+                make_file_etag(s, buf, sizeof (buf)),
+                httpdate_format(s->st_mtime),
+                httpdate_now());
+    } else {
+        ustream_printf(cl->us, "Date: %s\r\n", httpdate_now());
     }
-    ustream_printf(cl->us, "Date: %s\r\n",
-            uh_file_unix2date(time(NULL), buf, sizeof (buf)));
 }
 
 static void uh_file_response_200(struct client *cl, struct stat *s) {
@@ -337,6 +321,7 @@ static void uh_file_response_200(struct client *cl, struct stat *s) {
 
 static void uh_file_response_304(struct client *cl, struct stat *s) {
     write_http_header(cl, 304, "Not Modified");
+    metric_inc(&metric_not_modified);
 
     return uh_file_response_ok_hdrs(cl, s);
 }
@@ -375,7 +360,7 @@ static int uh_file_if_modified_since(struct client *cl, struct stat *s) {
     if (!hdr)
         return true;
 
-    if (uh_file_date2unix(hdr) >= s->st_mtime) {
+    if (httpdate_parse(hdr) >= s->st_mtime) {
         uh_file_response_304(cl, s);
         return false;
     }
@@ -426,7 +411,7 @@ static int uh_file_if_range(struct client *cl, struct stat *s) {
 static int uh_file_if_unmodified_since(struct client *cl, struct stat *s) {
     char *hdr = uh_file_header(cl, HDR_IF_UNMODIFIED_SINCE);
 
-    if (hdr && uh_file_date2unix(hdr) <= s->st_mtime) {
+    if (hdr && httpdate_parse(hdr) <= s->st_mtime) {
         uh_file_response_412(cl);
         return false;
     }
@@ -569,6 +554,7 @@ void uh_handle_request(struct client *cl) {
     char *url = blobmsg_data(blob_data(cl->hdr.head));
 
     req->redirect_status = 200;
+    trace_mark(&cl->trace.handler_start);
 
     /* Check if this is an api or file request */
     if (uh_path_match(conf->api_prefix, url)) {
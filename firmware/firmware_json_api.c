@@ -31,6 +31,7 @@
 #include <json-c/json.h>
 
 #include "../uhttpd.h"
+#include "../client.h"
 #include "../logger.h"
 #include "../helper.h"
 #include "firmware_json_api.h"
@@ -198,7 +199,7 @@ json_object* firmware_post_api_downloadupgrade(struct client *cl, char *request)
 json_object* firmware_post_api_apply(struct client *cl, char *request)
 {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_keep_settings = NULL;
     if(!json_object_object_get_ex(in_obj, "keep_settings", &j_keep_settings)) {
@@ -28,13 +28,23 @@
  * Created on June 20, 2014, 4:59 PM
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "../uhttpd.h"
 #include "../logger.h"
+#include "../helper.h"
+#include "../blackbox/blackbox.h"
 #include "gpio.h"
+#include "gpio_chardev.h"
+#include "gpio_snapshot.h"
+#include "gpio_mmio.h"
+#include "gpio_pulse.h"
 
 /* GPIO configuration, true if GPIO is exposed */
 const bool gpio_config[28] = {
@@ -68,25 +78,214 @@ const bool gpio_config[28] = {
     false, /* GPIO 27 */
 };
 
+/**
+ * An owner of a GPIO port
+ */
+struct gpio_owner {
+    const char *tag;            /* The owner tag, NULL when the slot is free */
+    int mode;                   /* GPIO_SHARED, GPIO_EXCLUSIVE or GPIO_READONLY */
+    int count;                  /* Number of claims of the owner */
+};
+
+/* The owners of every port and the total number of claims, the lock inherits priority in gpio_init */
+static struct gpio_owner gpio_owners[28][GPIO_MAX_OWNERS];
+static int gpio_claims[28];
+static pthread_mutex_t gpio_owner_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The GPIO backend in use */
+static int gpio_backend = GPIO_BACKEND_SYSFS;
+
+/* Ports driven through the memory mapped registers */
+static uint32_t gpio_mmio_pins = 0;
+
 /*
- * Reserve a GPIO for this program's use.
- * @gpio the GPIO pin to reserve.
- * @return true if the reservation was successful.
+ * Cached descriptors of the sysfs value and direction files, -1 when not
+ * opened yet. Callers use a descriptor without holding a reference, so a
+ * cached descriptor is never closed. When a port is exported again the
+ * new file is duplicated onto the same descriptor number.
+ */
+static int gpio_value_fd[28] = { [0 ... 27] = -1 };
+static int gpio_direction_fd[28] = { [0 ... 27] = -1 };
+
+/* Ports with the long-lived "api" claim of gpio_hold */
+static uint32_t gpio_held = 0;
+
+/**
+ * Open a GPIO sysfs file.
+ * @param gpio the GPIO port.
+ * @param name the name of the file, "value" or "direction".
+ * @return the file descriptor or -1 when the file could not be opened.
+ */
+static int _gpio_open(int gpio, const char *name)
+{
+    char path[PATH_MAX];
+    int fd;
+
+    /* Make the GPIO port path */
+    if (!helper_hw_path(path, sizeof(path), "/sys/class/gpio/gpio%d/%s", gpio, name)) {
+        return -1;
+    }
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        log_message(LOG_DEBUG, "gpio: could not open %s\r\n", path);
+    }
+
+    return fd;
+}
+
+/**
+ * Get the cached descriptor of a GPIO sysfs file, the file is opened and
+ * cached when this is the first access.
+ * @param cache the descriptor table of the file.
+ * @param gpio the GPIO port.
+ * @param name the name of the file, "value" or "direction".
+ * @return the file descriptor or -1 when the file could not be opened.
  */
-bool gpio_reserve(int gpio) {
+static int _gpio_fd(int *cache, int gpio, const char *name)
+{
+    int expected = -1;
+    int fd;
+
+    fd = __atomic_load_n(&cache[gpio], __ATOMIC_ACQUIRE);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    fd = _gpio_open(gpio, name);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* Another thread may have cached the file in the meantime */
+    if (!__atomic_compare_exchange_n(&cache[gpio], &expected, fd, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        close(fd);
+        fd = expected;
+    }
+
+    return fd;
+}
+
+/**
+ * Point the cached descriptor of a GPIO sysfs file at the file of a
+ * freshly exported port. The descriptor number stays the same, so
+ * callers still using it never see it closed or reused.
+ * @param cache the descriptor table of the file.
+ * @param gpio the GPIO port.
+ * @param name the name of the file, "value" or "direction".
+ */
+static void _gpio_fd_reopen(int *cache, int gpio, const char *name)
+{
+    int cached = __atomic_load_n(&cache[gpio], __ATOMIC_ACQUIRE);
+    int fd;
+
+    if (cached < 0) {
+        _gpio_fd(cache, gpio, name);
+        return;
+    }
+
+    fd = _gpio_open(gpio, name);
+    if (fd < 0) {
+        return;
+    }
+
+    if (dup3(fd, cached, O_CLOEXEC) < 0) {
+        log_message(LOG_DEBUG, "gpio: could not reopen the %s file of GPIO %d\r\n", name, gpio);
+    }
+    close(fd);
+}
+
+/**
+ * Select the GPIO backend from the configuration. When the character
+ * device can't be used the sysfs backend stays in use. The ports listed
+ * in "gpio_mmio" use the registers of the SoC instead.
+ * @return true when the configured backend is used.
+ */
+bool gpio_init(void)
+{
+    uint32_t mmio_pins = conf->gpio_mmio_pins;
+    uint32_t exposed = 0;
+    pthread_mutexattr_t attr;
+    int gpio;
+
+    /* Real-time pulse and wave threads release ports while a claim may be exporting one */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&gpio_owner_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    /* Ports used for bit-banging bypass the backend */
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (gpio_config[gpio]) {
+            exposed |= GPIO_MASK(gpio);
+        } else {
+            mmio_pins &= ~GPIO_MASK(gpio);
+        }
+    }
+
+    if (mmio_pins) {
+        if (gpio_mmio_open(conf->gpio_soc)) {
+            gpio_mmio_pins = mmio_pins;
+        } else {
+            log_message(LOG_WARNING, "gpio: not using registers for the ports in gpio_mmio\r\n");
+        }
+    }
+
+    if (strcmp(conf->gpio_backend, "chardev") == 0) {
+        if (!gpio_chardev_open(conf->gpio_chip, exposed & ~gpio_mmio_pins)) {
+            log_message(LOG_WARNING, "gpio: falling back to the sysfs backend\r\n");
+            return false;
+        }
+
+        gpio_backend = GPIO_BACKEND_CHARDEV;
+    } else if (strcmp(conf->gpio_backend, "sysfs") != 0) {
+        log_message(LOG_WARNING, "gpio: unknown backend %s, using sysfs\r\n", conf->gpio_backend);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Get the GPIO backend in use.
+ * @return GPIO_BACKEND_SYSFS or GPIO_BACKEND_CHARDEV.
+ */
+int gpio_get_backend(void)
+{
+    return gpio_backend;
+}
+
+/*
+ * Export a GPIO for this program's use.
+ * @gpio the GPIO pin to export.
+ * @return true if the export was successful.
+ */
+static bool _gpio_export(int gpio) {
     int fd; /* File descriptor for GPIO controller class */
     char buf[3]; /* Write buffer */
+    char path[PATH_MAX]; /* GPIO controller class path */
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return false;
     }
 
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        return true;
+    }
+
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        return gpio_chardev_reserve(gpio);
+    }
+
     /* Try to open GPIO controller class */
-    fd = open("/sys/class/gpio/export", O_WRONLY);
+    if (!helper_hw_path(path, sizeof(path), "/sys/class/gpio/export")) {
+        return false;
+    }
+    fd = open(path, O_WRONLY);
     if (fd < 0) {
         /* The file could not be opened */
-        log_message(LOG_DEBUG, "gpio_reserve: could not open /sys/class/gpio/export\r\n");
+        log_message(LOG_DEBUG, "gpio_export: could not open %s\r\n", path);
         return false;
     }
 
@@ -96,39 +295,61 @@ bool gpio_reserve(int gpio) {
     /* Try to reserve GPIO */
     if (write(fd, buf, strlen(buf)) < 0) {
         close(fd);
-        log_message(LOG_DEBUG, "gpio_reserve: could not write '%s' to /sys/class/gpio/export\r\n", buf);
+        log_message(LOG_DEBUG, "gpio_export: could not write '%s' to /sys/class/gpio/export\r\n", buf);
         return false;
     }
 
     /* Close the GPIO controller class */
     if (close(fd) < 0) {
-        log_message(LOG_DEBUG, "gpio_reserve: could not close /sys/class/gpio/export\r\n");
+        log_message(LOG_DEBUG, "gpio_export: could not close /sys/class/gpio/export\r\n");
         return false;
     }
 
+    /* The cached port files may still point at a previous export */
+    _gpio_fd_reopen(gpio_value_fd, gpio, "value");
+    _gpio_fd_reopen(gpio_direction_fd, gpio, "direction");
+
     /* Success */
     return true;
 }
 
 /*
- * Release a GPIO after use.
- * @gpio the GPIO pin to release.
- * @return true if the release was successful.
+ * Unexport a GPIO after use.
+ * @gpio the GPIO pin to unexport.
+ * @return true if the unexport was successful.
  */
-bool gpio_release(int gpio) {
+static bool _gpio_unexport(int gpio) {
     int fd; /* File descriptor for GPIO controller class */
     char buf[3]; /* Write buffer */
+    char path[PATH_MAX]; /* GPIO controller class path */
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return false;
     }
 
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        return true;
+    }
+
+    /* Requested lines are kept until the server exits */
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        return true;
+    }
+
+    /*
+     * The cached port files are left open, other threads may still use
+     * them. They fail until the port is exported again.
+     */
+
     /* Try to open GPIO controller class */
-    fd = open("/sys/class/gpio/unexport", O_WRONLY);
+    if (!helper_hw_path(path, sizeof(path), "/sys/class/gpio/unexport")) {
+        return false;
+    }
+    fd = open(path, O_WRONLY);
     if (fd < 0) {
         /* The file could not be opened */
-        log_message(LOG_DEBUG, "gpio_release: could not open /sys/class/gpio/unexport\r\n");
+        log_message(LOG_DEBUG, "gpio_unexport: could not open %s\r\n", path);
         return false;
     }
 
@@ -137,13 +358,13 @@ bool gpio_release(int gpio) {
 
     /* Try to release GPIO */
     if (write(fd, buf, strlen(buf)) < 0) {
-        log_message(LOG_DEBUG, "gpio_release: could not write /sys/class/gpio/unexport\r\n");
+        log_message(LOG_DEBUG, "gpio_unexport: could not write /sys/class/gpio/unexport\r\n");
         return false;
     }
 
     /* Close the GPIO controller class */
     if (close(fd) < 0) {
-        log_message(LOG_DEBUG, "gpio_release: could not close /sys/class/gpio/unexport\r\n");
+        log_message(LOG_DEBUG, "gpio_unexport: could not close /sys/class/gpio/unexport\r\n");
         return false;
     }
 
@@ -151,6 +372,187 @@ bool gpio_release(int gpio) {
     return true;
 }
 
+/**
+ * Check if a port is driven by an owner, read-only owners don't count.
+ * Must be called with the owner lock held.
+ * @param gpio the GPIO port.
+ * @return true when the port has a shared or exclusive owner.
+ */
+static bool _gpio_driven(int gpio)
+{
+    int i;
+
+    for (i = 0; i < GPIO_MAX_OWNERS; ++i) {
+        if (gpio_owners[gpio][i].tag && gpio_owners[gpio][i].mode != GPIO_READONLY) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Claim a GPIO port for an owner. The port is exported by the first claim
+ * and stays exported until the last claim is given back. Claims are
+ * counted per owner, every claim needs its own gpio_unclaim. An exclusive
+ * claim fails while an other owner drives the port and the other way
+ * around, read-only claims are always granted.
+ * @param gpio the GPIO port.
+ * @param owner the owner tag, a string that outlives the claim.
+ * @param mode GPIO_SHARED, GPIO_EXCLUSIVE or GPIO_READONLY.
+ * @return true when the port is claimed.
+ */
+bool gpio_claim(int gpio, const char *owner, int mode)
+{
+    struct gpio_owner *slot = NULL;
+    struct gpio_owner *free_slot = NULL;
+    const char *conflict = NULL;
+    struct gpio_owner *o;
+    int i;
+
+    /* Check if GPIO is valid */
+    if (gpio < 0 || gpio > 27 || !gpio_config[gpio]) {
+        return false;
+    }
+
+    pthread_mutex_lock(&gpio_owner_lock);
+
+    for (i = 0; i < GPIO_MAX_OWNERS; ++i) {
+        o = &gpio_owners[gpio][i];
+        if (!o->tag) {
+            if (!free_slot) {
+                free_slot = o;
+            }
+        } else if (strcmp(o->tag, owner) == 0) {
+            slot = o;
+        } else if (mode != GPIO_READONLY && o->mode != GPIO_READONLY &&
+                   (mode == GPIO_EXCLUSIVE || o->mode == GPIO_EXCLUSIVE)) {
+            conflict = o->tag;
+        }
+    }
+
+    /* An owner keeps the mode of its first claim */
+    if (slot && slot->mode != mode) {
+        log_message(LOG_WARNING, "gpio: %s can not claim GPIO %d in an other mode\r\n", owner, gpio);
+        pthread_mutex_unlock(&gpio_owner_lock);
+        return false;
+    }
+
+    if (conflict) {
+        log_message(LOG_DEBUG, "gpio: GPIO %d is held by %s, %s can not claim it\r\n", gpio, conflict, owner);
+        pthread_mutex_unlock(&gpio_owner_lock);
+        return false;
+    }
+
+    if (!slot) {
+        slot = free_slot;
+    }
+
+    if (!slot || (gpio_claims[gpio] == 0 && !_gpio_export(gpio))) {
+        pthread_mutex_unlock(&gpio_owner_lock);
+        return false;
+    }
+
+    slot->tag = owner;
+    slot->mode = mode;
+    slot->count++;
+    gpio_claims[gpio]++;
+    gpio_snapshot_reserved(gpio, _gpio_driven(gpio));
+
+    pthread_mutex_unlock(&gpio_owner_lock);
+    return true;
+}
+
+/**
+ * Give back a claim of a GPIO port, the port is released when it has no
+ * claims left.
+ * @param gpio the GPIO port.
+ * @param owner the owner tag used to claim the port.
+ * @return true when the owner held the port.
+ */
+bool gpio_unclaim(int gpio, const char *owner)
+{
+    struct gpio_owner *o;
+    int i;
+
+    if (gpio < 0 || gpio > 27) {
+        return false;
+    }
+
+    pthread_mutex_lock(&gpio_owner_lock);
+
+    for (i = 0; i < GPIO_MAX_OWNERS; ++i) {
+        o = &gpio_owners[gpio][i];
+        if (o->tag && strcmp(o->tag, owner) == 0) {
+            if (--o->count == 0) {
+                o->tag = NULL;
+            }
+            if (--gpio_claims[gpio] == 0) {
+                _gpio_unexport(gpio);
+            }
+            gpio_snapshot_reserved(gpio, _gpio_driven(gpio));
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gpio_owner_lock);
+    return i < GPIO_MAX_OWNERS;
+}
+
+/**
+ * Give a port a long-lived read-only "api" owner. The claim is taken the
+ * first time and kept, so one-shot reads and writes do not export and
+ * unexport the port every time.
+ * @param gpio the GPIO port.
+ * @return true when the port is held.
+ */
+bool gpio_hold(int gpio)
+{
+    if (gpio < 0 || gpio > 27) {
+        return false;
+    }
+
+    if (__atomic_load_n(&gpio_held, __ATOMIC_ACQUIRE) & GPIO_MASK(gpio)) {
+        return true;
+    }
+
+    if (!gpio_claim(gpio, "api", GPIO_READONLY)) {
+        return false;
+    }
+
+    /* Two callers may race to the first claim, one of them gives it back */
+    if (__atomic_fetch_or(&gpio_held, GPIO_MASK(gpio), __ATOMIC_ACQ_REL) & GPIO_MASK(gpio)) {
+        gpio_unclaim(gpio, "api");
+    }
+
+    return true;
+}
+
+/**
+ * Get the owners of a GPIO port.
+ * @param gpio the GPIO port.
+ * @param owners array of GPIO_MAX_OWNERS entries receiving the owner tags.
+ * @return the number of owners.
+ */
+int gpio_get_owners(int gpio, const char **owners)
+{
+    int i, n = 0;
+
+    if (gpio < 0 || gpio > 27) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&gpio_owner_lock);
+    for (i = 0; i < GPIO_MAX_OWNERS; ++i) {
+        if (gpio_owners[gpio][i].tag) {
+            owners[n++] = gpio_owners[gpio][i].tag;
+        }
+    }
+    pthread_mutex_unlock(&gpio_owner_lock);
+
+    return n;
+}
+
 /*
  * Set the direction of the GPIO port.
  * @gpio the GPIO pin to release.
@@ -158,40 +560,43 @@ bool gpio_release(int gpio) {
  * @return true if the direction could be successfully set.
  */
 bool gpio_set_direction(int gpio, int direction) {
+    const char *dir = direction == GPIO_OUT ? "out" : "in";
     int fd; /* File descriptor for GPIO port */
-    char buf[33]; /* Write buffer */
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return false;
     }
 
-    /* Make the GPIO port path */
-    sprintf(buf, "/sys/class/gpio/gpio%d/direction", gpio);
-
-    /* Try to open GPIO port for writing only */
-    fd = open(buf, O_WRONLY);
-    if (fd < 0) {
-        /* The file could not be opened */
-        return false;
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        gpio_mmio_set_direction(gpio, direction);
+        blackbox_record(BB_GPIO_DIR, gpio, direction, 0);
+        gpio_snapshot_update(gpio, -1, direction);
+        return true;
     }
 
-    /* Set the port direction */
-    if (direction == GPIO_OUT) {
-        if (write(fd, "out", 3) < 0) {
-            return false;
-        }
-    } else {
-        if (write(fd, "in", 2) < 0) {
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        if (!gpio_chardev_set_direction(gpio, direction)) {
             return false;
         }
+        blackbox_record(BB_GPIO_DIR, gpio, direction, 0);
+        gpio_snapshot_update(gpio, -1, direction);
+        return true;
     }
 
-    /* Close the GPIO port */
-    if (close(fd) < 0) {
+    fd = _gpio_fd(gpio_direction_fd, gpio, "direction");
+    if (fd < 0) {
+        return false;
+    }
+
+    /* Set the port direction */
+    if (pwrite(fd, dir, strlen(dir), 0) < 0) {
         return false;
     }
 
+    blackbox_record(BB_GPIO_DIR, gpio, direction, 0);
+    gpio_snapshot_update(gpio, -1, direction);
+
     /* Success */
     return true;
 }
@@ -206,44 +611,34 @@ bool gpio_set_direction(int gpio, int direction) {
 int gpio_get_direction(int gpio)
 {
     int fd; /* File descriptor for GPIO port */
-    char buf[33]; /* Write buffer */
     char dir;
-    int state;
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return GPIO_ERR;
     }
 
-    /* Make the GPIO port path */
-    sprintf(buf, "/sys/class/gpio/gpio%d/direction", gpio);
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        return gpio_mmio_get_direction(gpio);
+    }
+
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        return gpio_chardev_get_direction(gpio);
+    }
 
-    /* Try to open GPIO port fro writing only */
-    fd = open(buf, O_RDONLY);
+    fd = _gpio_fd(gpio_direction_fd, gpio, "direction");
     if (fd < 0) {
-        /* The file could not be opened */
-        log_message(LOG_DEBUG, "gpio_get_direction: could not open /sys/class/gpio/gpio%d/direction\r\n", gpio);
         return GPIO_ERR;
     }
-    
+
     /* Read the port direction */
-    if (read(fd, &dir, 1) < 0) {
-        close(fd);
+    if (pread(fd, &dir, 1, 0) != 1) {
         log_message(LOG_DEBUG, "gpio_get_direction: could not read /sys/class/gpio/gpio%d/direction\r\n", gpio);
         return GPIO_ERR;
     }
 
     /* Translate the port state into API state */
-    state = dir == 'i' ? GPIO_IN : GPIO_OUT;
-
-    /* Close the GPIO port */
-    if (close(fd) < 0) {
-        log_message(LOG_DEBUG, "gpio_get_direction: could not close /sys/class/gpio/gpio%d/direction\r\n", gpio);
-        return GPIO_ERR;
-    }
-
-    /* Success */
-    return state;    
+    return dir == 'i' ? GPIO_IN : GPIO_OUT;
 }
 
 /*
@@ -254,32 +649,34 @@ int gpio_get_direction(int gpio)
  */
 bool gpio_set_state(int gpio, int state) {
     int fd; /* File descriptor for GPIO port */
-    char buf[29]; /* Write buffer */
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return false;
     }
 
-    /* Make the GPIO port path */
-    sprintf(buf, "/sys/class/gpio/gpio%d/value", gpio);
+    /* Bit-banged ports skip the blackbox and the snapshot, the sampler sees them */
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        gpio_mmio_set_states(GPIO_MASK(gpio), state == GPIO_HIGH ? GPIO_MASK(gpio) : 0);
+        return true;
+    }
 
-    /* Try to open GPIO port */
-    fd = open(buf, O_WRONLY);
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        return gpio_set_states(GPIO_MASK(gpio), state == GPIO_HIGH ? GPIO_MASK(gpio) : 0);
+    }
+
+    fd = _gpio_fd(gpio_value_fd, gpio, "value");
     if (fd < 0) {
-        /* The file could not be opened */
         return false;
     }
 
     /* Set the port state */
-    if (write(fd, (state == GPIO_HIGH ? "1" : "0"), 1) < 0) {
+    if (pwrite(fd, (state == GPIO_HIGH ? "1" : "0"), 1, 0) < 0) {
         return false;
     }
 
-    /* Close the GPIO port */
-    if (close(fd) < 0) {
-        return false;
-    }
+    blackbox_record(BB_GPIO_STATE, gpio, state, 0);
+    gpio_snapshot_update(gpio, state, -1);
 
     /* Success */
     return true;
@@ -293,58 +690,216 @@ bool gpio_set_state(int gpio, int state) {
  */
 int gpio_get_state(int gpio) {
     int fd;             /* File descriptor for GPIO port */
-    char buf[29];       /* Write buffer */
     char port_state; /* Character indicating the port state */
-    int state; /* API integer indicating the port state */
 
     /* Check if GPIO is valid */
     if (gpio > 27 || !gpio_config[gpio]) {
         return GPIO_ERR;
     }
 
-    /* Make the GPIO port path */
-    sprintf(buf, "/sys/class/gpio/gpio%d/value", gpio);
+    if (gpio_mmio_pins & GPIO_MASK(gpio)) {
+        return gpio_mmio_get_states(GPIO_MASK(gpio)) ? GPIO_HIGH : GPIO_LOW;
+    }
+
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        uint32_t states;
+
+        if (!gpio_chardev_get_states(GPIO_MASK(gpio), &states)) {
+            return GPIO_ERR;
+        }
+        return states ? GPIO_HIGH : GPIO_LOW;
+    }
 
-    /* Try to open GPIO port */
-    fd = open(buf, O_RDONLY);
+    fd = _gpio_fd(gpio_value_fd, gpio, "value");
     if (fd < 0) {
-        /* The file could not be opened */
-        log_message(LOG_DEBUG, "gpio_get_state: could not open /sys/class/gpio/gpio%d/value\r\n", gpio);
         return GPIO_ERR;
     }
 
     /* Read the port state */
-    if (read(fd, &port_state, 1) < 0) {
-        close(fd);
+    if (pread(fd, &port_state, 1, 0) != 1) {
         log_message(LOG_DEBUG, "gpio_get_state: could not read /sys/class/gpio/gpio%d/value\r\n", gpio);
         return GPIO_ERR;
     }
 
     /* Translate the port state into API state */
-    state = port_state == '1' ? GPIO_HIGH : GPIO_LOW;
+    return port_state == '1' ? GPIO_HIGH : GPIO_LOW;
+}
 
-    /* Close the GPIO port */
-    if (close(fd) < 0) {
-        log_message(LOG_DEBUG, "gpio_get_state: could not close /sys/class/gpio/gpio%d/value\r\n", gpio);
-        return GPIO_ERR;
+/**
+ * Check if a GPIO port is bit-banged through the GPIO registers.
+ * @param gpio the GPIO port.
+ * @return true when writes to the port are not system calls.
+ */
+bool gpio_is_mmio(int gpio)
+{
+    return gpio >= 0 && gpio < 28 && (gpio_mmio_pins & GPIO_MASK(gpio));
+}
+
+/**
+ * Check that a port mask only holds exposed GPIO ports.
+ * @param mask the port mask.
+ * @return true if all ports in the mask are exposed.
+ */
+static bool _gpio_mask_valid(uint32_t mask)
+{
+    int gpio;
+
+    for (gpio = 0; gpio < 32; ++gpio) {
+        if ((mask & GPIO_MASK(gpio)) && (gpio > 27 || !gpio_config[gpio])) {
+            return false;
+        }
     }
 
-    /* Return the state */
-    return state;
+    return mask != 0;
+}
+
+/**
+ * Write the states of a group of GPIO ports.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @param record true to record the states in the blackbox and snapshot.
+ * @return true if all states could be set.
+ */
+static bool _gpio_write_states(uint32_t mask, uint32_t states, bool record)
+{
+    bool ok = true;
+    int gpio, fd;
+
+    if (!_gpio_mask_valid(mask)) {
+        return false;
+    }
+
+    /* The register ports are written at once */
+    if (mask & gpio_mmio_pins) {
+        gpio_mmio_set_states(mask & gpio_mmio_pins, states);
+        mask &= ~gpio_mmio_pins;
+        if (!mask) {
+            return true;
+        }
+    }
+
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        if (!gpio_chardev_set_states(mask, states)) {
+            return false;
+        }
+
+        for (gpio = 0; gpio < 28 && record; ++gpio) {
+            if (mask & GPIO_MASK(gpio)) {
+                int state = (states & GPIO_MASK(gpio)) ? GPIO_HIGH : GPIO_LOW;
+
+                blackbox_record(BB_GPIO_STATE, gpio, state, 0);
+                gpio_snapshot_update(gpio, state, -1);
+            }
+        }
+        return true;
+    }
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (!(mask & GPIO_MASK(gpio))) {
+            continue;
+        }
+
+        if (record) {
+            ok &= gpio_set_state(gpio, (states & GPIO_MASK(gpio)) ? GPIO_HIGH : GPIO_LOW);
+        } else {
+            fd = _gpio_fd(gpio_value_fd, gpio, "value");
+            ok &= fd >= 0 && pwrite(fd, (states & GPIO_MASK(gpio)) ? "1" : "0", 1, 0) == 1;
+        }
+    }
+
+    return ok;
+}
+
+/**
+ * Set the states of a group of GPIO ports, with the character device
+ * backend this is a single ioctl.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true if all states could be set.
+ */
+bool gpio_set_states(uint32_t mask, uint32_t states)
+{
+    return _gpio_write_states(mask, states, true);
+}
+
+/**
+ * Set the states of a group of GPIO ports without recording them in the
+ * blackbox or the snapshot. Meant for writers that toggle ports at a
+ * high rate, like the PWM engine.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true if all states could be set.
+ */
+bool gpio_set_states_quiet(uint32_t mask, uint32_t states)
+{
+    return _gpio_write_states(mask, states, false);
+}
+
+/**
+ * Get the states of a group of GPIO ports, with the character device
+ * backend this is a single ioctl.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @param states the states of the ports.
+ * @return true if all states could be read.
+ */
+bool gpio_get_states(uint32_t mask, uint32_t *states)
+{
+    int gpio, state;
+
+    if (!_gpio_mask_valid(mask)) {
+        return false;
+    }
+
+    /* The register ports are read at once */
+    *states = gpio_mmio_pins ? gpio_mmio_get_states(mask & gpio_mmio_pins) : 0;
+    mask &= ~gpio_mmio_pins;
+    if (!mask) {
+        return true;
+    }
+
+    if (gpio_backend == GPIO_BACKEND_CHARDEV) {
+        uint32_t chardev_states;
+
+        if (!gpio_chardev_get_states(mask, &chardev_states)) {
+            return false;
+        }
+        *states |= chardev_states;
+        return true;
+    }
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (mask & GPIO_MASK(gpio)) {
+            state = gpio_get_state(gpio);
+            if (state == GPIO_ERR) {
+                return false;
+            }
+            if (state == GPIO_HIGH) {
+                *states |= GPIO_MASK(gpio);
+            }
+        }
+    }
+
+    return true;
 }
 
 /*
- * Reserve a GPIO and set it as output. Than set the state
- * and release the port.
+ * Claim a GPIO and set it as output. Than set the state
+ * and give the port back, the port stays held by gpio_hold.
  * @gpio the GPIO pin to set the state for.
  * @state 1 or 0
  * @return true if the state change was successful.
  */
 bool gpio_write_and_close(int gpio, int state) {
-    return gpio_reserve(gpio)
-            && gpio_set_direction(gpio, GPIO_OUT)
-            && gpio_set_state(gpio, state)
-            && gpio_release(gpio);
+    bool ok;
+
+    if (!gpio_hold(gpio) || !gpio_claim(gpio, "oneshot-write", GPIO_SHARED)) {
+        return false;
+    }
+
+    ok = gpio_set_direction(gpio, GPIO_OUT) && gpio_set_state(gpio, state);
+    gpio_unclaim(gpio, "oneshot-write");
+
+    return ok;
 }
 
 /*
@@ -357,61 +912,18 @@ bool gpio_write_and_close(int gpio, int state) {
 int gpio_read_and_close(int gpio) {
     int state; /* The port state */
 
-    /* Reserve the port */
-    if (!gpio_reserve(gpio)) {
+    /* The long-lived read-only claim keeps the port exported */
+    if (!gpio_hold(gpio)) {
         return -1;
     }
 
     /* Read the port */
     state = gpio_get_state(gpio);
 
-    if (!gpio_release(gpio)) {
-        return -1;
-    }
-
     /* Return the port state */
     return state;
 }
 
-/**
- * Arguments for the gpio pulse thread
- */
-struct _gpio_pulse_args {
-    int port;
-    int useconds;
-    int mode;
-};
-
-/**
- * The entry point of the GPIO pulse thread.
- * @param args the arguments for this entry point. 
- */
-static void* _gpio_pulse(void *arguments) {
-    struct _gpio_pulse_args *args = (struct _gpio_pulse_args*) arguments;
-    
-    /* Set port as output */
-    gpio_set_direction(args->port, GPIO_OUT);
-    
-    /* Execute the command */
-    if(args->mode == GPIO_ACT_HIGH) {
-        gpio_set_state(args->port, GPIO_HIGH);
-        usleep(args->useconds);
-        gpio_set_state(args->port, GPIO_LOW);
-        
-    } else {
-        gpio_set_state(args->port, GPIO_LOW);
-        usleep(args->useconds);
-        gpio_set_state(args->port, GPIO_HIGH);
-    }
-    
-    /* Release the port */
-    gpio_release(args->port);
-    
-    /* Free the arguments*/
-    free(arguments);
-    pthread_exit(NULL);
-}
-
 /**
  * Pulse a GPIO port for a certain number of micro seconcs. 
  * @param gpio the GPIO port to pulse
@@ -421,24 +933,5 @@ static void* _gpio_pulse(void *arguments) {
  */
 bool gpio_pulse(int gpio, int useconds, int mode)
 {
-    pthread_t thread;
-    struct _gpio_pulse_args *args = (struct _gpio_pulse_args*) calloc(1, sizeof(struct _gpio_pulse_args));
-
-    args->port = gpio;
-    args->useconds = useconds;
-    args->mode = mode;
-    
-    /* Reserve the port */
-    if(!gpio_reserve(gpio)){
-        return false;
-    }
-    
-    /* Start the download */
-    if(pthread_create(&thread, NULL, _gpio_pulse, (void*) args) != 0) {
-        log_message(LOG_ERROR, "Could not start GPIO pulse thread\r\n");
-        return false;
-    }
-    pthread_detach(thread);
-    
-    return true;
+    return useconds >= 0 && gpio_pulse_schedule(gpio, 0, useconds, mode) != 0;
 }
@@ -32,6 +32,7 @@
 #define GPIO_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Direction macros */
 #define GPIO_OUT	0		/* GPIO output direction */
@@ -48,22 +49,88 @@
 #define GPIO_ACT_LOW    0               /* Use GPIO as active low mode */
 #define GPIO_ACT_HIGH   1               /* Use GPIO as active high mode */       
 
+/* GPIO backends */
+#define GPIO_BACKEND_SYSFS      0               /* Use the sysfs GPIO interface */
+#define GPIO_BACKEND_CHARDEV    1               /* Use the GPIO chip character device */
+
+/* GPIO edges */
+#define GPIO_EDGE_RISING        1               /* Report low to high transitions */
+#define GPIO_EDGE_FALLING       2               /* Report high to low transitions */
+#define GPIO_EDGE_BOTH          3               /* Report all transitions */
+
+/* GPIO ownership modes */
+#define GPIO_SHARED             0               /* Held together with other shared owners */
+#define GPIO_EXCLUSIVE          1               /* No other owner may drive the port */
+#define GPIO_READONLY           2               /* Only reads the port, never conflicts */
+#define GPIO_MAX_OWNERS         4               /* Maximum number of owners of a port */
+
+/* Bit of a GPIO port in a port mask */
+#define GPIO_MASK(gpio)         (1u << (gpio))
+
+/**
+ * Handler for GPIO edges, called from the event loop.
+ * @param gpio the GPIO port.
+ * @param state the new state of the port.
+ * @param timestamp the monotonic time of the edge in nanoseconds.
+ * @param ctx the context given to gpio_on_edge.
+ */
+typedef void (*gpio_edge_handler)(int gpio, int state, uint64_t timestamp, void *ctx);
+
 /* GPIO layout map */
 extern const bool gpio_config[28];
 
-/*
- * Reserve a GPIO for this program's use.
- * @gpio the GPIO pin to reserve.
- * @return true if the reservation was successful.
+/**
+ * Select the GPIO backend from the configuration. When the character
+ * device can't be used the sysfs backend stays in use. Must be called
+ * before any port is claimed.
+ * @return true when the configured backend is used.
  */
-bool gpio_reserve(int gpio);
+bool gpio_init(void);
 
-/*
- * Release a GPIO after use.
- * @gpio the GPIO pin to release.
- * @return true if the release was successful.
+/**
+ * Get the GPIO backend in use.
+ * @return GPIO_BACKEND_SYSFS or GPIO_BACKEND_CHARDEV.
+ */
+int gpio_get_backend(void);
+
+/**
+ * Claim a GPIO port for an owner. The port is exported by the first claim
+ * and stays exported until the last claim is given back. Claims are
+ * counted per owner, every claim needs its own gpio_unclaim. An exclusive
+ * claim fails while an other owner drives the port and the other way
+ * around, read-only claims are always granted.
+ * @param gpio the GPIO port.
+ * @param owner the owner tag, a string that outlives the claim.
+ * @param mode GPIO_SHARED, GPIO_EXCLUSIVE or GPIO_READONLY.
+ * @return true when the port is claimed.
+ */
+bool gpio_claim(int gpio, const char *owner, int mode);
+
+/**
+ * Give back a claim of a GPIO port, the port is released when it has no
+ * claims left.
+ * @param gpio the GPIO port.
+ * @param owner the owner tag used to claim the port.
+ * @return true when the owner held the port.
+ */
+bool gpio_unclaim(int gpio, const char *owner);
+
+/**
+ * Get the owners of a GPIO port.
+ * @param gpio the GPIO port.
+ * @param owners array of GPIO_MAX_OWNERS entries receiving the owner tags.
+ * @return the number of owners.
  */
-bool gpio_release(int gpio);
+int gpio_get_owners(int gpio, const char **owners);
+
+/**
+ * Give a port a long-lived read-only "api" owner. The claim is taken the
+ * first time and kept, so one-shot reads and writes do not export and
+ * unexport the port every time.
+ * @param gpio the GPIO port.
+ * @return true when the port is held.
+ */
+bool gpio_hold(int gpio);
 
 /*
  * Set the direction of the GPIO port.
@@ -97,9 +164,44 @@ bool gpio_set_state(int gpio, int state);
  */
 int gpio_get_state(int gpio);
 
+/**
+ * Check if a GPIO port is bit-banged through the GPIO registers.
+ * @param gpio the GPIO port.
+ * @return true when writes to the port are not system calls.
+ */
+bool gpio_is_mmio(int gpio);
+
+/**
+ * Set the states of a group of GPIO ports, with the character device
+ * backend this is a single ioctl.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true if all states could be set.
+ */
+bool gpio_set_states(uint32_t mask, uint32_t states);
+
+/**
+ * Set the states of a group of GPIO ports without recording them in the
+ * blackbox or the snapshot. Meant for writers that toggle ports at a
+ * high rate, like the PWM engine.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true if all states could be set.
+ */
+bool gpio_set_states_quiet(uint32_t mask, uint32_t states);
+
+/**
+ * Get the states of a group of GPIO ports, with the character device
+ * backend this is a single ioctl.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @param states the states of the ports.
+ * @return true if all states could be read.
+ */
+bool gpio_get_states(uint32_t mask, uint32_t *states);
+
 /*
- * Reserve a GPIO and set it as output. Than set the state
- * and release the port.
+ * Claim a GPIO and set it as output. Than set the state
+ * and give the port back, the port stays held by gpio_hold.
  * @gpio the GPIO pin to set the state for.
  * @state 1 or 0
  * @return true if the state change was successful.
@@ -124,4 +226,24 @@ int gpio_read_and_close(int gpio);
  */
 bool gpio_pulse(int gpio, int useconds, int mode);
 
+/**
+ * Call a handler from the event loop when an input port changes. The port
+ * must be claimed and configured as input. Edge interrupts are used when
+ * the backend supports them, otherwise the port is polled every
+ * GPIO_EDGE_POLL_MS milliseconds. This must be called after the uloop
+ * event loop is initialized.
+ * @param gpio the GPIO port to watch.
+ * @param edges GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH.
+ * @param cb the handler to call.
+ * @param ctx the context for the handler.
+ * @return true on success.
+ */
+bool gpio_on_edge(int gpio, int edges, gpio_edge_handler cb, void *ctx);
+
+/**
+ * Stop watching a port.
+ * @param gpio the GPIO port.
+ */
+void gpio_edge_remove(int gpio);
+
 #endif /* GPIO_H_ */
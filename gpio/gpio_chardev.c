@@ -0,0 +1,422 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_chardev.c
+ * Created on October 18, 2026, 10:05 AM
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include <libubox/uloop.h>
+
+#include "../logger.h"
+#include "gpio.h"
+#include "gpio_chardev.h"
+#include "gpio_edge.h"
+
+#define GPIO_CHARDEV_CONSUMER   "dpt-breakout"      /* Consumer label of the line request */
+
+/* The chip and the line request, all lines are requested once when the chip is opened */
+static pthread_mutex_t chardev_lock = PTHREAD_MUTEX_INITIALIZER;
+static int chip_fd = -1;
+static int request_fd = -1;
+
+static uint32_t lines;          /* GPIO ports in the line request */
+static uint32_t outputs;        /* GPIO ports configured as output */
+static uint32_t values;         /* Last known states of the output ports */
+static uint32_t edges;          /* GPIO ports with edge events */
+
+/* The line request in the event loop, edge events are read from it */
+static struct uloop_fd event_ufd = { .fd = -1 };
+
+/**
+ * Translate a GPIO port mask into a mask of line request indexes.
+ * @param mask the GPIO port mask.
+ * @return the line request mask.
+ */
+static uint64_t _chardev_to_request(uint32_t mask)
+{
+    uint64_t bits = 0;
+    int gpio, index = 0;
+
+    for (gpio = 0; gpio < 32; ++gpio) {
+        if (lines & GPIO_MASK(gpio)) {
+            if (mask & GPIO_MASK(gpio)) {
+                bits |= 1ULL << index;
+            }
+            ++index;
+        }
+    }
+
+    return bits;
+}
+
+/**
+ * Translate a mask of line request indexes into a GPIO port mask.
+ * @param bits the line request mask.
+ * @return the GPIO port mask.
+ */
+static uint32_t _chardev_from_request(uint64_t bits)
+{
+    uint32_t mask = 0;
+    int gpio, index = 0;
+
+    for (gpio = 0; gpio < 32; ++gpio) {
+        if (lines & GPIO_MASK(gpio)) {
+            if (bits & (1ULL << index)) {
+                mask |= GPIO_MASK(gpio);
+            }
+            ++index;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * Fill in the line configuration from the known directions and output
+ * states. Lines without a direction are left as they are.
+ * @param config the configuration to fill in.
+ */
+static void _chardev_config(struct gpio_v2_line_config *config)
+{
+    memset(config, 0, sizeof(*config));
+
+    config->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+    config->attrs[0].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    config->attrs[0].mask = _chardev_to_request(outputs);
+
+    config->attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    config->attrs[1].attr.values = _chardev_to_request(values & outputs);
+    config->attrs[1].mask = _chardev_to_request(outputs);
+
+    config->attrs[2].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+    config->attrs[2].attr.flags = GPIO_V2_LINE_FLAG_INPUT;
+    config->attrs[2].mask = _chardev_to_request(lines & ~outputs & ~edges);
+
+    config->attrs[3].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+    config->attrs[3].attr.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    config->attrs[3].mask = _chardev_to_request(lines & ~outputs & edges);
+
+    config->num_attrs = 4;
+}
+
+/**
+ * Read the line events and pass them on.
+ * @param u the line request.
+ * @param events the uloop events.
+ */
+static void _chardev_events(struct uloop_fd *u, unsigned int events)
+{
+    struct gpio_v2_line_event ev[16];
+    ssize_t len;
+    int i;
+
+    while ((len = read(u->fd, ev, sizeof(ev))) > 0) {
+        for (i = 0; i < len / (ssize_t) sizeof(ev[0]); ++i) {
+            gpio_edge_dispatch(ev[i].offset, ev[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? GPIO_HIGH : GPIO_LOW,
+                    ev[i].timestamp_ns);
+        }
+    }
+}
+
+/**
+ * Open the GPIO chip and request the GPIO ports as one group of lines.
+ * Lines used by an other consumer are left out. Every line keeps the
+ * direction and output state it has, so held outputs do not glitch.
+ * @param chip the path of the chip character device.
+ * @param mask the GPIO ports to request.
+ * @return true on success.
+ */
+bool gpio_chardev_open(const char *chip, uint32_t mask)
+{
+    struct gpio_v2_line_request req;
+    struct gpio_v2_line_values lv;
+    struct gpio_v2_line_info info;
+    struct gpiochip_info chip_info;
+    int gpio;
+
+    chip_fd = open(chip, O_RDWR | O_CLOEXEC);
+    if (chip_fd < 0) {
+        log_message(LOG_ERROR, "gpio_chardev: could not open %s: %s\r\n", chip, strerror(errno));
+        return false;
+    }
+
+    if (ioctl(chip_fd, GPIO_GET_CHIPINFO_IOCTL, &chip_info) < 0) {
+        log_message(LOG_ERROR, "gpio_chardev: %s is not a GPIO chip\r\n", chip);
+        goto fail;
+    }
+
+    /* Take the lines that are free and remember their direction */
+    for (gpio = 0; gpio < 32; ++gpio) {
+        if (!(mask & GPIO_MASK(gpio))) {
+            continue;
+        }
+
+        memset(&info, 0, sizeof(info));
+        info.offset = gpio;
+        if (gpio >= chip_info.lines || ioctl(chip_fd, GPIO_V2_GET_LINEINFO_IOCTL, &info) < 0 ||
+                (info.flags & GPIO_V2_LINE_FLAG_USED)) {
+            log_message(LOG_WARNING, "gpio_chardev: line %d is not available\r\n", gpio);
+            continue;
+        }
+
+        lines |= GPIO_MASK(gpio);
+        if (info.flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+            outputs |= GPIO_MASK(gpio);
+        }
+    }
+
+    if (!lines) {
+        log_message(LOG_ERROR, "gpio_chardev: no lines available on %s\r\n", chip);
+        goto fail;
+    }
+
+    memset(&req, 0, sizeof(req));
+    for (gpio = 0; gpio < 32; ++gpio) {
+        if (lines & GPIO_MASK(gpio)) {
+            req.offsets[req.num_lines++] = gpio;
+        }
+    }
+    strncpy(req.consumer, GPIO_CHARDEV_CONSUMER, sizeof(req.consumer) - 1);
+
+    /* Outputs are requested as they are, their state is not known yet */
+    _chardev_config(&req.config);
+    req.config.attrs[0].mask = 0;
+    req.config.attrs[1].mask = 0;
+
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+        log_message(LOG_ERROR, "gpio_chardev: could not request the lines: %s\r\n", strerror(errno));
+        goto fail;
+    }
+    request_fd = req.fd;
+
+    /* Registered once from the main thread, the request fd never changes */
+    fcntl(request_fd, F_SETFL, fcntl(request_fd, F_GETFL) | O_NONBLOCK);
+    event_ufd.fd = request_fd;
+    event_ufd.cb = _chardev_events;
+    uloop_fd_add(&event_ufd, ULOOP_READ);
+
+    /* Learn the states of the outputs, later configurations keep them */
+    memset(&lv, 0, sizeof(lv));
+    lv.mask = _chardev_to_request(outputs);
+    if (outputs && ioctl(request_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) == 0) {
+        values = _chardev_from_request(lv.bits) & outputs;
+    }
+
+    log_message(LOG_INFO, "gpio_chardev: using %s (%s, %u lines)\r\n", chip, chip_info.label, chip_info.lines);
+    return true;
+
+fail:
+    close(chip_fd);
+    chip_fd = -1;
+    lines = 0;
+    outputs = 0;
+    return false;
+}
+
+/**
+ * Check that a GPIO port is part of the line request. All lines are
+ * requested when the chip is opened, so reserving a port is free.
+ * @param gpio the GPIO port to reserve.
+ * @return true when the port is part of the line request.
+ */
+bool gpio_chardev_reserve(int gpio)
+{
+    return (lines & GPIO_MASK(gpio)) != 0;
+}
+
+/**
+ * Set the direction of a reserved GPIO port.
+ * @param gpio the GPIO port.
+ * @param direction GPIO_IN or GPIO_OUT.
+ * @return true on success.
+ */
+bool gpio_chardev_set_direction(int gpio, int direction)
+{
+    struct gpio_v2_line_config config;
+    uint32_t old_outputs;
+    bool ok = false;
+
+    pthread_mutex_lock(&chardev_lock);
+
+    if (!(lines & GPIO_MASK(gpio))) {
+        goto out;
+    }
+
+    /* Outputs have no edge events */
+    if (direction == GPIO_OUT && (edges & GPIO_MASK(gpio))) {
+        goto out;
+    }
+
+    old_outputs = outputs;
+    if (direction == GPIO_OUT) {
+        outputs |= GPIO_MASK(gpio);
+    } else {
+        outputs &= ~GPIO_MASK(gpio);
+    }
+
+    _chardev_config(&config);
+    if (ioctl(request_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0) {
+        log_message(LOG_DEBUG, "gpio_chardev: could not set direction of line %d: %s\r\n", gpio, strerror(errno));
+        outputs = old_outputs;
+        goto out;
+    }
+
+    ok = true;
+
+out:
+    pthread_mutex_unlock(&chardev_lock);
+    return ok;
+}
+
+/**
+ * Get the direction of a reserved GPIO port.
+ * @param gpio the GPIO port.
+ * @return GPIO_IN, GPIO_OUT or GPIO_ERR when the port is not reserved.
+ */
+int gpio_chardev_get_direction(int gpio)
+{
+    int direction = GPIO_ERR;
+
+    pthread_mutex_lock(&chardev_lock);
+    if (lines & GPIO_MASK(gpio)) {
+        direction = (outputs & GPIO_MASK(gpio)) ? GPIO_OUT : GPIO_IN;
+    }
+    pthread_mutex_unlock(&chardev_lock);
+
+    return direction;
+}
+
+/**
+ * Enable or disable edge events of a reserved input port. Events are read
+ * from the line request by the event loop and passed to
+ * gpio_edge_dispatch.
+ * @param gpio the GPIO port.
+ * @param enable true to report both edges, false to stop.
+ * @return true on success.
+ */
+bool gpio_chardev_set_edge(int gpio, bool enable)
+{
+    struct gpio_v2_line_config config;
+    uint32_t old_edges;
+    bool ok = false;
+
+    pthread_mutex_lock(&chardev_lock);
+
+    if (!(lines & GPIO_MASK(gpio)) || (outputs & GPIO_MASK(gpio))) {
+        goto out;
+    }
+
+    old_edges = edges;
+    if (enable) {
+        edges |= GPIO_MASK(gpio);
+    } else {
+        edges &= ~GPIO_MASK(gpio);
+    }
+
+    _chardev_config(&config);
+    if (ioctl(request_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0) {
+        log_message(LOG_DEBUG, "gpio_chardev: could not set edges of line %d: %s\r\n", gpio, strerror(errno));
+        edges = old_edges;
+        goto out;
+    }
+
+    ok = true;
+
+out:
+    pthread_mutex_unlock(&chardev_lock);
+    return ok;
+}
+
+/**
+ * Set the states of a group of reserved GPIO ports.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true on success.
+ */
+bool gpio_chardev_set_states(uint32_t mask, uint32_t states)
+{
+    struct gpio_v2_line_values lv;
+    bool ok = false;
+
+    pthread_mutex_lock(&chardev_lock);
+
+    if (!mask || (mask & ~lines)) {
+        goto out;
+    }
+
+    lv.mask = _chardev_to_request(mask);
+    lv.bits = _chardev_to_request(states & mask);
+    if (ioctl(request_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lv) < 0) {
+        goto out;
+    }
+
+    values = (values & ~mask) | (states & mask);
+    ok = true;
+
+out:
+    pthread_mutex_unlock(&chardev_lock);
+    return ok;
+}
+
+/**
+ * Get the states of a group of reserved GPIO ports.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @param states the states of the ports.
+ * @return true on success.
+ */
+bool gpio_chardev_get_states(uint32_t mask, uint32_t *states)
+{
+    struct gpio_v2_line_values lv;
+    bool ok = false;
+
+    pthread_mutex_lock(&chardev_lock);
+
+    if (!mask || (mask & ~lines)) {
+        goto out;
+    }
+
+    lv.mask = _chardev_to_request(mask);
+    lv.bits = 0;
+    if (ioctl(request_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) < 0) {
+        goto out;
+    }
+
+    *states = _chardev_from_request(lv.bits) & mask;
+    ok = true;
+
+out:
+    pthread_mutex_unlock(&chardev_lock);
+    return ok;
+}
@@ -0,0 +1,105 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_chardev.h
+ * Created on October 18, 2026, 10:05 AM
+ */
+
+#ifndef GPIO_CHARDEV_H_
+#define GPIO_CHARDEV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * GPIO backend on the character device of a GPIO chip. All exposed lines
+ * are requested once as one line request, so many ports can be read or
+ * written with a single ioctl and the request never has to be replaced.
+ * The GPIO port number is the line offset on the chip.
+ */
+
+/**
+ * Open the GPIO chip and request the GPIO ports as one group of lines.
+ * Lines used by an other consumer are left out. Every line keeps the
+ * direction and output state it has, so held outputs do not glitch.
+ * Call from the main thread after uloop_init, the line request is added
+ * to the event loop here for edge events.
+ * @param chip the path of the chip character device.
+ * @param mask the GPIO ports to request.
+ * @return true on success.
+ */
+bool gpio_chardev_open(const char *chip, uint32_t mask);
+
+/**
+ * Check that a GPIO port is part of the line request. All lines are
+ * requested when the chip is opened, so reserving a port is free.
+ * @param gpio the GPIO port to reserve.
+ * @return true when the port is part of the line request.
+ */
+bool gpio_chardev_reserve(int gpio);
+
+/**
+ * Set the direction of a reserved GPIO port.
+ * @param gpio the GPIO port.
+ * @param direction GPIO_IN or GPIO_OUT.
+ * @return true on success.
+ */
+bool gpio_chardev_set_direction(int gpio, int direction);
+
+/**
+ * Get the direction of a reserved GPIO port.
+ * @param gpio the GPIO port.
+ * @return GPIO_IN, GPIO_OUT or GPIO_ERR when the port is not reserved.
+ */
+int gpio_chardev_get_direction(int gpio);
+
+/**
+ * Set the states of a group of reserved GPIO ports.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ * @return true on success.
+ */
+bool gpio_chardev_set_states(uint32_t mask, uint32_t states);
+
+/**
+ * Get the states of a group of reserved GPIO ports.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @param states the states of the ports.
+ * @return true on success.
+ */
+bool gpio_chardev_get_states(uint32_t mask, uint32_t *states);
+
+/**
+ * Enable or disable edge events of a reserved input port. Events are read
+ * from the line request by the event loop and passed to
+ * gpio_edge_dispatch.
+ * @param gpio the GPIO port.
+ * @param enable true to report both edges, false to stop.
+ * @return true on success.
+ */
+bool gpio_chardev_set_edge(int gpio, bool enable);
+
+#endif
@@ -0,0 +1,399 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_debounce.c
+ * Created on October 18, 2026, 2:20 PM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <json-c/json.h>
+
+#include <libubox/uloop.h>
+
+#include "../config.h"
+#include "../logger.h"
+#include "../events/events.h"
+#include "gpio.h"
+#include "gpio_debounce.h"
+
+#define NSEC_PER_MSEC           1000000ULL
+#define NSEC_PER_SEC            1000000000ULL
+
+/**
+ * Button event names, indexed by event
+ */
+static const char* const event_names[] = {
+    "unknown",
+    "press",
+    "release",
+    "long-press",
+    "double-press",
+};
+
+/**
+ * The filter state of a debounced port. The filter integrates the time
+ * the raw level differs from the accepted level, the new level is
+ * accepted when that time reaches the debounce time. The window filter
+ * restarts on every edge, the integrator filter counts down while the raw
+ * level is back at the accepted level so short glitches do not restart it.
+ */
+struct gpio_button {
+    bool enabled;               /* True when the port is debounced */
+    int ms;                     /* The debounce time in milliseconds */
+    int filter;                 /* GPIO_DEBOUNCE_WINDOW or GPIO_DEBOUNCE_INTEGRATOR */
+    bool active_low;            /* True when a low level means pressed */
+    gpio_button_handler cb;     /* The handler, can be NULL */
+    void *ctx;                  /* The context for the handler */
+    int raw;                    /* The last reported level */
+    int stable;                 /* The accepted level */
+    uint64_t integ;             /* Integrated time towards the raw level in nanoseconds */
+    uint64_t updated;           /* Monotonic time the filter was last updated in nanoseconds */
+    bool pressed;               /* True while the button is pressed */
+    bool held;                  /* True when the current press became a long press */
+    uint64_t released;          /* Time of the last short press release, 0 when none */
+    unsigned long presses;      /* Number of presses */
+    unsigned long glitches;     /* Number of edges dropped by the filter */
+    struct uloop_timeout settle;/* Fires when the raw level would be accepted */
+    struct uloop_timeout hold;  /* Fires when a press becomes a long press */
+};
+
+/* The debounce state of every port, only touched from the event loop */
+static struct gpio_button buttons[28];
+
+/**
+ * Get the monotonic time, the clock of the edge timestamps.
+ * @return the time in nanoseconds.
+ */
+static uint64_t _debounce_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Report a button event to the handler and the event bus.
+ * @param b the debounced port.
+ * @param event the button event.
+ * @param timestamp the time of the event in nanoseconds.
+ */
+static void _debounce_emit(struct gpio_button *b, int event, uint64_t timestamp)
+{
+    int gpio = b - buttons;
+    json_object *jevent;
+
+    jevent = json_object_new_object();
+    json_object_object_add(jevent, "pin", json_object_new_int(gpio));
+    json_object_object_add(jevent, "button", json_object_new_string(gpio_button_event_name(event)));
+    events_publish(EVENT_TOPIC_GPIO, jevent);
+
+    if (b->cb) {
+        b->cb(gpio, event, timestamp, b->ctx);
+    }
+}
+
+/**
+ * Advance the filter to a point in time.
+ * @param b the debounced port.
+ * @param now the monotonic time in nanoseconds.
+ */
+static void _debounce_integrate(struct gpio_button *b, uint64_t now)
+{
+    uint64_t elapsed;
+
+    /* Late edges are counted at the time the filter already reached */
+    if (now <= b->updated) {
+        return;
+    }
+
+    elapsed = now - b->updated;
+    b->updated = now;
+
+    if (b->raw != b->stable) {
+        b->integ += elapsed;
+    } else if (b->filter == GPIO_DEBOUNCE_INTEGRATOR) {
+        b->integ = b->integ > elapsed ? b->integ - elapsed : 0;
+    } else {
+        b->integ = 0;
+    }
+}
+
+/**
+ * Accept the raw level and report the resulting button events.
+ * @param b the debounced port, the integrated time must have reached the
+ * debounce time.
+ */
+static void _debounce_accept(struct gpio_button *b)
+{
+    uint64_t window = b->ms * NSEC_PER_MSEC;
+    uint64_t timestamp;
+    bool twice = false;
+
+    /* The level was accepted the moment the window was reached */
+    timestamp = b->updated - (b->integ - window);
+
+    b->stable = b->raw;
+    b->integ = 0;
+    b->pressed = (b->stable == GPIO_HIGH) != b->active_low;
+    uloop_timeout_cancel(&b->settle);
+
+    if (b->pressed) {
+        b->presses++;
+        b->held = false;
+        twice = b->released && timestamp - b->released <= conf->gpio_double_press * NSEC_PER_MSEC;
+        b->released = 0;
+        uloop_timeout_set(&b->hold, conf->gpio_long_press);
+
+        _debounce_emit(b, GPIO_BUTTON_PRESS, timestamp);
+        if (twice && b->enabled) {
+            _debounce_emit(b, GPIO_BUTTON_DOUBLE_PRESS, timestamp);
+        }
+    } else {
+        /* A long press does not start a double press */
+        b->released = b->held ? 0 : timestamp;
+        uloop_timeout_cancel(&b->hold);
+
+        _debounce_emit(b, GPIO_BUTTON_RELEASE, timestamp);
+    }
+}
+
+/**
+ * Arm the settle timer for the moment the raw level would be accepted, or
+ * cancel it when the raw level is the accepted level.
+ * @param b the debounced port.
+ */
+static void _debounce_arm(struct gpio_button *b)
+{
+    uint64_t window = b->ms * NSEC_PER_MSEC;
+
+    if (b->raw == b->stable) {
+        uloop_timeout_cancel(&b->settle);
+        return;
+    }
+
+    /* Round up, an early timer would only be armed again */
+    uloop_timeout_set(&b->settle, (window - b->integ + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+}
+
+/**
+ * Settle timer of a debounced port.
+ * @param t the settle timer.
+ */
+static void _debounce_settle(struct uloop_timeout *t)
+{
+    struct gpio_button *b = container_of(t, struct gpio_button, settle);
+
+    _debounce_integrate(b, _debounce_now());
+
+    if (b->raw != b->stable && b->integ >= b->ms * NSEC_PER_MSEC) {
+        _debounce_accept(b);
+    } else {
+        _debounce_arm(b);
+    }
+}
+
+/**
+ * Hold timer of a debounced port, reports a long press.
+ * @param t the hold timer.
+ */
+static void _debounce_hold(struct uloop_timeout *t)
+{
+    struct gpio_button *b = container_of(t, struct gpio_button, hold);
+
+    if (b->enabled && b->pressed) {
+        b->held = true;
+        _debounce_emit(b, GPIO_BUTTON_LONG_PRESS, _debounce_now());
+    }
+}
+
+/**
+ * Edge handler of a debounced port.
+ * @param gpio the GPIO port.
+ * @param state the state of the port after the transition.
+ * @param timestamp the time of the transition in nanoseconds.
+ * @param ctx the debounced port.
+ */
+static void _debounce_edge(int gpio, int state, uint64_t timestamp, void *ctx)
+{
+    struct gpio_button *b = ctx;
+
+    _debounce_integrate(b, timestamp);
+
+    /* The previous level held long enough before the settle timer ran */
+    if (b->raw != b->stable && b->integ >= b->ms * NSEC_PER_MSEC) {
+        _debounce_accept(b);
+        if (!b->enabled) {
+            return;
+        }
+    }
+
+    if (state == b->raw) {
+        return;
+    }
+
+    if (state == b->stable) {
+        b->glitches++;
+    }
+
+    if (b->filter == GPIO_DEBOUNCE_WINDOW) {
+        b->integ = 0;
+    }
+
+    b->raw = state;
+    _debounce_arm(b);
+}
+
+/**
+ * Debounce an input port. The port must be claimed and configured as
+ * input, it is watched with gpio_on_edge. This must be called from the
+ * event loop.
+ * @param gpio the GPIO port.
+ * @param ms the debounce time in milliseconds.
+ * @param filter GPIO_DEBOUNCE_WINDOW or GPIO_DEBOUNCE_INTEGRATOR.
+ * @param active_low true when a low level means pressed.
+ * @param cb the handler for the button events, can be NULL.
+ * @param ctx the context for the handler.
+ * @return true on success.
+ */
+bool gpio_debounce(int gpio, int ms, int filter, bool active_low, gpio_button_handler cb, void *ctx)
+{
+    struct gpio_button *b;
+    int state;
+
+    if (gpio < 0 || gpio > 27 || ms < 1 || ms > GPIO_DEBOUNCE_MAX_MS) {
+        return false;
+    }
+
+    if (filter != GPIO_DEBOUNCE_WINDOW && filter != GPIO_DEBOUNCE_INTEGRATOR) {
+        return false;
+    }
+
+    state = gpio_get_state(gpio);
+    if (state == GPIO_ERR) {
+        return false;
+    }
+
+    gpio_debounce_remove(gpio);
+
+    b = &buttons[gpio];
+    memset(b, 0, sizeof(*b));
+    b->ms = ms;
+    b->filter = filter;
+    b->active_low = active_low;
+    b->cb = cb;
+    b->ctx = ctx;
+    b->raw = state;
+    b->stable = state;
+    b->updated = _debounce_now();
+    b->pressed = (state == GPIO_HIGH) != active_low;
+    b->settle.cb = _debounce_settle;
+    b->hold.cb = _debounce_hold;
+
+    if (!gpio_on_edge(gpio, GPIO_EDGE_BOTH, _debounce_edge, b)) {
+        log_message(LOG_WARNING, "gpio_debounce: could not watch GPIO %d\r\n", gpio);
+        return false;
+    }
+
+    b->enabled = true;
+    return true;
+}
+
+/**
+ * Stop debouncing a port, this also stops watching it for edges.
+ * @param gpio the GPIO port.
+ */
+void gpio_debounce_remove(int gpio)
+{
+    struct gpio_button *b;
+
+    if (gpio < 0 || gpio > 27 || !buttons[gpio].enabled) {
+        return;
+    }
+
+    b = &buttons[gpio];
+    b->enabled = false;
+    uloop_timeout_cancel(&b->settle);
+    uloop_timeout_cancel(&b->hold);
+    gpio_edge_remove(gpio);
+}
+
+/**
+ * Get the debounced state of a port.
+ * @param gpio the GPIO port.
+ * @return GPIO_LOW or GPIO_HIGH, GPIO_ERR when the port is not debounced.
+ */
+int gpio_debounce_get_state(int gpio)
+{
+    if (gpio < 0 || gpio > 27 || !buttons[gpio].enabled) {
+        return GPIO_ERR;
+    }
+
+    return buttons[gpio].stable;
+}
+
+/**
+ * Get the debounce settings and state of a port.
+ * @param gpio the GPIO port.
+ * @param info receives the settings and state.
+ * @return true when the port is debounced.
+ */
+bool gpio_debounce_get_info(int gpio, struct gpio_button_info *info)
+{
+    struct gpio_button *b;
+
+    if (gpio < 0 || gpio > 27 || !buttons[gpio].enabled) {
+        return false;
+    }
+
+    b = &buttons[gpio];
+    info->ms = b->ms;
+    info->filter = b->filter;
+    info->active_low = b->active_low;
+    info->state = b->stable;
+    info->pressed = b->pressed;
+    info->presses = b->presses;
+    info->glitches = b->glitches;
+
+    return true;
+}
+
+/**
+ * Get the name of a button event.
+ * @param event the button event.
+ * @return the event name, for example "press".
+ */
+const char* gpio_button_event_name(int event)
+{
+    if (event < GPIO_BUTTON_PRESS || event > GPIO_BUTTON_DOUBLE_PRESS) {
+        return event_names[0];
+    }
+
+    return event_names[event];
+}
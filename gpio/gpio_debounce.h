@@ -0,0 +1,121 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_debounce.h
+ * Created on October 18, 2026, 2:20 PM
+ */
+
+#ifndef GPIO_DEBOUNCE_H_
+#define GPIO_DEBOUNCE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Input debouncing. The edges of a filtered port are run through a
+ * software filter on the event loop, a new level is only accepted once it
+ * held long enough. The accepted changes are reported as button events,
+ * a long press is reported when a button is held for conf->gpio_long_press
+ * milliseconds and a double press when a button is pressed again within
+ * conf->gpio_double_press milliseconds after its release. All events are
+ * also published on the gpio event topic.
+ */
+
+/* Debounce filters */
+#define GPIO_DEBOUNCE_WINDOW        0           /* The new level must hold for the whole debounce time */
+#define GPIO_DEBOUNCE_INTEGRATOR    1           /* Time at the new level minus time at the old one must reach the debounce time */
+
+/* Button events */
+#define GPIO_BUTTON_PRESS           1           /* The button was pressed */
+#define GPIO_BUTTON_RELEASE         2           /* The button was released */
+#define GPIO_BUTTON_LONG_PRESS      3           /* The button is held for a long press */
+#define GPIO_BUTTON_DOUBLE_PRESS    4           /* The button was pressed twice, follows the second press */
+
+/**
+ * Handler called from the event loop for the events of a debounced port.
+ * @param gpio the GPIO port.
+ * @param event the button event.
+ * @param timestamp the monotonic time the event was detected in nanoseconds.
+ * @param ctx the context given to gpio_debounce.
+ */
+typedef void (*gpio_button_handler)(int gpio, int event, uint64_t timestamp, void *ctx);
+
+/**
+ * Debounce settings and state of a port
+ */
+struct gpio_button_info {
+    int ms;                     /* The debounce time in milliseconds */
+    int filter;                 /* GPIO_DEBOUNCE_WINDOW or GPIO_DEBOUNCE_INTEGRATOR */
+    bool active_low;            /* True when a low level means pressed */
+    int state;                  /* The debounced state of the port */
+    bool pressed;               /* True while the button is pressed */
+    unsigned long presses;      /* Number of presses */
+    unsigned long glitches;     /* Number of edges dropped by the filter */
+};
+
+/**
+ * Debounce an input port. The port must be claimed and configured as
+ * input, it is watched with gpio_on_edge. This must be called from the
+ * event loop.
+ * @param gpio the GPIO port.
+ * @param ms the debounce time in milliseconds.
+ * @param filter GPIO_DEBOUNCE_WINDOW or GPIO_DEBOUNCE_INTEGRATOR.
+ * @param active_low true when a low level means pressed.
+ * @param cb the handler for the button events, can be NULL.
+ * @param ctx the context for the handler.
+ * @return true on success.
+ */
+bool gpio_debounce(int gpio, int ms, int filter, bool active_low, gpio_button_handler cb, void *ctx);
+
+/**
+ * Stop debouncing a port, this also stops watching it for edges.
+ * @param gpio the GPIO port.
+ */
+void gpio_debounce_remove(int gpio);
+
+/**
+ * Get the debounced state of a port.
+ * @param gpio the GPIO port.
+ * @return GPIO_LOW or GPIO_HIGH, GPIO_ERR when the port is not debounced.
+ */
+int gpio_debounce_get_state(int gpio);
+
+/**
+ * Get the debounce settings and state of a port.
+ * @param gpio the GPIO port.
+ * @param info receives the settings and state.
+ * @return true when the port is debounced.
+ */
+bool gpio_debounce_get_info(int gpio, struct gpio_button_info *info);
+
+/**
+ * Get the name of a button event.
+ * @param event the button event.
+ * @return the event name, for example "press".
+ */
+const char* gpio_button_event_name(int event);
+
+#endif
@@ -0,0 +1,314 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_edge.c
+ * Created on October 18, 2026, 3:40 PM
+ */
+
+/*
+ * Edge events for GPIO input ports. The chardev backend delivers line
+ * events from its line request. With sysfs the "edge" file of the port is
+ * armed and the value file is watched by the event loop, sysfs signals a
+ * change as an exceptional condition on that file. Ports that can't raise
+ * interrupts, like those of the hardware simulator, are polled.
+ *
+ * Both edges are always armed so the state of a port is known, the
+ * requested edges are filtered here.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+
+#include <libubox/uloop.h>
+
+#include "../config.h"
+#include "../logger.h"
+#include "../helper.h"
+#include "gpio.h"
+#include "gpio_chardev.h"
+#include "gpio_edge.h"
+#include "gpio_snapshot.h"
+
+/* sysfs flags a change as an error, keep the fd where uloop supports it */
+#ifdef ULOOP_ERROR_CB
+#define GPIO_EDGE_ULOOP_FLAGS   (ULOOP_READ | ULOOP_EDGE_TRIGGER | ULOOP_ERROR_CB)
+#else
+#define GPIO_EDGE_ULOOP_FLAGS   (ULOOP_READ | ULOOP_EDGE_TRIGGER)
+#endif
+
+/**
+ * A watched GPIO port
+ */
+struct gpio_edge {
+    gpio_edge_handler cb;       /* The handler, NULL when not watched */
+    void *ctx;                  /* The context of the handler */
+    int edges;                  /* The edges to report */
+    int state;                  /* The last known state */
+    bool polled;                /* True when polled from the timer */
+    struct uloop_fd ufd;        /* The sysfs value file */
+};
+
+/* The watched ports, only touched from the event loop */
+static struct gpio_edge gpio_edges[28];
+
+/* Timer polling the ports without edge interrupts */
+static struct uloop_timeout poll_timer;
+
+/**
+ * Get the monotonic time.
+ * @return the time in nanoseconds.
+ */
+static uint64_t _gpio_edge_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Report a new state of a watched port to its handler.
+ * @param gpio the GPIO port.
+ * @param state the new state.
+ * @param timestamp the time of the transition in nanoseconds.
+ */
+static void _gpio_edge_report(int gpio, int state, uint64_t timestamp)
+{
+    struct gpio_edge *e = &gpio_edges[gpio];
+
+    if (!e->cb || state == GPIO_ERR || state == e->state) {
+        return;
+    }
+
+    e->state = state;
+    gpio_snapshot_update(gpio, state, -1);
+    if (e->edges & (state == GPIO_HIGH ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING)) {
+        e->cb(gpio, state, timestamp, e->ctx);
+    }
+}
+
+/**
+ * Report a transition of a watched port detected by a backend. Must be
+ * called from the event loop.
+ * @param gpio the GPIO port.
+ * @param state the state of the port after the transition.
+ * @param timestamp the monotonic time of the transition in nanoseconds.
+ */
+void gpio_edge_dispatch(int gpio, int state, uint64_t timestamp)
+{
+    if (gpio < 0 || gpio > 27) {
+        return;
+    }
+
+    _gpio_edge_report(gpio, state, timestamp);
+}
+
+/**
+ * Poll the ports without edge interrupts.
+ * @param t the poll timer.
+ */
+static void _gpio_edge_poll(struct uloop_timeout *t)
+{
+    uint64_t now = _gpio_edge_now();
+    bool polled = false;
+    int gpio;
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (gpio_edges[gpio].cb && gpio_edges[gpio].polled) {
+            _gpio_edge_report(gpio, gpio_get_state(gpio), now);
+            polled = true;
+        }
+    }
+
+    if (polled) {
+        uloop_timeout_set(t, GPIO_EDGE_POLL_MS);
+    }
+}
+
+/**
+ * Handle a change notification on a sysfs value file.
+ * @param u the value file.
+ * @param events the uloop events.
+ */
+static void _gpio_edge_sysfs(struct uloop_fd *u, unsigned int events)
+{
+    struct gpio_edge *e = container_of(u, struct gpio_edge, ufd);
+    char value;
+
+    /* Older uloop versions drop the fd on the error flag */
+    if (!u->registered) {
+        u->error = false;
+        uloop_fd_add(u, GPIO_EDGE_ULOOP_FLAGS);
+    }
+
+    /* Reading the value acknowledges the notification */
+    if (pread(u->fd, &value, 1, 0) != 1) {
+        return;
+    }
+
+    _gpio_edge_report(e - gpio_edges, value == '1' ? GPIO_HIGH : GPIO_LOW, _gpio_edge_now());
+}
+
+/**
+ * Write the edge file of a sysfs port.
+ * @param gpio the GPIO port.
+ * @param edge the edge setting, "both" or "none".
+ * @return true on success.
+ */
+static bool _gpio_edge_sysfs_arm(int gpio, const char *edge)
+{
+    char path[PATH_MAX];
+    bool ok;
+    int fd;
+
+    if (!helper_hw_path(path, sizeof(path), "/sys/class/gpio/gpio%d/edge", gpio)) {
+        return false;
+    }
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    ok = write(fd, edge, strlen(edge)) == strlen(edge);
+    close(fd);
+    return ok;
+}
+
+/**
+ * Watch the sysfs value file of a port for change notifications.
+ * @param gpio the GPIO port.
+ * @return true when the port raises interrupts.
+ */
+static bool _gpio_edge_sysfs_watch(int gpio)
+{
+    struct gpio_edge *e = &gpio_edges[gpio];
+    char path[PATH_MAX];
+    char value;
+
+    if (!_gpio_edge_sysfs_arm(gpio, "both")) {
+        return false;
+    }
+
+    if (!helper_hw_path(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio)) {
+        return false;
+    }
+
+    e->ufd.fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (e->ufd.fd < 0) {
+        return false;
+    }
+
+    /* Regular files, like those of the simulator, can't be watched */
+    e->ufd.cb = _gpio_edge_sysfs;
+    if (pread(e->ufd.fd, &value, 1, 0) != 1 || uloop_fd_add(&e->ufd, GPIO_EDGE_ULOOP_FLAGS) < 0) {
+        close(e->ufd.fd);
+        e->ufd.fd = -1;
+        _gpio_edge_sysfs_arm(gpio, "none");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Call a handler from the event loop when an input port changes. The port
+ * must be claimed and configured as input. Edge interrupts are used when
+ * the backend supports them, otherwise the port is polled every
+ * GPIO_EDGE_POLL_MS milliseconds. This must be called after the uloop
+ * event loop is initialized.
+ * @param gpio the GPIO port to watch.
+ * @param edges GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH.
+ * @param cb the handler to call.
+ * @param ctx the context for the handler.
+ * @return true on success.
+ */
+bool gpio_on_edge(int gpio, int edges, gpio_edge_handler cb, void *ctx)
+{
+    struct gpio_edge *e;
+    bool irq;
+
+    /* Check if GPIO is valid */
+    if (gpio < 0 || gpio > 27 || !gpio_config[gpio] || !cb || !(edges & GPIO_EDGE_BOTH)) {
+        return false;
+    }
+
+    gpio_edge_remove(gpio);
+
+    e = &gpio_edges[gpio];
+    e->cb = cb;
+    e->ctx = ctx;
+    e->edges = edges;
+    e->state = gpio_get_state(gpio);
+    e->ufd.fd = -1;
+
+    if (gpio_get_backend() == GPIO_BACKEND_CHARDEV) {
+        irq = gpio_chardev_set_edge(gpio, true);
+    } else {
+        irq = _gpio_edge_sysfs_watch(gpio);
+    }
+
+    if (!irq) {
+        log_message(LOG_DEBUG, "gpio_on_edge: no interrupts for GPIO %d, polling\r\n", gpio);
+        e->polled = true;
+        poll_timer.cb = _gpio_edge_poll;
+        if (!poll_timer.pending) {
+            uloop_timeout_set(&poll_timer, GPIO_EDGE_POLL_MS);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Stop watching a port.
+ * @param gpio the GPIO port.
+ */
+void gpio_edge_remove(int gpio)
+{
+    struct gpio_edge *e;
+
+    if (gpio < 0 || gpio > 27 || !gpio_edges[gpio].cb) {
+        return;
+    }
+
+    e = &gpio_edges[gpio];
+    if (!e->polled) {
+        if (gpio_get_backend() == GPIO_BACKEND_CHARDEV) {
+            gpio_chardev_set_edge(gpio, false);
+        } else if (e->ufd.fd >= 0) {
+            uloop_fd_delete(&e->ufd);
+            close(e->ufd.fd);
+            _gpio_edge_sysfs_arm(gpio, "none");
+        }
+    }
+
+    memset(e, 0, sizeof(*e));
+}
@@ -37,8 +37,28 @@
 #include "../logger.h"
 #include "../helper.h"
 #include "../uhttpd.h"
+#include "../client.h"
 #include "gpio_json_api.h"
 #include "gpio.h"
+#include "gpio_snapshot.h"
+#include "gpio_pulse.h"
+#include "gpio_wave.h"
+#include "gpio_debounce.h"
+#include "../events/events.h"
+
+/**
+ * Publish a GPIO change made through the API.
+ * @param gpio_pin the pin that changed.
+ * @param key the property that changed, "state" or "direction".
+ * @param value the new value.
+ */
+void gpio_publish_change(int gpio_pin, const char* key, int value)
+{
+    json_object *jevent = json_object_new_object();
+    json_object_object_add(jevent, "pin", json_object_new_int(gpio_pin));
+    json_object_object_add(jevent, key, json_object_new_int(value));
+    events_publish(EVENT_TOPIC_GPIO, jevent);
+}
 
 /**
  * Route all get requests concerning the gpio module.
@@ -63,6 +83,14 @@ json_object* gpio_get_router(struct client *cl, char *request) {
     {
         return gpio_get_all_states(cl, request + 10);
     }
+    else if (helper_str_startswith(request, "pulses", 0))
+    {
+        return gpio_get_pulse_stats(cl, request + 7);
+    }
+    else if (helper_str_startswith(request, "buttons", 0))
+    {
+        return gpio_get_buttons(cl, request + 8);
+    }
     else
     {
         log_message(LOG_WARNING, "GPIO API got unknown GET request '%s'\r\n", request);
@@ -77,7 +105,15 @@ json_object* gpio_get_router(struct client *cl, char *request) {
  * @return the result of the called function.
  */
 json_object* gpio_post_router(struct client *cl, char *request) {
-    return NULL;
+    if (helper_str_startswith(request, "wave", 0))
+    {
+        return gpio_post_wave(cl, request + 5);
+    }
+    else
+    {
+        log_message(LOG_WARNING, "GPIO API got unknown POST request '%s'\r\n", request);
+        return NULL;
+    }
 }
 
 /**
@@ -95,6 +131,18 @@ json_object* gpio_put_router(struct client *cl, char *request) {
     {
         return gpio_put_direction(cl, request + 4);
     }
+    else if (helper_str_startswith(request, "debounce", 0))
+    {
+        return gpio_put_debounce(cl, request + 9);
+    }
+    else if (helper_str_startswith(request, "wave-stop", 0))
+    {
+        return gpio_put_wave_stop(cl, request + 10);
+    }
+    else if (helper_str_startswith(request, "pulse-cancel", 0))
+    {
+        return gpio_put_pulse_cancel(cl, request + 13);
+    }
     else if (helper_str_startswith(request, "pulse", 0))
     {
         return gpio_put_pulse_output(cl, request + 6);
@@ -135,6 +183,14 @@ json_object* gpio_get_layout(struct client *cl, char *request) {
     return jobj;
 }
 
+/**
+ * Get the version of the GPIO layout response.
+ * @return the version of the layout, it is compiled in and never changes.
+ */
+unsigned int gpio_layout_version(void) {
+    return 1;
+}
+
 /**
  * Get the layout of the GPIO ports and also the current GPIO port
  * state. 
@@ -142,12 +198,21 @@ json_object* gpio_get_layout(struct client *cl, char *request) {
  * @param request the request part of the url. 
  */
 json_object* gpio_get_overview(struct client *cl, char *request) {
-    int i;
+    struct gpio_port_snapshot ports[28];
+    const char *owners[GPIO_MAX_OWNERS];
+    bool snapshot = gpio_snapshot_enabled();
+    uint64_t now = 0;
+    int i, j, n;
 
     /* Create the json object */
     json_object *jobj = json_object_new_object();
     json_object *jarray = json_object_new_array();
 
+    /* Render from memory when the ports are sampled */
+    if(snapshot) {
+        now = gpio_snapshot_read(ports);
+    }
+
     /* Check the state for every IO port */
     for(i = 0; i < (sizeof(gpio_config) / sizeof(bool)); ++i) {
         if(gpio_config[i]){
@@ -155,15 +220,34 @@ json_object* gpio_get_overview(struct client *cl, char *request) {
             
             /* Add port number */
             json_object_object_add(j_gpio_port, "number", json_object_new_int(i));
+
+            /* Add the owners of the port */
+            json_object *j_owners = json_object_new_array();
+            n = gpio_get_owners(i, owners);
+            for(j = 0; j < n; ++j) {
+                json_object_array_add(j_owners, json_object_new_string(owners[j]));
+            }
+            json_object_object_add(j_gpio_port, "owners", j_owners);
             
             /* Add port direction and state */
             int state = 2;
             int dir = 2;
             
-            if(gpio_reserve(i)) {
+            if(snapshot) {
+                json_object_object_add(j_gpio_port, "reserved", json_object_new_boolean(ports[i].reserved));
+                json_object_object_add(j_gpio_port, "changed", ports[i].changed ? json_object_new_int64(now - ports[i].changed) : NULL);
+            }
+            
+            /* The sampler only follows owned ports, the others are read live and held from now on */
+            if(snapshot && n > 0 && ports[i].state != GPIO_ERR && ports[i].direction != GPIO_ERR) {
+                state = ports[i].state;
+                dir = ports[i].direction;
+            } else if(gpio_hold(i)) {
                 state = gpio_get_state(i);
                 dir = gpio_get_direction(i);
-                gpio_release(i);
+                if(snapshot) {
+                    gpio_snapshot_update(i, state == GPIO_ERR ? -1 : state, dir == GPIO_ERR ? -1 : dir);
+                }
             }
 
             json_object_object_add(j_gpio_port, "state", json_object_new_int(state));
@@ -188,24 +272,58 @@ json_object* gpio_get_overview(struct client *cl, char *request) {
  * @param request the request part of the url. 
  */
 json_object* gpio_get_all_states(struct client *cl, char *request){   
+    const char *owners[GPIO_MAX_OWNERS];
+    bool snapshot = gpio_snapshot_enabled();
+    uint32_t mask = 0, states = 0, live = 0, live_states = 0;
+    bool read = true;
     int i;
 
     /* Create the json object */
     json_object *jobj = json_object_new_object();
     json_object *jarray = json_object_new_array();
 
-    /* Check the state for every IO port */
+    if(snapshot) {
+        struct gpio_port_snapshot ports[28];
+
+        /* Render owned ports with a known state from memory */
+        gpio_snapshot_read(ports);
+        for(i = 0; i < (sizeof(gpio_config) / sizeof(bool)); ++i) {
+            if(gpio_config[i] && ports[i].state != GPIO_ERR && gpio_get_owners(i, owners) > 0) {
+                mask |= GPIO_MASK(i);
+                if(ports[i].state == GPIO_HIGH) {
+                    states |= GPIO_MASK(i);
+                }
+            }
+        }
+    }
+
+    /* Hold the other IO ports that are available and read them all at once */
+    for(i = 0; i < (sizeof(gpio_config) / sizeof(bool)); ++i) {
+        if(gpio_config[i] && !(mask & GPIO_MASK(i)) && gpio_hold(i)){
+            live |= GPIO_MASK(i);
+        }
+    }
+
+    if(live) {
+        read = gpio_get_states(live, &live_states);
+        mask |= live;
+        states |= live_states & live;
+    }
+
     for(i = 0; i < (sizeof(gpio_config) / sizeof(bool)); ++i) {
-        if(gpio_reserve(i)){
+        if(mask & GPIO_MASK(i)){
             json_object *j_gpio_port = json_object_new_object();
+            int state = !read && (live & GPIO_MASK(i)) ? GPIO_ERR : (states & GPIO_MASK(i)) ? GPIO_HIGH : GPIO_LOW;
+            
+            /* Debounced ports report the filtered state */
+            if(state != GPIO_ERR && gpio_debounce_get_state(i) != GPIO_ERR) {
+                state = gpio_debounce_get_state(i);
+            }
             
             /* Add data */
             json_object_object_add(j_gpio_port, "port-number", json_object_new_int(i));
-            json_object_object_add(j_gpio_port, "port-state", json_object_new_int(gpio_get_state(i)));
+            json_object_object_add(j_gpio_port, "port-state", json_object_new_int(state));
             json_object_array_add(jarray, j_gpio_port);
-            
-            /* Release the port */
-            gpio_release(i);
         }
     }
 
@@ -234,8 +352,11 @@ json_object* gpio_get_status(struct client *cl, char *request)
         return NULL;
     }
 
-    /* Read the GPIO pin state */
-    gpio_state = gpio_read_and_close(gpio_pin);
+    /* Read the GPIO pin state, debounced ports report the filtered state */
+    gpio_state = gpio_debounce_get_state(gpio_pin);
+    if(gpio_state == GPIO_ERR) {
+        gpio_state = gpio_read_and_close(gpio_pin);
+    }
 
     /* Check if there was no error reading the pin */
     if(gpio_state == -1){
@@ -277,6 +398,7 @@ json_object* gpio_put_status(struct client *cl, char *request)
         cl->http_status = r_error;
         return NULL;
     }
+    gpio_publish_change(gpio_pin, "state", gpio_state == 1 ? GPIO_HIGH : GPIO_LOW);
 
     /* Put data in JSON object */
     json_object *jobj = json_object_new_object();
@@ -301,6 +423,7 @@ json_object* gpio_put_direction(struct client *cl, char *request)
     /* This functions expects the following request /<gpiopin>/<direction> */
     int gpio_pin;
     int gpio_direction;
+    bool ok;
 
     /* If sscanf fails the request is malformed */
     if(sscanf(request, "%d/%d", &gpio_pin, &gpio_direction) != 2) {
@@ -308,10 +431,19 @@ json_object* gpio_put_direction(struct client *cl, char *request)
         return NULL;
     }
 
-    if(!gpio_set_direction(gpio_pin, gpio_direction)) {
+    /* Ports driven exclusively by an other owner are refused */
+    if(!gpio_hold(gpio_pin) || !gpio_claim(gpio_pin, "oneshot-write", GPIO_SHARED)) {
+        cl->http_status = r_error;
+        return NULL;
+    }
+
+    ok = gpio_set_direction(gpio_pin, gpio_direction);
+    gpio_unclaim(gpio_pin, "oneshot-write");
+    if(!ok) {
         cl->http_status = r_error;
         return NULL;
     }
+    gpio_publish_change(gpio_pin, "direction", gpio_direction);
 
     /* Put data in JSON object */
     json_object *jobj = json_object_new_object();
@@ -337,6 +469,7 @@ json_object* gpio_put_pulse_output(struct client *cl, char *request)
     int gpio_pin;
     int gpio_mode;
     int ms;
+    unsigned int id;
 
     /* If sscanf fails the request is malformed */
     if(sscanf(request, "%d/%d/%d", &gpio_pin, &gpio_mode, &ms) != 3) {
@@ -344,7 +477,13 @@ json_object* gpio_put_pulse_output(struct client *cl, char *request)
         return NULL;
     }
 
-    if(!gpio_pulse(gpio_pin, ms*1000, gpio_mode)) {
+    if(ms < 0) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    id = gpio_pulse_schedule(gpio_pin, 0, ms*1000, gpio_mode);
+    if(!id) {
         cl->http_status = r_error;
         return NULL;
     }
@@ -356,6 +495,281 @@ json_object* gpio_put_pulse_output(struct client *cl, char *request)
     
     json_object_object_add(jobj, "pin", j_pin);
     json_object_object_add(jobj, "pulse_time", j_ms);
+    json_object_object_add(jobj, "id", json_object_new_int64(id));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Cancel a pulse, a pulse that already started ends right away.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_pulse_cancel(struct client *cl, char *request)
+{
+    /* This functions expects the following request /<pulse id> */
+    unsigned int id;
+
+    /* If sscanf fails the request is malformed */
+    if(sscanf(request, "%u", &id) != 1) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    /* Pulses that already ended can not be cancelled */
+    if(!gpio_pulse_cancel(id)) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "id", json_object_new_int64(id));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Get the statistics of the pulse scheduler, the lateness of the pulse
+ * transitions is in microseconds.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_get_pulse_stats(struct client *cl, char *request)
+{
+    struct gpio_pulse_stats stats;
+
+    gpio_pulse_get_stats(&stats);
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "scheduled", json_object_new_int64(stats.scheduled));
+    json_object_object_add(jobj, "completed", json_object_new_int64(stats.completed));
+    json_object_object_add(jobj, "cancelled", json_object_new_int64(stats.cancelled));
+    json_object_object_add(jobj, "pending", json_object_new_int64(stats.pending));
+    json_object_object_add(jobj, "late-avg", json_object_new_int64(stats.late_avg));
+    json_object_object_add(jobj, "late-max", json_object_new_int64(stats.late_max));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Start a waveform. The body holds the steps and the number of passes,
+ * "loops" defaults to 1 and 0 repeats the waveform until it is stopped:
+ * {"steps": [{"mask": 128, "value": 128, "delay": 500}, ...], "loops": 1}
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_post_wave(struct client *cl, char *request)
+{
+    json_object *in_obj = client_get_json_body(cl);
+    json_object *j_steps = NULL;
+    json_object *j_loops = NULL;
+    json_object *j_step, *j_mask, *j_value, *j_delay;
+    struct gpio_wave_step *steps;
+    unsigned int loops = 1;
+    unsigned int id = 0;
+    int i, n = 0;
+
+    if(!json_object_object_get_ex(in_obj, "steps", &j_steps) ||
+       !json_object_is_type(j_steps, json_type_array) ||
+       (n = json_object_array_length(j_steps)) < 1 || n > GPIO_WAVE_MAX_STEPS)
+    {
+        json_object_put(in_obj);
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    if(json_object_object_get_ex(in_obj, "loops", &j_loops)) {
+        loops = json_object_get_int(j_loops);
+    }
+
+    steps = calloc(n, sizeof(*steps));
+    for(i = 0; steps && i < n; ++i) {
+        j_step = json_object_array_get_idx(j_steps, i);
+        if(!json_object_object_get_ex(j_step, "mask", &j_mask) ||
+           !json_object_object_get_ex(j_step, "value", &j_value) ||
+           !json_object_object_get_ex(j_step, "delay", &j_delay) ||
+           json_object_get_int(j_delay) < 0) {
+            break;
+        }
+
+        steps[i].mask = json_object_get_int(j_mask);
+        steps[i].value = json_object_get_int(j_value);
+        steps[i].delay = json_object_get_int(j_delay);
+    }
+
+    /* The waveform is validated when it is compiled */
+    if(steps && i == n) {
+        id = gpio_wave_start(steps, n, loops);
+    }
+
+    free(steps);
+    json_object_put(in_obj);
+
+    if(!id) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "id", json_object_new_int64(id));
+    json_object_object_add(jobj, "steps", json_object_new_int(n));
+    json_object_object_add(jobj, "loops", json_object_new_int64(loops));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Stop a running waveform, the ports keep their current states.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_wave_stop(struct client *cl, char *request)
+{
+    /* This functions expects the following request /<waveform id> */
+    unsigned int id;
+
+    /* If sscanf fails the request is malformed */
+    if(sscanf(request, "%u", &id) != 1) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    if(!gpio_wave_stop(id)) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "id", json_object_new_int64(id));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Check if a port is debounced through the API.
+ * @param gpio_pin the GPIO port.
+ * @return true when the API holds a debounce claim on the port.
+ */
+static bool _gpio_api_debounced(int gpio_pin)
+{
+    const char *owners[GPIO_MAX_OWNERS];
+    int i, n;
+
+    n = gpio_get_owners(gpio_pin, owners);
+    for(i = 0; i < n; ++i) {
+        if(!strcmp(owners[i], "debounce")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Debounce an input port and report its button events, a debounce time
+ * of 0 stops debouncing a port debounced through the API. The port is
+ * claimed exclusively since it is forced to input.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_debounce(struct client *cl, char *request)
+{
+    /* This functions expects the following request /<gpiopin>/<ms>[/<filter>[/<active low>]] */
+    int gpio_pin;
+    int ms;
+    int filter = GPIO_DEBOUNCE_WINDOW;
+    int active_low = 0;
+
+    /* If sscanf fails the request is malformed */
+    if(sscanf(request, "%d/%d/%d/%d", &gpio_pin, &ms, &filter, &active_low) < 2) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    if(ms == 0) {
+        /* Only ports debounced through the API can be released here */
+        if(!gpio_unclaim(gpio_pin, "debounce")) {
+            cl->http_status = r_bad_req;
+            return NULL;
+        }
+        gpio_debounce_remove(gpio_pin);
+    } else {
+        /* A port debounced through the API already holds its claim */
+        bool held = _gpio_api_debounced(gpio_pin);
+        
+        if(!held && !gpio_claim(gpio_pin, "debounce", GPIO_EXCLUSIVE)) {
+            cl->http_status = r_bad_req;
+            return NULL;
+        }
+        
+        if(!gpio_set_direction(gpio_pin, GPIO_IN) ||
+           !gpio_debounce(gpio_pin, ms, filter, active_low, NULL, NULL)) {
+            if(!held) {
+                gpio_unclaim(gpio_pin, "debounce");
+            }
+            cl->http_status = r_bad_req;
+            return NULL;
+        }
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "pin", json_object_new_int(gpio_pin));
+    json_object_object_add(jobj, "debounce", json_object_new_int(ms));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Get the settings and debounced states of all debounced ports.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_get_buttons(struct client *cl, char *request)
+{
+    struct gpio_button_info info;
+    int i;
+
+    /* Create the json object */
+    json_object *jobj = json_object_new_object();
+    json_object *jarray = json_object_new_array();
+
+    for(i = 0; i < (sizeof(gpio_config) / sizeof(bool)); ++i) {
+        if(gpio_debounce_get_info(i, &info)) {
+            json_object *j_button = json_object_new_object();
+            
+            /* Add data */
+            json_object_object_add(j_button, "port-number", json_object_new_int(i));
+            json_object_object_add(j_button, "debounce", json_object_new_int(info.ms));
+            json_object_object_add(j_button, "filter", json_object_new_string(
+                    info.filter == GPIO_DEBOUNCE_INTEGRATOR ? "integrator" : "window"));
+            json_object_object_add(j_button, "active-low", json_object_new_boolean(info.active_low));
+            json_object_object_add(j_button, "port-state", json_object_new_int(info.state));
+            json_object_object_add(j_button, "pressed", json_object_new_boolean(info.pressed));
+            json_object_object_add(j_button, "presses", json_object_new_int64(info.presses));
+            json_object_object_add(j_button, "glitches", json_object_new_int64(info.glitches));
+            json_object_array_add(jarray, j_button);
+        }
+    }
+
+    /* Add the array to the json object */
+    json_object_object_add(jobj, "buttons", jarray);
 
     /* Return status ok */
     cl->http_status = r_ok;
@@ -34,6 +34,14 @@
 #include <json-c/json.h>
 #include "../uhttpd.h"
 
+/**
+ * Publish a GPIO change made through the API.
+ * @param gpio_pin the pin that changed.
+ * @param key the property that changed, "state" or "direction".
+ * @param value the new value.
+ */
+void gpio_publish_change(int gpio_pin, const char* key, int value);
+
 /**
  * Route all get requests concerning the gpio module.
  * @param cl the client who made the request.
@@ -65,6 +73,12 @@ json_object* gpio_put_router(struct client *cl, char *request);
  */
 json_object* gpio_get_layout(struct client *cl, char *request);
 
+/**
+ * Get the version of the GPIO layout response.
+ * @return the version of the layout, it is compiled in and never changes.
+ */
+unsigned int gpio_layout_version(void);
+
 /**
  * Get the layout of the GPIO ports and also the current GPIO port
  * state. 
@@ -107,5 +121,52 @@ json_object* gpio_put_direction(struct client *cl, char *request);
  * @param request the request part of the url. 
  */
 json_object* gpio_put_pulse_output(struct client *cl, char *request);
+/**
+ * Cancel a pulse, a pulse that already started ends right away.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_pulse_cancel(struct client *cl, char *request);
+
+/**
+ * Get the statistics of the pulse scheduler, the lateness of the pulse
+ * transitions is in microseconds.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_get_pulse_stats(struct client *cl, char *request);
+
+/**
+ * Start a waveform. The body holds the steps and the number of passes,
+ * "loops" defaults to 1 and 0 repeats the waveform until it is stopped:
+ * {"steps": [{"mask": 128, "value": 128, "delay": 500}, ...], "loops": 1}
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_post_wave(struct client *cl, char *request);
+
+/**
+ * Stop a running waveform, the ports keep their current states.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_wave_stop(struct client *cl, char *request);
+
+/**
+ * Debounce an input port and report its button events, a debounce time
+ * of 0 stops debouncing a port debounced through the API. The port is
+ * claimed exclusively since it is forced to input.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_put_debounce(struct client *cl, char *request);
+
+/**
+ * Get the settings and debounced states of all debounced ports.
+ * @param cl the client who made the request.
+ * @param request the request part of the url. 
+ */
+json_object* gpio_get_buttons(struct client *cl, char *request);
+
 #endif
 
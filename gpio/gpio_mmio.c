@@ -0,0 +1,172 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_mmio.c
+ * Created on October 18, 2026, 9:50 AM
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "../logger.h"
+#include "../helper.h"
+#include "gpio.h"
+#include "gpio_mmio.h"
+
+/**
+ * The GPIO block of a SoC
+ */
+struct gpio_mmio_soc {
+    const char *name;           /* The SoC name used in the configuration */
+    off_t base;                 /* Physical address of the GPIO block */
+    bool oe_input;              /* True when a set output enable bit means input */
+};
+
+/* Supported SoCs, the AR934x and later invert the output enable register */
+static const struct gpio_mmio_soc gpio_mmio_socs[] = {
+    { "ar9331", GPIO_MMIO_BASE, false },
+    { "ar9341", GPIO_MMIO_BASE, true },
+    { "ar9344", GPIO_MMIO_BASE, true },
+    { "qca9531", GPIO_MMIO_BASE, true },
+    { "qca9533", GPIO_MMIO_BASE, true },
+};
+
+/* The mapped registers and the SoC they belong to */
+static volatile uint32_t *regs;
+static const struct gpio_mmio_soc *soc_info;
+
+/* Serialises the read-modify-write of the output enable register */
+static pthread_mutex_t oe_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Map the GPIO block of a SoC.
+ * @param soc the SoC name, for example "ar9331" or "qca9533".
+ * @return true on success.
+ */
+bool gpio_mmio_open(const char *soc)
+{
+    char path[PATH_MAX];
+    long page = sysconf(_SC_PAGESIZE);
+    void *map;
+    size_t i;
+    int fd;
+
+    for (i = 0; i < sizeof(gpio_mmio_socs) / sizeof(gpio_mmio_socs[0]); ++i) {
+        if (strcmp(gpio_mmio_socs[i].name, soc) == 0) {
+            soc_info = &gpio_mmio_socs[i];
+            break;
+        }
+    }
+
+    if (!soc_info) {
+        log_message(LOG_ERROR, "gpio_mmio: unknown SoC %s\r\n", soc);
+        return false;
+    }
+
+    /* The simulator provides a sparse file in place of /dev/mem */
+    if (!helper_hw_path(path, sizeof(path), "/dev/mem")) {
+        return false;
+    }
+
+    fd = open(path, O_RDWR | O_SYNC | O_CLOEXEC);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "gpio_mmio: could not open %s: %s\r\n", path, strerror(errno));
+        return false;
+    }
+
+    map = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, soc_info->base & ~(page - 1));
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_message(LOG_ERROR, "gpio_mmio: could not map the %s GPIO block: %s\r\n", soc, strerror(errno));
+        return false;
+    }
+
+    regs = (volatile uint32_t*) ((char*) map + (soc_info->base & (page - 1)));
+    log_message(LOG_INFO, "gpio_mmio: mapped the %s GPIO block\r\n", soc);
+    return true;
+}
+
+/**
+ * Set the direction of a port.
+ * @param gpio the GPIO port.
+ * @param direction GPIO_IN or GPIO_OUT.
+ */
+void gpio_mmio_set_direction(int gpio, int direction)
+{
+    bool set = (direction == GPIO_IN) == soc_info->oe_input;
+
+    pthread_mutex_lock(&oe_lock);
+    if (set) {
+        regs[GPIO_MMIO_OE] |= GPIO_MASK(gpio);
+    } else {
+        regs[GPIO_MMIO_OE] &= ~GPIO_MASK(gpio);
+    }
+    pthread_mutex_unlock(&oe_lock);
+}
+
+/**
+ * Get the direction of a port.
+ * @param gpio the GPIO port.
+ * @return GPIO_IN or GPIO_OUT.
+ */
+int gpio_mmio_get_direction(int gpio)
+{
+    bool set = (regs[GPIO_MMIO_OE] & GPIO_MASK(gpio)) != 0;
+
+    return set == soc_info->oe_input ? GPIO_IN : GPIO_OUT;
+}
+
+/**
+ * Set the states of a group of output ports with one write to the set
+ * register and one to the clear register.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ */
+void gpio_mmio_set_states(uint32_t mask, uint32_t states)
+{
+    if (mask & states) {
+        regs[GPIO_MMIO_SET] = mask & states;
+    }
+    if (mask & ~states) {
+        regs[GPIO_MMIO_CLEAR] = mask & ~states;
+    }
+}
+
+/**
+ * Get the states of a group of ports from the input register.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @return the states of the ports.
+ */
+uint32_t gpio_mmio_get_states(uint32_t mask)
+{
+    return regs[GPIO_MMIO_IN] & mask;
+}
@@ -0,0 +1,89 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_mmio.h
+ * Created on October 18, 2026, 9:50 AM
+ */
+
+#ifndef GPIO_MMIO_H_
+#define GPIO_MMIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Registers of the Atheros/Qualcomm GPIO block, as word offsets */
+#define GPIO_MMIO_BASE          0x18040000      /* Physical address of the GPIO block */
+#define GPIO_MMIO_OE            0               /* Output enable */
+#define GPIO_MMIO_IN            1               /* Input levels */
+#define GPIO_MMIO_OUT           2               /* Output levels */
+#define GPIO_MMIO_SET           3               /* Write ones to set outputs */
+#define GPIO_MMIO_CLEAR         4               /* Write ones to clear outputs */
+#define GPIO_MMIO_REGS          5               /* Number of registers used */
+
+/*
+ * GPIO backend writing the registers of the SoC GPIO block directly,
+ * mapped from /dev/mem. Outputs are set and cleared with single register
+ * writes so this is meant for bit-banging. The pins must be muxed as GPIO
+ * by the firmware, the kernel is not told about register accesses.
+ */
+
+/**
+ * Map the GPIO block of a SoC.
+ * @param soc the SoC name, for example "ar9331" or "qca9533".
+ * @return true on success.
+ */
+bool gpio_mmio_open(const char *soc);
+
+/**
+ * Set the direction of a port.
+ * @param gpio the GPIO port.
+ * @param direction GPIO_IN or GPIO_OUT.
+ */
+void gpio_mmio_set_direction(int gpio, int direction);
+
+/**
+ * Get the direction of a port.
+ * @param gpio the GPIO port.
+ * @return GPIO_IN or GPIO_OUT.
+ */
+int gpio_mmio_get_direction(int gpio);
+
+/**
+ * Set the states of a group of output ports with one write to the set
+ * register and one to the clear register.
+ * @param mask the ports to set, bit n is GPIO port n.
+ * @param states the new states of the ports.
+ */
+void gpio_mmio_set_states(uint32_t mask, uint32_t states);
+
+/**
+ * Get the states of a group of ports from the input register.
+ * @param mask the ports to read, bit n is GPIO port n.
+ * @return the states of the ports.
+ */
+uint32_t gpio_mmio_get_states(uint32_t mask);
+
+#endif
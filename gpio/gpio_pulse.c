@@ -0,0 +1,478 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_pulse.c
+ * Created on October 18, 2026, 3:15 PM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "../config.h"
+#include "../logger.h"
+#include "gpio.h"
+#include "gpio_pulse.h"
+
+#define NSEC_PER_SEC            1000000000ULL
+
+/**
+ * A pending transition of a pulse
+ */
+struct gpio_transition {
+    uint64_t when;              /* Monotonic time of the transition in nanoseconds */
+    unsigned int id;            /* The pulse id */
+    int8_t gpio;                /* The GPIO port */
+    int8_t mode;                /* GPIO_ACT_HIGH or GPIO_ACT_LOW */
+    bool start;                 /* True for the start of the pulse */
+};
+
+/* Min-heap of pending transitions, guarded by the lock */
+static struct gpio_transition *heap;
+static size_t heap_len = 0;
+static size_t heap_size = 0;
+static pthread_mutex_t pulse_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Per port the number of pulses not ended and the number of active pulses */
+static int port_pulses[28];
+static int port_active[28];
+
+static unsigned int next_id = 1;
+static struct gpio_pulse_stats stats;
+static uint64_t late_sum, late_count;
+
+/* The scheduler timer, the thread is started with the first pulse */
+static int timer_fd = -1;
+
+/**
+ * Get the monotonic time used for the schedule.
+ * @return the time in nanoseconds.
+ */
+static uint64_t _pulse_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Move a transition up the heap until its parent is earlier.
+ * @param i the index of the transition.
+ */
+static void _heap_up(size_t i)
+{
+    struct gpio_transition t = heap[i];
+
+    while (i > 0 && heap[(i - 1) / 2].when > t.when) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = t;
+}
+
+/**
+ * Move a transition down the heap until its children are later.
+ * @param i the index of the transition.
+ */
+static void _heap_down(size_t i)
+{
+    struct gpio_transition t = heap[i];
+    size_t child;
+
+    while ((child = 2 * i + 1) < heap_len) {
+        if (child + 1 < heap_len && heap[child + 1].when < heap[child].when) {
+            child++;
+        }
+        if (heap[child].when >= t.when) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = t;
+}
+
+/**
+ * Make room in the heap.
+ * @param n the number of transitions that will be added.
+ * @return false when out of memory.
+ */
+static bool _heap_grow(size_t n)
+{
+    struct gpio_transition *grown;
+    size_t size = heap_size ? heap_size : 64;
+
+    while (heap_len + n > size) {
+        size *= 2;
+    }
+
+    if (size != heap_size) {
+        grown = realloc(heap, size * sizeof(*heap));
+        if (!grown) {
+            return false;
+        }
+        heap = grown;
+        heap_size = size;
+    }
+
+    return true;
+}
+
+/**
+ * Add a transition to the heap, there must be room for it.
+ * @param t the transition.
+ */
+static void _heap_push(const struct gpio_transition *t)
+{
+    heap[heap_len] = *t;
+    _heap_up(heap_len++);
+}
+
+/**
+ * Remove a transition from the heap.
+ * @param i the index of the transition.
+ */
+static void _heap_remove(size_t i)
+{
+    heap[i] = heap[--heap_len];
+    if (i < heap_len) {
+        _heap_up(i);
+        _heap_down(i);
+    }
+}
+
+/**
+ * Arm the timer for the earliest transition, or disarm it when there is
+ * none. Must be called with the lock held.
+ */
+static void _pulse_arm(void)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    if (heap_len) {
+        its.it_value.tv_sec = heap[0].when / NSEC_PER_SEC;
+        its.it_value.tv_nsec = heap[0].when % NSEC_PER_SEC;
+    }
+
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * Apply a transition. Must be called with the lock held.
+ * @param t the transition.
+ * @param mask receives the port when its level changes.
+ * @param states receives the new level of the port.
+ * @param release receives the port when its last pulse ended.
+ */
+static void _pulse_apply(const struct gpio_transition *t, uint32_t *mask, uint32_t *states, uint32_t *release)
+{
+    int active = t->mode == GPIO_ACT_HIGH ? GPIO_HIGH : GPIO_LOW;
+    int level;
+
+    if (t->start) {
+        if (port_active[t->gpio]++ > 0) {
+            return;
+        }
+        level = active;
+    } else {
+        stats.completed++;
+        stats.pending--;
+        if (--port_pulses[t->gpio] == 0) {
+            *release |= GPIO_MASK(t->gpio);
+        }
+        if (--port_active[t->gpio] > 0) {
+            return;
+        }
+        level = !active;
+    }
+
+    *mask |= GPIO_MASK(t->gpio);
+    if (level == GPIO_HIGH) {
+        *states |= GPIO_MASK(t->gpio);
+    } else {
+        *states &= ~GPIO_MASK(t->gpio);
+    }
+}
+
+/**
+ * Write the transitions applied together and release the ports whose
+ * last pulse ended. Must be called with the lock held.
+ * @param mask the ports whose level changes.
+ * @param states the new levels.
+ * @param release the ports to release.
+ */
+static void _pulse_write(uint32_t mask, uint32_t states, uint32_t release)
+{
+    int gpio;
+
+    if (mask) {
+        gpio_set_states(mask, states);
+    }
+
+    for (gpio = 0; release; ++gpio) {
+        if (release & GPIO_MASK(gpio)) {
+            gpio_unclaim(gpio, "pulse");
+            release &= ~GPIO_MASK(gpio);
+        }
+    }
+}
+
+/**
+ * The scheduler thread, it applies all transitions that are due whenever
+ * the timer expires.
+ * @param arg unused.
+ * @return never returns.
+ */
+static void* _pulse_thread(void *arg)
+{
+    struct sched_param param = { .sched_priority = GPIO_PULSE_PRIORITY };
+    struct gpio_transition t;
+    uint32_t mask, states, release;
+    uint64_t expirations, now, late;
+    int err;
+
+    /* Real-time priority keeps the pulses accurate, run anyway without it */
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) {
+        log_message(LOG_WARNING, "gpio_pulse: no real-time priority, pulses will be less accurate: %s\r\n", strerror(err));
+    }
+
+    while (true) {
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN && errno != EINTR) {
+            log_message(LOG_ERROR, "gpio_pulse: could not read the timer: %s\r\n", strerror(errno));
+            return NULL;
+        }
+
+        pthread_mutex_lock(&pulse_lock);
+
+        now = _pulse_now();
+        mask = states = release = 0;
+        while (heap_len && heap[0].when <= now) {
+            t = heap[0];
+            _heap_remove(0);
+
+            late = (now - t.when) / 1000;
+            late_sum += late;
+            late_count++;
+            if (late > stats.late_max) {
+                stats.late_max = late;
+            }
+
+            _pulse_apply(&t, &mask, &states, &release);
+        }
+
+        _pulse_write(mask, states, release);
+        _pulse_arm();
+
+        pthread_mutex_unlock(&pulse_lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Create the timer and start the scheduler thread. Must be called with
+ * the lock held.
+ * @return true when the scheduler is running.
+ */
+static bool _pulse_start(void)
+{
+    pthread_t thread;
+
+    if (timer_fd >= 0) {
+        return true;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        log_message(LOG_ERROR, "gpio_pulse: could not create the timer: %s\r\n", strerror(errno));
+        return false;
+    }
+
+    if (pthread_create(&thread, NULL, _pulse_thread, NULL) != 0) {
+        log_message(LOG_ERROR, "gpio_pulse: could not start the scheduler thread\r\n");
+        close(timer_fd);
+        timer_fd = -1;
+        return false;
+    }
+
+    pthread_detach(thread);
+    return true;
+}
+
+/**
+ * Schedule a pulse on a GPIO port.
+ * @param gpio the GPIO port.
+ * @param delay microseconds until the pulse starts, 0 starts it right away.
+ * @param useconds the width of the pulse in microseconds.
+ * @param mode GPIO_ACT_HIGH or GPIO_ACT_LOW.
+ * @return the pulse id, 0 when the pulse could not be scheduled.
+ */
+unsigned int gpio_pulse_schedule(int gpio, uint32_t delay, uint32_t useconds, int mode)
+{
+    struct gpio_transition start, end;
+    uint32_t mask = 0, states = 0, release = 0;
+    uint64_t now;
+
+    if (gpio < 0 || gpio > 27 || !gpio_config[gpio]) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pulse_lock);
+
+    if (stats.pending >= GPIO_PULSE_MAX || !_pulse_start() || !_heap_grow(2)) {
+        pthread_mutex_unlock(&pulse_lock);
+        return 0;
+    }
+
+    /* The first pulse of a port takes it over */
+    if (port_pulses[gpio] == 0) {
+        if (!gpio_claim(gpio, "pulse", GPIO_SHARED)) {
+            pthread_mutex_unlock(&pulse_lock);
+            return 0;
+        }
+
+        if (!gpio_set_direction(gpio, GPIO_OUT)) {
+            gpio_unclaim(gpio, "pulse");
+            pthread_mutex_unlock(&pulse_lock);
+            return 0;
+        }
+    }
+
+    now = _pulse_now();
+    start.when = now + (uint64_t) delay * 1000;
+    start.id = next_id++;
+    start.gpio = gpio;
+    start.mode = mode == GPIO_ACT_LOW ? GPIO_ACT_LOW : GPIO_ACT_HIGH;
+    start.start = true;
+
+    end = start;
+    end.when = start.when + (uint64_t) useconds * 1000;
+    end.start = false;
+
+    /* Ids wrap around, 0 is reserved for errors */
+    if (next_id == 0) {
+        next_id = 1;
+    }
+
+    _heap_push(&end);
+    if (delay > 0) {
+        _heap_push(&start);
+    }
+
+    port_pulses[gpio]++;
+    stats.scheduled++;
+    stats.pending++;
+
+    /* Start right away without waiting for the thread */
+    if (delay == 0) {
+        _pulse_apply(&start, &mask, &states, &release);
+        _pulse_write(mask, states, release);
+    }
+
+    if (heap[0].id == start.id) {
+        _pulse_arm();
+    }
+
+    pthread_mutex_unlock(&pulse_lock);
+    return start.id;
+}
+
+/**
+ * Cancel a pulse. A pulse that already started ends right away.
+ * @param id the pulse id.
+ * @return true when the pulse was still pending.
+ */
+bool gpio_pulse_cancel(unsigned int id)
+{
+    uint32_t mask = 0, states = 0, release = 0;
+    bool started = true;
+    bool found = false;
+    int gpio = 0;
+    int mode = GPIO_ACT_HIGH;
+    size_t i;
+
+    pthread_mutex_lock(&pulse_lock);
+
+    for (i = 0; i < heap_len; ) {
+        if (heap[i].id != id) {
+            ++i;
+            continue;
+        }
+
+        if (heap[i].start) {
+            started = false;
+        }
+        gpio = heap[i].gpio;
+        mode = heap[i].mode;
+        found = true;
+
+        /* Removing can lift a later entry above i, scan again from the top */
+        _heap_remove(i);
+        i = 0;
+    }
+
+    if (found) {
+        stats.pending--;
+        stats.cancelled++;
+
+        if (--port_pulses[gpio] == 0) {
+            release = GPIO_MASK(gpio);
+        }
+
+        /* Only a started pulse that was the last active one changes the port */
+        if (started && --port_active[gpio] == 0) {
+            mask = GPIO_MASK(gpio);
+            states = mode == GPIO_ACT_HIGH ? 0 : mask;
+        }
+
+        _pulse_write(mask, states, release);
+        _pulse_arm();
+    }
+
+    pthread_mutex_unlock(&pulse_lock);
+    return found;
+}
+
+/**
+ * Get the pulse scheduler statistics.
+ * @param out receives the statistics.
+ */
+void gpio_pulse_get_stats(struct gpio_pulse_stats *out)
+{
+    pthread_mutex_lock(&pulse_lock);
+    *out = stats;
+    out->late_avg = late_count ? late_sum / late_count : 0;
+    pthread_mutex_unlock(&pulse_lock);
+}
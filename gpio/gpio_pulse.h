@@ -0,0 +1,82 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_pulse.h
+ * Created on October 18, 2026, 3:15 PM
+ */
+
+#ifndef GPIO_PULSE_H_
+#define GPIO_PULSE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Pulse scheduler. All pulses are driven by one thread sleeping on a
+ * timerfd armed for the earliest pending transition, the transitions are
+ * kept in a min-heap ordered by time. Transitions due at the same time are
+ * written with one bulk GPIO write. A port is claimed and made output
+ * when its first pulse is scheduled and given back after its last one.
+ * Overlapping pulses on a port are merged, the port stays active until
+ * the last of them ends.
+ */
+
+/**
+ * Pulse scheduler statistics
+ */
+struct gpio_pulse_stats {
+    unsigned long scheduled;    /* Number of pulses scheduled */
+    unsigned long completed;    /* Number of pulses that ended */
+    unsigned long cancelled;    /* Number of pulses cancelled */
+    unsigned long pending;      /* Number of pulses not ended yet */
+    uint32_t late_avg;          /* Average lateness of the transitions in microseconds */
+    uint32_t late_max;          /* Maximum lateness of the transitions in microseconds */
+};
+
+/**
+ * Schedule a pulse on a GPIO port.
+ * @param gpio the GPIO port.
+ * @param delay microseconds until the pulse starts, 0 starts it right away.
+ * @param useconds the width of the pulse in microseconds.
+ * @param mode GPIO_ACT_HIGH or GPIO_ACT_LOW.
+ * @return the pulse id, 0 when the pulse could not be scheduled.
+ */
+unsigned int gpio_pulse_schedule(int gpio, uint32_t delay, uint32_t useconds, int mode);
+
+/**
+ * Cancel a pulse. A pulse that already started ends right away.
+ * @param id the pulse id.
+ * @return true when the pulse was still pending.
+ */
+bool gpio_pulse_cancel(unsigned int id);
+
+/**
+ * Get the pulse scheduler statistics.
+ * @param stats receives the statistics.
+ */
+void gpio_pulse_get_stats(struct gpio_pulse_stats *stats);
+
+#endif
@@ -0,0 +1,216 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_snapshot.c
+ * Created on October 18, 2026, 11:20 AM
+ */
+
+/*
+ * In-memory snapshot of the GPIO ports. Writes through the GPIO functions
+ * and edge events update it directly, a sampler on the event loop catches
+ * changes made by the outside world on the ports that have an owner; the
+ * API reads the other ports live. Readers copy it under a seqlock so they
+ * never block a writer and never make a system call.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <libubox/uloop.h>
+
+#include "../config.h"
+#include "gpio.h"
+#include "gpio_snapshot.h"
+
+/* The snapshot, written under the writer lock and read under the sequence */
+static struct gpio_port_snapshot snapshot[28];
+static unsigned int snapshot_seq;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The sampler */
+static struct uloop_timeout sampler;
+static bool enabled = false;
+
+/**
+ * Get the monotonic time.
+ * @return the time in milliseconds.
+ */
+static uint64_t _snapshot_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Start a write, readers retry until it is done. Called with the writer
+ * lock held.
+ */
+static void _snapshot_write_begin(void)
+{
+    __atomic_store_n(&snapshot_seq, snapshot_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * Finish a write.
+ */
+static void _snapshot_write_end(void)
+{
+    __atomic_store_n(&snapshot_seq, snapshot_seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Record the state or direction of a port. Can be called from any thread.
+ * @param gpio the GPIO port.
+ * @param state the new state or -1 to keep it.
+ * @param direction the new direction or -1 to keep it.
+ */
+void gpio_snapshot_update(int gpio, int state, int direction)
+{
+    struct gpio_port_snapshot *port;
+
+    if (gpio < 0 || gpio > 27) {
+        return;
+    }
+
+    port = &snapshot[gpio];
+    pthread_mutex_lock(&writer_lock);
+    if ((state >= 0 && state != port->state) || (direction >= 0 && direction != port->direction)) {
+        _snapshot_write_begin();
+        /* Learning an unknown state or direction is not a change */
+        if ((state >= 0 && port->state != GPIO_ERR && state != port->state) ||
+                (direction >= 0 && port->direction != GPIO_ERR && direction != port->direction)) {
+            port->changed = _snapshot_now();
+        }
+        if (state >= 0) {
+            port->state = state;
+        }
+        if (direction >= 0) {
+            port->direction = direction;
+        }
+        _snapshot_write_end();
+    }
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/**
+ * Record that a port got or lost its last owner driving it.
+ * @param gpio the GPIO port.
+ * @param reserved true when reserved.
+ */
+void gpio_snapshot_reserved(int gpio, bool reserved)
+{
+    if (gpio < 0 || gpio > 27) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    if (snapshot[gpio].reserved != reserved) {
+        _snapshot_write_begin();
+        snapshot[gpio].reserved = reserved;
+        _snapshot_write_end();
+    }
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/**
+ * Copy a consistent snapshot of all ports, without system calls.
+ * @param ports the 28 port snapshots to fill in.
+ * @return the current monotonic time in milliseconds.
+ */
+uint64_t gpio_snapshot_read(struct gpio_port_snapshot ports[28])
+{
+    unsigned int seq;
+
+    do {
+        while ((seq = __atomic_load_n(&snapshot_seq, __ATOMIC_ACQUIRE)) & 1);
+        memcpy(ports, snapshot, sizeof(snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&snapshot_seq, __ATOMIC_RELAXED) != seq);
+
+    return _snapshot_now();
+}
+
+/**
+ * Sample the exposed ports that have an owner. The sampler never claims a
+ * port itself, ports nobody uses are not exported for it.
+ * @param t the sampler timer.
+ */
+static void _snapshot_sample(struct uloop_timeout *t)
+{
+    const char *owners[GPIO_MAX_OWNERS];
+    int gpio, state, direction;
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (!gpio_config[gpio] || gpio_get_owners(gpio, owners) == 0) {
+            continue;
+        }
+
+        /* The owner may let go meanwhile, a failed read keeps the old value */
+        state = gpio_get_state(gpio);
+        direction = gpio_get_direction(gpio);
+
+        gpio_snapshot_update(gpio, state == GPIO_ERR ? -1 : state, direction == GPIO_ERR ? -1 : direction);
+    }
+
+    uloop_timeout_set(t, conf->gpio_sample_interval);
+}
+
+/**
+ * Start sampling the GPIO ports every "gpio_sample_interval" milliseconds.
+ * This must be called after the uloop event loop and the GPIO backend
+ * are initialized.
+ */
+void gpio_snapshot_init(void)
+{
+    int gpio;
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        snapshot[gpio].state = GPIO_ERR;
+        snapshot[gpio].direction = GPIO_ERR;
+    }
+
+    if (conf->gpio_sample_interval <= 0) {
+        return;
+    }
+
+    sampler.cb = _snapshot_sample;
+    _snapshot_sample(&sampler);
+    enabled = true;
+}
+
+/**
+ * Check if the snapshot is maintained.
+ * @return true when the snapshot can be used instead of the ports.
+ */
+bool gpio_snapshot_enabled(void)
+{
+    return enabled;
+}
@@ -0,0 +1,82 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_snapshot.h
+ * Created on October 18, 2026, 11:20 AM
+ */
+
+#ifndef GPIO_SNAPSHOT_H_
+#define GPIO_SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The sampled state of a GPIO port
+ */
+struct gpio_port_snapshot {
+    int8_t state;               /* GPIO_HIGH, GPIO_LOW or GPIO_ERR when unknown */
+    int8_t direction;           /* GPIO_IN, GPIO_OUT or GPIO_ERR when unknown */
+    bool reserved;              /* True when claimed by a shared or exclusive owner */
+    uint64_t changed;           /* Monotonic time of the last change in milliseconds, 0 if never */
+};
+
+/**
+ * Start sampling the GPIO ports every "gpio_sample_interval" milliseconds.
+ * This must be called after the uloop event loop and the GPIO backend
+ * are initialized.
+ */
+void gpio_snapshot_init(void);
+
+/**
+ * Check if the snapshot is maintained.
+ * @return true when the snapshot can be used instead of the ports.
+ */
+bool gpio_snapshot_enabled(void);
+
+/**
+ * Copy a consistent snapshot of all ports, without system calls.
+ * @param ports the 28 port snapshots to fill in.
+ * @return the current monotonic time in milliseconds.
+ */
+uint64_t gpio_snapshot_read(struct gpio_port_snapshot ports[28]);
+
+/**
+ * Record the state or direction of a port. Can be called from any thread.
+ * @param gpio the GPIO port.
+ * @param state the new state or -1 to keep it.
+ * @param direction the new direction or -1 to keep it.
+ */
+void gpio_snapshot_update(int gpio, int state, int direction);
+
+/**
+ * Record that a port got or lost its last owner driving it.
+ * @param gpio the GPIO port.
+ * @param reserved true when reserved.
+ */
+void gpio_snapshot_reserved(int gpio, bool reserved);
+
+#endif
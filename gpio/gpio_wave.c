@@ -0,0 +1,403 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_wave.c
+ * Created on October 18, 2026, 9:30 AM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <json-c/json.h>
+
+#include "../config.h"
+#include "../logger.h"
+#include "../events/events.h"
+#include "gpio.h"
+#include "gpio_wave.h"
+
+#define NSEC_PER_SEC            1000000000ULL
+
+/**
+ * A compiled waveform. Consecutive steps without delay are merged so
+ * every step of the program is one bulk write followed by a wait.
+ */
+struct gpio_wave {
+    unsigned int id;            /* The waveform id */
+    uint32_t pins;              /* All ports written by the waveform */
+    unsigned int loops;         /* Number of passes to run, 0 for no limit */
+    unsigned int passes;        /* Number of completed passes */
+    uint64_t next;              /* Monotonic time of the next step in nanoseconds */
+    int step;                   /* The next step */
+    int len;                    /* The number of steps */
+    struct gpio_wave_step steps[];
+};
+
+/* The running waveforms, guarded by the lock */
+static struct gpio_wave *waves[GPIO_WAVE_MAX];
+static uint32_t wave_pins = 0;
+static unsigned int next_id = 1;
+static pthread_mutex_t wave_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The executor timer, the thread is started with the first waveform */
+static int timer_fd = -1;
+
+/**
+ * Get the monotonic time used for the schedule.
+ * @return the time in nanoseconds.
+ */
+static uint64_t _wave_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Arm the timer for the earliest step, or disarm it when nothing runs.
+ * Must be called with the lock held.
+ */
+static void _wave_arm(void)
+{
+    struct itimerspec its;
+    uint64_t next = 0;
+    int i;
+
+    for (i = 0; i < GPIO_WAVE_MAX; ++i) {
+        if (waves[i] && (!next || waves[i]->next < next)) {
+            next = waves[i]->next;
+        }
+    }
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = next / NSEC_PER_SEC;
+    its.it_value.tv_nsec = next % NSEC_PER_SEC;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * Remove a waveform, release its ports and publish how it ended. Must be
+ * called with the lock held.
+ * @param i the index of the waveform.
+ * @param result "done" or "stopped".
+ */
+static void _wave_end(int i, const char *result)
+{
+    struct gpio_wave *w = waves[i];
+    json_object *jevent;
+    int gpio;
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (w->pins & GPIO_MASK(gpio)) {
+            gpio_unclaim(gpio, "wave");
+        }
+    }
+    wave_pins &= ~w->pins;
+    waves[i] = NULL;
+
+    jevent = json_object_new_object();
+    json_object_object_add(jevent, "wave", json_object_new_int64(w->id));
+    json_object_object_add(jevent, "result", json_object_new_string(result));
+    json_object_object_add(jevent, "passes", json_object_new_int64(w->passes));
+    events_publish(EVENT_TOPIC_GPIO, jevent);
+
+    free(w);
+}
+
+/**
+ * The executor thread, it writes all steps that are due whenever the
+ * timer expires.
+ * @param arg unused.
+ * @return never returns.
+ */
+static void* _wave_thread(void *arg)
+{
+    struct sched_param param = { .sched_priority = GPIO_WAVE_PRIORITY };
+    const struct gpio_wave_step *s;
+    struct gpio_wave *w;
+    uint32_t mask, states, done;
+    uint64_t expirations, now;
+    bool due;
+    int i, err;
+
+    /* Real-time priority keeps the edges accurate, run anyway without it */
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) {
+        log_message(LOG_WARNING, "gpio_wave: no real-time priority, edges will be less accurate: %s\r\n", strerror(err));
+    }
+
+    while (true) {
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN && errno != EINTR) {
+            log_message(LOG_ERROR, "gpio_wave: could not read the timer: %s\r\n", strerror(errno));
+            return NULL;
+        }
+
+        pthread_mutex_lock(&wave_lock);
+
+        now = _wave_now();
+        done = 0;
+
+        /* Every write holds one step of each due waveform, steps missed while running late follow in order */
+        do {
+            mask = states = 0;
+            due = false;
+            for (i = 0; i < GPIO_WAVE_MAX; ++i) {
+                w = waves[i];
+                if (!w || (done & (1u << i)) || w->next > now) {
+                    continue;
+                }
+
+                if (w->step == w->len) {
+                    w->passes++;
+                    if (w->loops && w->passes >= w->loops) {
+                        done |= 1u << i;
+                        continue;
+                    }
+                    w->step = 0;
+                }
+
+                s = &w->steps[w->step++];
+                mask |= s->mask;
+                states = (states & ~s->mask) | s->value;
+                w->next += (uint64_t) s->delay * 1000;
+                due = true;
+            }
+
+            if (mask) {
+                gpio_set_states(mask, states);
+            }
+        } while (due);
+
+        for (i = 0; i < GPIO_WAVE_MAX; ++i) {
+            if (done & (1u << i)) {
+                _wave_end(i, "done");
+            }
+        }
+
+        _wave_arm();
+        pthread_mutex_unlock(&wave_lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Create the timer and start the executor thread. Must be called with
+ * the lock held.
+ * @return true when the executor is running.
+ */
+static bool _wave_start_thread(void)
+{
+    pthread_t thread;
+
+    if (timer_fd >= 0) {
+        return true;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        log_message(LOG_ERROR, "gpio_wave: could not create the timer: %s\r\n", strerror(errno));
+        return false;
+    }
+
+    if (pthread_create(&thread, NULL, _wave_thread, NULL) != 0) {
+        log_message(LOG_ERROR, "gpio_wave: could not start the executor thread\r\n");
+        close(timer_fd);
+        timer_fd = -1;
+        return false;
+    }
+
+    pthread_detach(thread);
+    return true;
+}
+
+/**
+ * Validate a waveform and compile it into a program.
+ * @param steps the steps of the waveform.
+ * @param n the number of steps.
+ * @param loops the number of passes, 0 for no limit.
+ * @return the program or NULL when the waveform is invalid.
+ */
+static struct gpio_wave* _wave_compile(const struct gpio_wave_step *steps, int n, unsigned int loops)
+{
+    struct gpio_wave_step *prev;
+    struct gpio_wave *w;
+    uint32_t valid = 0;
+    uint32_t min_delay = GPIO_WAVE_MIN_DELAY_MMIO;
+    int gpio, i;
+
+    if (n < 1 || n > GPIO_WAVE_MAX_STEPS) {
+        return NULL;
+    }
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if (gpio_config[gpio]) {
+            valid |= GPIO_MASK(gpio);
+        }
+    }
+
+    w = calloc(1, sizeof(*w) + n * sizeof(w->steps[0]));
+    if (!w) {
+        return NULL;
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (steps[i].mask & ~valid) {
+            log_message(LOG_DEBUG, "gpio_wave: step %d writes unavailable ports\r\n", i);
+            free(w);
+            return NULL;
+        }
+
+        if (steps[i].value & ~steps[i].mask) {
+            log_message(LOG_DEBUG, "gpio_wave: step %d has a value outside its mask\r\n", i);
+            free(w);
+            return NULL;
+        }
+
+        w->pins |= steps[i].mask;
+
+        /* A step without delay is written together with the next one */
+        prev = w->len ? &w->steps[w->len - 1] : NULL;
+        if (prev && prev->delay == 0) {
+            prev->mask |= steps[i].mask;
+            prev->value = (prev->value & ~steps[i].mask) | steps[i].value;
+            prev->delay = steps[i].delay;
+        } else {
+            w->steps[w->len++] = steps[i];
+        }
+    }
+
+    /* Every write on a sysfs or chardev port is a system call, give them more time */
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if ((w->pins & GPIO_MASK(gpio)) && !gpio_is_mmio(gpio)) {
+            min_delay = GPIO_WAVE_MIN_DELAY;
+        }
+    }
+
+    /* Short steps keep the executor from sleeping, only a single pass may end without delay */
+    for (i = 0; i < w->len; ++i) {
+        if (w->steps[i].delay < min_delay && !(loops == 1 && i == w->len - 1)) {
+            log_message(LOG_DEBUG, "gpio_wave: steps must take at least %u us\r\n", min_delay);
+            free(w);
+            return NULL;
+        }
+    }
+
+    w->loops = loops;
+    return w;
+}
+
+/**
+ * Validate and compile a waveform and start running it. The ports in
+ * the masks are claimed exclusively and made output until the waveform
+ * ends. Steps take at least GPIO_WAVE_MIN_DELAY, or GPIO_WAVE_MIN_DELAY_MMIO
+ * when all ports are bit-banged; steps without delay count together with
+ * the next one.
+ * @param steps the steps of the waveform.
+ * @param n the number of steps, 1 to GPIO_WAVE_MAX_STEPS.
+ * @param loops the number of times the waveform runs, 0 repeats it until
+ * it is stopped.
+ * @return the waveform id, 0 when the waveform is invalid or can not run.
+ */
+unsigned int gpio_wave_start(const struct gpio_wave_step *steps, int n, unsigned int loops)
+{
+    struct gpio_wave *w;
+    unsigned int id;
+    int gpio, slot;
+
+    w = _wave_compile(steps, n, loops);
+    if (!w) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&wave_lock);
+
+    for (slot = 0; slot < GPIO_WAVE_MAX && waves[slot]; ++slot);
+    if (slot == GPIO_WAVE_MAX || (w->pins & wave_pins) || !_wave_start_thread()) {
+        pthread_mutex_unlock(&wave_lock);
+        free(w);
+        return 0;
+    }
+
+    for (gpio = 0; gpio < 28; ++gpio) {
+        if ((w->pins & GPIO_MASK(gpio)) && (!gpio_claim(gpio, "wave", GPIO_EXCLUSIVE) || !gpio_set_direction(gpio, GPIO_OUT))) {
+            /* Give back the ports taken so far */
+            while (gpio-- > 0) {
+                if (w->pins & GPIO_MASK(gpio)) {
+                    gpio_unclaim(gpio, "wave");
+                }
+            }
+            pthread_mutex_unlock(&wave_lock);
+            free(w);
+            return 0;
+        }
+    }
+
+    /* The waveform may have ended once the lock is released */
+    id = w->id = next_id++;
+    if (next_id == 0) {
+        next_id = 1;
+    }
+    w->next = _wave_now();
+    waves[slot] = w;
+    wave_pins |= w->pins;
+    _wave_arm();
+
+    pthread_mutex_unlock(&wave_lock);
+    return id;
+}
+
+/**
+ * Stop a running waveform. The ports keep their current states.
+ * @param id the waveform id.
+ * @return true when the waveform was running.
+ */
+bool gpio_wave_stop(unsigned int id)
+{
+    bool found = false;
+    int i;
+
+    pthread_mutex_lock(&wave_lock);
+
+    for (i = 0; i < GPIO_WAVE_MAX; ++i) {
+        if (waves[i] && waves[i]->id == id) {
+            _wave_end(i, "stopped");
+            _wave_arm();
+            found = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&wave_lock);
+    return found;
+}
@@ -0,0 +1,75 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   gpio_wave.h
+ * Created on October 18, 2026, 9:30 AM
+ */
+
+#ifndef GPIO_WAVE_H_
+#define GPIO_WAVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Waveform executor. A waveform is a list of steps, every step writes a
+ * group of ports and waits before the next step. Waveforms are compiled
+ * into a compact program when they are started and run by one real-time
+ * thread sleeping on a timerfd, so the edges are timed on the board.
+ * Completion is published on the GPIO event topic.
+ */
+
+/**
+ * A waveform step
+ */
+struct gpio_wave_step {
+    uint32_t mask;              /* The ports written by the step, bit n is GPIO port n */
+    uint32_t value;             /* The new states of the ports in the mask */
+    uint32_t delay;             /* Microseconds until the next step */
+};
+
+/**
+ * Validate and compile a waveform and start running it. The ports in
+ * the masks are claimed exclusively and made output until the waveform
+ * ends. Steps take at least GPIO_WAVE_MIN_DELAY, or GPIO_WAVE_MIN_DELAY_MMIO
+ * when all ports are bit-banged; steps without delay count together with
+ * the next one.
+ * @param steps the steps of the waveform.
+ * @param n the number of steps, 1 to GPIO_WAVE_MAX_STEPS.
+ * @param loops the number of times the waveform runs, 0 repeats it until
+ * it is stopped.
+ * @return the waveform id, 0 when the waveform is invalid or can not run.
+ */
+unsigned int gpio_wave_start(const struct gpio_wave_step *steps, int n, unsigned int loops);
+
+/**
+ * Stop a running waveform. The ports keep their current states.
+ * @param id the waveform id.
+ * @return true when the waveform was running.
+ */
+bool gpio_wave_stop(unsigned int id);
+
+#endif
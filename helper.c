@@ -28,10 +28,13 @@
  * Created on February 1, 2015, 4:08 PM
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #include "helper.h"
+#include "config.h"
 #include "logger.h"
 
 /* Use unit separator (31) as delimiter*/
@@ -146,3 +149,38 @@ bool helper_str_startswith(const char* haystack, const char* needle, size_t offs
     
     return true;
 }
+
+/**
+ * Build the path of a sysfs file or device node. When a hardware root is
+ * configured the path is placed below it so the server can run against
+ * the hardware simulator.
+ * @param buf the buffer to place the path in. 
+ * @param len the size of the buffer. 
+ * @param fmt printf style format of the absolute path on real hardware. 
+ * @return false when the path did not fit in the buffer. 
+ */
+bool helper_hw_path(char* buf, size_t len, const char* fmt, ...)
+{
+    va_list args;
+    int root_len = snprintf(buf, len, "%s", helper_hw_simulated() ? conf->hardware_root : "");
+    int path_len;
+    
+    if(root_len < 0 || (size_t) root_len >= len) {
+        return false;
+    }
+    
+    va_start(args, fmt);
+    path_len = vsnprintf(buf + root_len, len - root_len, fmt, args);
+    va_end(args);
+    
+    return path_len >= 0 && (size_t) path_len < len - root_len;
+}
+
+/**
+ * Check if the server runs against simulated hardware. 
+ * @return true when a hardware root is configured. 
+ */
+bool helper_hw_simulated(void)
+{
+    return conf->hardware_root != NULL && conf->hardware_root[0] != '\0';
+}
@@ -73,5 +73,22 @@ void helper_free_char_array(struct chararray *chr_array);
  */
 bool helper_str_startswith(const char* haystack, const char* needle, size_t offset);
 
+/**
+ * Build the path of a sysfs file or device node. When a hardware root is
+ * configured the path is placed below it so the server can run against
+ * the hardware simulator.
+ * @param buf the buffer to place the path in. 
+ * @param len the size of the buffer. 
+ * @param fmt printf style format of the absolute path on real hardware. 
+ * @return false when the path did not fit in the buffer. 
+ */
+bool helper_hw_path(char* buf, size_t len, const char* fmt, ...);
+
+/**
+ * Check if the server runs against simulated hardware. 
+ * @return true when a hardware root is configured. 
+ */
+bool helper_hw_simulated(void);
+
 #endif
 
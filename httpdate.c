@@ -0,0 +1,163 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   httpdate.c
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <string.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include <libubox/uloop.h>
+
+#include "httpdate.h"
+#include "metrics.h"
+
+/* The HTTP date format as specified by RFC 7231 */
+#define HTTPDATE_FMT            "%a, %d %b %Y %H:%M:%S GMT"
+
+/**
+ * Cached formatted timestamp
+ */
+struct httpdate_entry {
+    time_t ts;                      /* The timestamp that was formatted */
+    char str[HTTPDATE_LEN];         /* The formatted timestamp */
+};
+
+/* The formatted current date */
+static struct httpdate_entry now;
+
+/* Direct mapped cache of formatted modification times */
+static struct httpdate_entry cache[HTTPDATE_CACHE_SIZE];
+
+/* Timer refreshing the current date */
+static struct uloop_timeout refresh_timer;
+
+/**
+ * Format a timestamp into a cache entry.
+ * @param e the entry to fill.
+ * @param ts the timestamp to format.
+ */
+static void httpdate_fill(struct httpdate_entry *e, time_t ts)
+{
+    struct tm t;
+
+    gmtime_r(&ts, &t);
+    strftime(e->str, sizeof(e->str), HTTPDATE_FMT, &t);
+    e->ts = ts;
+}
+
+/**
+ * Refresh the current date and re-arm the timer on the next second
+ * boundary.
+ * @param timeout the refresh timer.
+ */
+static void httpdate_refresh(struct uloop_timeout *timeout)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec != now.ts || !now.str[0])
+        httpdate_fill(&now, tv.tv_sec);
+
+    uloop_timeout_set(timeout, 1000 - tv.tv_usec / 1000);
+}
+
+/**
+ * Start refreshing the cached current date once per second. This must
+ * be called after the uloop event loop is initialized.
+ */
+void httpdate_init(void)
+{
+    refresh_timer.cb = httpdate_refresh;
+    httpdate_refresh(&refresh_timer);
+}
+
+/**
+ * Get the current date formatted for the HTTP Date header. The string
+ * is refreshed from the event loop, no time formatting is done here.
+ * @return the formatted current date.
+ */
+const char* httpdate_now(void)
+{
+    /* Format on demand when the refresh timer is not running */
+    if (!refresh_timer.pending) {
+        time_t t = time(NULL);
+
+        if (t != now.ts || !now.str[0])
+            httpdate_fill(&now, t);
+    }
+
+    return now.str;
+}
+
+/**
+ * Format a timestamp as HTTP date, for example for the Last-Modified
+ * header. Recently formatted timestamps are served from a small cache.
+ * @param ts the timestamp to format.
+ * @return the formatted date, valid until the next call.
+ */
+const char* httpdate_format(time_t ts)
+{
+    struct httpdate_entry *e = &cache[(unsigned long) ts % HTTPDATE_CACHE_SIZE];
+
+    if (e->ts != ts || !e->str[0]) {
+        metric_inc(&metric_date_misses);
+        httpdate_fill(e, ts);
+    } else {
+        metric_inc(&metric_date_hits);
+    }
+
+    return e->str;
+}
+
+/**
+ * Parse a HTTP date, for example from an If-Modified-Since header. Dates
+ * previously handed out by httpdate_format are resolved from the cache.
+ * @param date the date string to parse.
+ * @return the timestamp or 0 when the date could not be parsed.
+ */
+time_t httpdate_parse(const char *date)
+{
+    struct tm t;
+    int i;
+
+    /* Browsers send back the exact Last-Modified string they got */
+    for (i = 0; i < HTTPDATE_CACHE_SIZE; ++i) {
+        if (cache[i].str[0] && !strcmp(cache[i].str, date))
+            return cache[i].ts;
+    }
+
+    memset(&t, 0, sizeof(t));
+    if (strptime(date, "%a, %d %b %Y %H:%M:%S %Z", &t) != NULL)
+        return timegm(&t);
+
+    return 0;
+}
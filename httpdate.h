@@ -0,0 +1,71 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   httpdate.h
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#ifndef HTTPDATE_H
+#define HTTPDATE_H
+
+#include <time.h>
+
+/* Length of a formatted HTTP date including the terminating zero */
+#define HTTPDATE_LEN            30
+
+/* Number of formatted modification times kept in the cache */
+#define HTTPDATE_CACHE_SIZE     16
+
+/**
+ * Start refreshing the cached current date once per second. This must
+ * be called after the uloop event loop is initialized.
+ */
+void httpdate_init(void);
+
+/**
+ * Get the current date formatted for the HTTP Date header. The string
+ * is refreshed from the event loop, no time formatting is done here.
+ * @return the formatted current date.
+ */
+const char* httpdate_now(void);
+
+/**
+ * Format a timestamp as HTTP date, for example for the Last-Modified
+ * header. Recently formatted timestamps are served from a small cache.
+ * @param ts the timestamp to format.
+ * @return the formatted date, valid until the next call.
+ */
+const char* httpdate_format(time_t ts);
+
+/**
+ * Parse a HTTP date, for example from an If-Modified-Since header. Dates
+ * previously handed out by httpdate_format are resolved from the cache.
+ * @param date the date string to parse.
+ * @return the timestamp or 0 when the date could not be parsed.
+ */
+time_t httpdate_parse(const char *date);
+
+#endif
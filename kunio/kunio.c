@@ -49,6 +49,30 @@ c
   (byte & 0x02 ? 1 : 0), \
   (byte & 0x01 ? 1 : 0)
 
+/* The AlfaIO output control ports */
+#define ALFA_OUTPUT_PORTS	(GPIO_MASK(ALFA_ENABLE_PORT) | GPIO_MASK(ALFA_STROBE_PORT))
+
+/* True once the AlfaIO output control ports are claimed */
+static bool alfa_claimed = false;
+
+/*
+ * Claim the AlfaIO output control ports and make them outputs. The
+ * ports stay claimed so they can be written together.
+ * @return true when the ports are ready.
+ */
+static bool alfa_setup_outputs(void)
+{
+	if (!alfa_claimed && gpio_claim(ALFA_ENABLE_PORT, "kunio", GPIO_SHARED)) {
+		if (gpio_claim(ALFA_STROBE_PORT, "kunio", GPIO_SHARED))
+			alfa_claimed = true;
+		else
+			gpio_unclaim(ALFA_ENABLE_PORT, "kunio");
+	}
+
+	return alfa_claimed && gpio_set_direction(ALFA_ENABLE_PORT, GPIO_OUT)
+		&& gpio_set_direction(ALFA_STROBE_PORT, GPIO_OUT);
+}
+
 /*
  * Set the output state of the AlfaIO output modules
  * @state byte array describing the output state of the module.
@@ -60,7 +84,10 @@ void alfa_set_output(uint8_t state[], uint8_t size)
 	int dev;
 
 	/* Disable outputs */
-	gpio_write_and_close(ALFA_ENABLE_PORT, 1);
+	if (!alfa_setup_outputs()) {
+		return;
+	}
+	gpio_set_states(ALFA_OUTPUT_PORTS, GPIO_MASK(ALFA_ENABLE_PORT));
 
 	/* Initialize the SPI device for the AlfaIO module */
 	dev = spi_init(0, 8, 2500);
@@ -71,11 +98,10 @@ void alfa_set_output(uint8_t state[], uint8_t size)
 	/* Hold time */
 	usleep(1);
 
-	/* Strobe the line */
-	gpio_write_and_close(ALFA_STROBE_PORT, 1);
+	/* Strobe the line, then drop the strobe and enable the outputs at once */
+	gpio_set_states(GPIO_MASK(ALFA_STROBE_PORT), GPIO_MASK(ALFA_STROBE_PORT));
 	usleep(1);
-	gpio_write_and_close(ALFA_STROBE_PORT, 0);
-	gpio_write_and_close(ALFA_ENABLE_PORT, 0);
+	gpio_set_states(ALFA_OUTPUT_PORTS, 0);
 }
 
 /*
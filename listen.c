@@ -98,6 +98,14 @@ static void uh_poll_listeners(struct uloop_timeout *timeout) {
     }
 }
 
+/**
+ * Get the number of blocked listeners.
+ * @return the number of listeners waiting for free connections.
+ */
+int blocked_listeners(void) {
+    return n_blocked;
+}
+
 /**
  * Unblock all blocked listeners in the listener list.
  */
@@ -47,6 +47,12 @@ bool bind_listener_sockets(const char *host, const char *port, bool tls);
  */
 void setup_listeners(void);
 
+/**
+ * Get the number of blocked listeners.
+ * @return the number of listeners waiting for free connections.
+ */
+int blocked_listeners(void);
+
 /**
  * Unblock all blocked listeners in the listener list.
  */
@@ -29,32 +29,328 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
 
 #include "logger.h"
 
 /**
- * Log message
+ * A slot in the message queue. The sequence number tells who owns the
+ * slot: it equals the queue position when the slot is free for a producer
+ * and the position plus one when it holds a message for the logger thread.
+ */
+struct log_slot {
+    unsigned long seq;                  /* Slot sequence number */
+    int level;                          /* The message log level */
+    time_t time;                        /* When the message was logged */
+    int len;                            /* The message length */
+    char text[LOG_LINE_LEN];            /* The formatted message */
+};
+
+/** The runtime log level, messages above it are not formatted */
+int log_level = LOG_DEBUG;
+
+/** Level names used in the message prefix */
+static const char * const level_names[] = {
+    [LOG_ERROR] = "ERROR",
+    [LOG_WARNING] = "WARNING",
+    [LOG_INFO] = "INFO",
+    [LOG_DEBUG] = "DEBUG",
+};
+
+/** The message queue, many producers and one consumer at a time */
+static struct log_slot ring[LOG_RING_SIZE];
+static unsigned long ring_head;         /* Next position to produce */
+static unsigned long ring_tail;         /* Next position to consume */
+static unsigned long ring_dropped;      /* Messages dropped on a full queue */
+
+/** True when the logger thread runs */
+static bool running;
+
+/** Wakes up the logger thread, it only sleeps on an empty queue */
+static int wake_fd = -1;
+static bool sleeping;
+
+/** Serialises the consumers, the logger thread and log_flush */
+static pthread_mutex_t consume_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Cached timestamp text, guarded by the consume lock */
+static time_t stamp_time = -1;
+static char stamp[32];
+
+/**
+ * Format the timestamp text of a second.
+ * @param t the time to format
+ * @param buf receives the timestamp text
+ * @param size the size of the buffer
+ */
+static void log_format_stamp(time_t t, char *buf, size_t size)
+{
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    snprintf(buf, size, "%d-%d-%d %d:%d:%d",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+/**
+ * Get the cached timestamp text of a second, localtime is only called
+ * when the second changes. The caller must hold the consume lock.
+ * @param t the time to format
+ * @return the timestamp text
+ */
+static const char* log_stamp(time_t t)
+{
+    if (t != stamp_time) {
+        log_format_stamp(t, stamp, sizeof(stamp));
+        stamp_time = t;
+    }
+
+    return stamp;
+}
+
+/**
+ * Format a message. A message truncated at LOG_LINE_LEN keeps its line
+ * end so it does not run into the next one.
+ * @param text receives the message, LOG_LINE_LEN bytes
+ * @param format the format string
+ * @param args the arguments to format
+ * @return the message length
+ */
+static int log_format(char *text, const char *format, va_list args)
+{
+    int len = vsnprintf(text, LOG_LINE_LEN, format, args);
+
+    if (len < 0)
+        return 0;
+
+    if (len >= LOG_LINE_LEN) {
+        len = LOG_LINE_LEN - 1;
+        text[len - 2] = '\r';
+        text[len - 1] = '\n';
+    }
+
+    return len;
+}
+
+/**
+ * Write a message to the console, errors and warnings go to stderr.
+ * @param level the message log level
+ * @param stamp the timestamp text of the message
+ * @param text the message
+ * @param len the message length
+ */
+static void log_output(int level, const char *stamp, const char *text, int len)
+{
+    char prefix[64];
+    struct iovec iov[2];
+
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = snprintf(prefix, sizeof(prefix), "[%s][%s] ", level_names[level], stamp);
+    iov[1].iov_base = (void*) text;
+    iov[1].iov_len = len;
+
+    if (writev(level <= LOG_WARNING ? STDERR_FILENO : STDOUT_FILENO, iov, 2) < 0) {
+        /* Nothing sensible can be done when the console is gone */
+    }
+}
+
+/**
+ * Write all queued messages. The caller must hold the consume lock.
+ */
+static void log_drain(void)
+{
+    struct log_slot *slot;
+    unsigned long dropped;
+    char buf[64];
+    int len;
+
+    while (true) {
+        slot = &ring[ring_tail & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring_tail + 1)
+            break;
+
+        log_output(slot->level, log_stamp(slot->time), slot->text, slot->len);
+
+        /* Hand the slot back to the producers for the next lap */
+        __atomic_store_n(&slot->seq, ring_tail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        ring_tail++;
+    }
+
+    dropped = __atomic_exchange_n(&ring_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) {
+        len = snprintf(buf, sizeof(buf), "%lu log messages dropped\r\n", dropped);
+        log_output(LOG_WARNING, log_stamp(time(NULL)), buf, len);
+    }
+}
+
+/**
+ * Write all queued messages. 
+ */
+void log_flush(void)
+{
+    pthread_mutex_lock(&consume_lock);
+    log_drain();
+    pthread_mutex_unlock(&consume_lock);
+}
+
+/**
+ * Check if a message is waiting at the head of the queue.
+ * @return true when there is a message to write
+ */
+static bool log_pending(void)
+{
+    bool pending;
+
+    pthread_mutex_lock(&consume_lock);
+    pending = __atomic_load_n(&ring[ring_tail & (LOG_RING_SIZE - 1)].seq, __ATOMIC_ACQUIRE) == ring_tail + 1;
+    pthread_mutex_unlock(&consume_lock);
+
+    return pending;
+}
+
+/**
+ * Entry point of the logger thread. It blocks until a producer queues a
+ * message on the empty queue, so an idle server has no wakeups.
+ * @param arg not used
+ */
+static void* log_thread(void *arg)
+{
+    uint64_t count;
+
+    while (true) {
+        log_flush();
+
+        /* A message queued before the flag is set is seen by the check */
+        __atomic_store_n(&sleeping, true, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!log_pending() && read(wake_fd, &count, sizeof(count)) < 0) {
+            /* Interrupted, the queue is checked again */
+        }
+        __atomic_store_n(&sleeping, false, __ATOMIC_SEQ_CST);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the logger thread. Messages logged before are written directly.
+ * Must be called after the process has forked into the background.
+ * @return true on success, false when messages stay synchronous.
+ */
+bool log_init(void)
+{
+    pthread_t thread;
+    unsigned long i;
+
+    for (i = 0; i < LOG_RING_SIZE; ++i)
+        ring[i].seq = i;
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd < 0)
+        return false;
+
+    if (pthread_create(&thread, NULL, log_thread, NULL) != 0) {
+        close(wake_fd);
+        wake_fd = -1;
+        return false;
+    }
+
+    pthread_detach(thread);
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+
+    /* Do not lose queued messages when the server exits */
+    atexit(log_flush);
+
+    return true;
+}
+
+/**
+ * Queue a log message, use log_message instead. The message is formatted
+ * in the calling thread and written by the logger thread. When the queue
+ * is full the message is dropped and counted.
  * @param level the loglevel to use
  * @format the format string
  * @args the arguments to log
  */
-void log_message(const char* level, const char *format, ...)
+void log_write(int level, const char *format, ...)
 {
-    time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    struct log_slot *slot;
+    unsigned long pos, seq;
+    char text[LOG_LINE_LEN];
+    char now[32];
     va_list args;
+    int len;
+
     va_start(args, format);
-    
-    if(strcmp(level, LOG_ERROR) != 0){
-        fprintf(stderr, level, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
-        vfprintf(stderr, format, args);
-    } else {
-        printf(level, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
-        vprintf(format, args);
+
+    /* Without the logger thread the message is written right away */
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        len = log_format(text, format, args);
+        va_end(args);
+        log_format_stamp(time(NULL), now, sizeof(now));
+        log_output(level, now, text, len);
+        return;
+    }
+
+    /* Claim the next free slot */
+    pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    while (true) {
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if ((long) (seq - pos) < 0) {
+            /* The logger thread did not free this slot yet, the queue is full */
+            __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+            va_end(args);
+            return;
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
     }
 
+    len = log_format(slot->text, format, args);
     va_end(args);
+
+    slot->level = level;
+    slot->time = time(NULL);
+    slot->len = len;
+
+    /* Publish the message to the logger thread, wake it up when it waits for one */
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&sleeping, false, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            /* The counter can not overflow with one write per wakeup */
+        }
+    }
+}
+
+/**
+ * Parse the name of a log level. 
+ * @param name the level name, "error", "warning", "info" or "debug". 
+ * @return the log level, -1 when the name is unknown. 
+ */
+int log_parse_level(const char *name)
+{
+    int i;
+
+    for (i = 0; i < (int) (sizeof(level_names) / sizeof(level_names[0])); ++i) {
+        if (!strcasecmp(name, level_names[i]))
+            return i;
+    }
+
+    return -1;
 }
@@ -31,18 +31,65 @@
 #ifndef LOGGER_H
 #define	LOGGER_H
 
-#define LOG_ERROR    "[ERROR][%d-%d-%d %d:%d:%d] "
-#define LOG_INFO     "[INFO][%d-%d-%d %d:%d:%d] "
-#define LOG_DEBUG    "[DEBUG][%d-%d-%d %d:%d:%d] "
-#define LOG_WARNING  "[WARNING][%d-%d-%d %d:%d:%d] "
+#include <stdbool.h>
 
+/* Log levels, a lower level is more important */
+#define LOG_ERROR    0
+#define LOG_WARNING  1
+#define LOG_INFO     2
+#define LOG_DEBUG    3
+
+/* Messages above this level are not compiled in */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL   LOG_DEBUG
+#endif
+
+#define LOG_RING_SIZE       256         /* Number of queued messages, must be a power of two */
+#define LOG_LINE_LEN        256         /* Maximum length of a message, the prefix is stored separately */
+
+/** The runtime log level, messages above it are not formatted */
+extern int log_level;
+
+/**
+ * Log message. The level is checked before the arguments are evaluated,
+ * messages above LOG_COMPILE_LEVEL are removed by the compiler.
+ * @param level the loglevel to use
+ * @format the format string
+ * @args the arguments to log
+ */
+#define log_message(level, ...) \
+    do { \
+        if ((level) <= LOG_COMPILE_LEVEL && (level) <= log_level) \
+            log_write(level, __VA_ARGS__); \
+    } while (0)
 
 /**
- * Log message
+ * Queue a log message, use log_message instead. The message is formatted
+ * in the calling thread and written by the logger thread. When the queue
+ * is full the message is dropped and counted.
  * @param level the loglevel to use
  * @format the format string
  * @args the arguments to log
  */
-void log_message(const char* level, const char *format, ...);
+void log_write(int level, const char *format, ...);
+
+/**
+ * Start the logger thread. Messages logged before are written directly.
+ * Must be called after the process has forked into the background.
+ * @return true on success, false when messages stay synchronous.
+ */
+bool log_init(void);
+
+/**
+ * Write all queued messages. 
+ */
+void log_flush(void);
+
+/**
+ * Parse the name of a log level. 
+ * @param name the level name, "error", "warning", "info" or "debug". 
+ * @return the log level, -1 when the name is unknown. 
+ */
+int log_parse_level(const char *name);
 
 #endif
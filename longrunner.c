@@ -33,9 +33,12 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "longrunner.h"
 #include "logger.h"
+#include "metrics.h"
+#include "blackbox/blackbox.h"
 
 /**
  * Longrunner methods list
@@ -76,9 +79,15 @@ void longrunner_add(void* function, uint32_t timeout)
 void longrunner_start()
 {
     int i = 1;
+    char labels[32];
     longrunner_method* l_method = l_list->next;
     
     while(l_method != NULL) {
+        l_method->index = i;
+        snprintf(labels, sizeof(labels), "runner=\"%d\"", i);
+        l_method->duration = metrics_get(METRIC_HISTOGRAM, "dpt_longrunner_duration_seconds",
+                "Duration of a longrunner run.", labels);
+        
         log_message(LOG_INFO, "Starting longrunner thread %d\r\n", i++);
         pthread_t thread;
         if(pthread_create(&thread, NULL, longrunner_thread, (void*) l_method) != 0) {
@@ -109,7 +118,13 @@ void* longrunner_thread(void* args)
     
     while(true) {
         /* Run the longrunner task */
+        uint64_t start = metrics_now();
         function();
+        uint64_t duration = metrics_now() - start;
+        if(l_method->duration) {
+            metric_observe(l_method->duration, duration);
+        }
+        blackbox_record(BB_LONGRUNNER, l_method->index, duration, 0);
         
         /* Wait for x ms after execution */
         usleep(l_method->timeout_ms*1000);
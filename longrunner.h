@@ -33,11 +33,15 @@
 
 #include <stdint.h>
 
+struct metric;
+
 /* Linked list of longrunner methods */
 typedef struct l_method {
     void* function;             /* The longrunner function to execute */
     uint32_t timeout_ms;        /* Timeout to wait befor re-execution */
     struct l_method* next;    /* The next longrunner function */
+    struct metric* duration;    /* Histogram of the run durations */
+    int index;                  /* Number of the longrunner, starting at 1 */
 } longrunner_method;
 
 /**
@@ -52,6 +52,13 @@
 #include "database/database.h"
 #include "logger.h"
 #include "longrunner.h"
+#include "httpdate.h"
+#include "events/events.h"
+#include "metrics.h"
+#include "blackbox/blackbox.h"
+#include "gpio/gpio.h"
+#include "gpio/gpio_snapshot.h"
+#include "pwm/pwm.h"
 
 #include "wifi/wifi_longrunner.h"
 #include "stumon/stumon_longrunner.h"
@@ -115,6 +122,16 @@ int main(int argc, char **argv) {
         }
     }
 
+    /* Write log messages from a background thread from now on */
+    if (!log_init()) {
+        log_message(LOG_WARNING, "Could not start the logger thread, logging synchronously\r\n");
+    }
+
+    /* Record events in a ring that survives a crash */
+    if (*conf->blackbox_path && !blackbox_init(conf->blackbox_path)) {
+        log_message(LOG_WARNING, "Could not open blackbox %s\r\n", conf->blackbox_path);
+    }
+
     /* Initialize database */
     if (dao_create_db() != DB_OK) {
         /* The server can't run without database */
@@ -123,14 +140,30 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
     
-    /* Initialize and start longrunners */
-    longrunner_init();
-    setup_longrunners();
-    longrunner_start();
-    
     /* Initialize network event loop */
     uloop_init();
 
+    /* Keep the HTTP Date header up to date */
+    httpdate_init();
+
+    /* Start the event bus before anything can publish */
+    events_init();
+
+    /* Register the server metrics before any thread updates them */
+    metrics_init();
+
+    /* Select the GPIO backend before anything touches a port */
+    gpio_init();
+    gpio_snapshot_init();
+    pwm_init();
+
+    /* Initialize and start longrunners, these need the hardware */
+    longrunner_init();
+    if (conf->longrunners) {
+        setup_longrunners();
+        longrunner_start();
+    }
+
     /* Set up all listener sockets */
     setup_listeners();
 
@@ -0,0 +1,344 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   metrics.c
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "uhttpd.h"
+#include "client.h"
+#include "listen.h"
+#include "metrics.h"
+
+/* The metrics registry, metrics with the same name are kept together */
+static LIST_HEAD(metrics);
+
+/* Upper bounds of the histogram buckets in microseconds */
+static const uint64_t bucket_bounds[METRIC_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000
+};
+
+struct metric metric_bytes_in = {
+    .name = "dpt_http_received_bytes_total",
+    .help = "Bytes received from HTTP clients.",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_bytes_out = {
+    .name = "dpt_http_sent_bytes_total",
+    .help = "Response bytes written to HTTP clients.",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_date_hits = {
+    .name = "dpt_httpdate_cache_total",
+    .help = "Lookups in the formatted HTTP date cache.",
+    .labels = "result=\"hit\"",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_date_misses = {
+    .name = "dpt_httpdate_cache_total",
+    .help = "Lookups in the formatted HTTP date cache.",
+    .labels = "result=\"miss\"",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_not_modified = {
+    .name = "dpt_file_not_modified_total",
+    .help = "Static file requests answered from the client cache.",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_api_not_modified = {
+    .name = "dpt_api_not_modified_total",
+    .help = "API requests answered from the client cache.",
+    .type = METRIC_COUNTER,
+};
+
+struct metric metric_db_duration = {
+    .name = "dpt_db_statement_duration_seconds",
+    .help = "Duration of database statements.",
+    .type = METRIC_HISTOGRAM,
+};
+
+/**
+ * Get the number of connected clients.
+ * @return the number of clients.
+ */
+static int64_t metrics_read_clients(void)
+{
+    return n_clients;
+}
+
+/**
+ * Get the number of blocked listeners.
+ * @return the number of listeners waiting for free connections.
+ */
+static int64_t metrics_read_blocked(void)
+{
+    return blocked_listeners();
+}
+
+static struct metric metric_clients = {
+    .name = "dpt_http_connections",
+    .help = "Currently connected HTTP clients.",
+    .type = METRIC_GAUGE,
+    .read = metrics_read_clients,
+};
+
+static struct metric metric_blocked = {
+    .name = "dpt_http_blocked_listeners",
+    .help = "Listeners blocked because the connection limit is reached.",
+    .type = METRIC_GAUGE,
+    .read = metrics_read_blocked,
+};
+
+/* Responses per status class */
+static struct metric metric_responses[5] = {
+    { .name = "dpt_http_responses_total", .help = "HTTP responses by status class.", .labels = "code=\"1xx\"" },
+    { .name = "dpt_http_responses_total", .help = "HTTP responses by status class.", .labels = "code=\"2xx\"" },
+    { .name = "dpt_http_responses_total", .help = "HTTP responses by status class.", .labels = "code=\"3xx\"" },
+    { .name = "dpt_http_responses_total", .help = "HTTP responses by status class.", .labels = "code=\"4xx\"" },
+    { .name = "dpt_http_responses_total", .help = "HTTP responses by status class.", .labels = "code=\"5xx\"" },
+};
+
+/**
+ * Register the server metrics. Must be called from the main thread
+ * before other threads are started.
+ */
+void metrics_init(void)
+{
+    int i;
+
+    metrics_register(&metric_clients);
+    metrics_register(&metric_blocked);
+    metrics_register(&metric_bytes_in);
+    metrics_register(&metric_bytes_out);
+    for (i = 0; i < 5; ++i)
+        metrics_register(&metric_responses[i]);
+    metrics_register(&metric_date_hits);
+    metrics_register(&metric_date_misses);
+    metrics_register(&metric_not_modified);
+    metrics_register(&metric_api_not_modified);
+    metrics_register(&metric_db_duration);
+}
+
+/**
+ * Register a metric. Metrics with the same name are exported together,
+ * so they must have the same type and help text. This must be called
+ * from the main thread.
+ * @param m the metric to register.
+ */
+void metrics_register(struct metric *m)
+{
+    struct metric *cur;
+    struct list_head *pos = &metrics;
+
+    /* Insert after the last metric with the same name */
+    list_for_each_entry(cur, &metrics, list) {
+        if (!strcmp(cur->name, m->name))
+            pos = &cur->list;
+    }
+
+    if (pos == &metrics)
+        list_add_tail(&m->list, &metrics);
+    else
+        list_add(&m->list, pos);
+}
+
+/**
+ * Get a metric by name and labels, the metric is created when it does
+ * not exist yet. This must be called from the main thread.
+ * @param type the metric type.
+ * @param name the metric name.
+ * @param help the description of the metric.
+ * @param labels the label set, for example route="gpio",method="GET".
+ * @return the metric, NULL when out of memory.
+ */
+struct metric* metrics_get(enum metric_type type, const char *name, const char *help, const char *labels)
+{
+    struct metric *m;
+
+    list_for_each_entry(m, &metrics, list) {
+        if (!strcmp(m->name, name) && m->labels && !strcmp(m->labels, labels))
+            return m;
+    }
+
+    m = calloc(1, sizeof(*m));
+    if (m == NULL)
+        return NULL;
+
+    m->type = type;
+    m->name = name;
+    m->help = help;
+    m->labels = strdup(labels);
+    metrics_register(m);
+
+    return m;
+}
+
+/**
+ * Record a histogram observation.
+ * @param m the histogram.
+ * @param usecs the observed duration in microseconds.
+ */
+void metric_observe(struct metric *m, uint64_t usecs)
+{
+    int i = 0;
+
+    while (i < METRIC_BUCKETS && usecs > bucket_bounds[i])
+        i++;
+
+    __atomic_fetch_add(&m->buckets[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->sum, usecs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Count a response status code.
+ * @param code the HTTP status code.
+ */
+void metrics_count_status(int code)
+{
+    if (code >= 100 && code < 600)
+        metric_inc(&metric_responses[code / 100 - 1]);
+}
+
+/**
+ * Get a monotonic timestamp for duration measurements.
+ * @return the time in microseconds.
+ */
+uint64_t metrics_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Write the name and labels of a sample.
+ * @param f the output stream.
+ * @param name the metric name.
+ * @param suffix the sample suffix, for example "_bucket".
+ * @param labels the metric labels, NULL for none.
+ * @param extra an additional label, NULL for none.
+ */
+static void metrics_write_sample(FILE *f, const char *name, const char *suffix,
+        const char *labels, const char *extra)
+{
+    fprintf(f, "%s%s", name, suffix);
+    if (labels || extra) {
+        fprintf(f, "{%s%s%s}", labels ? labels : "",
+                labels && extra ? "," : "", extra ? extra : "");
+    }
+}
+
+/**
+ * Write a histogram.
+ * @param f the output stream.
+ * @param m the histogram.
+ */
+static void metrics_write_histogram(FILE *f, struct metric *m)
+{
+    uint64_t total = 0;
+    char le[32];
+    int i;
+
+    for (i = 0; i <= METRIC_BUCKETS; ++i) {
+        total += __atomic_load_n(&m->buckets[i], __ATOMIC_RELAXED);
+        if (i < METRIC_BUCKETS)
+            snprintf(le, sizeof(le), "le=\"%g\"", bucket_bounds[i] / 1e6);
+        else
+            snprintf(le, sizeof(le), "le=\"+Inf\"");
+
+        metrics_write_sample(f, m->name, "_bucket", m->labels, le);
+        fprintf(f, " %" PRIu64 "\n", total);
+    }
+
+    metrics_write_sample(f, m->name, "_sum", m->labels, NULL);
+    fprintf(f, " %g\n", __atomic_load_n(&m->sum, __ATOMIC_RELAXED) / 1e6);
+    metrics_write_sample(f, m->name, "_count", m->labels, NULL);
+    fprintf(f, " %" PRIu64 "\n", __atomic_load_n(&m->count, __ATOMIC_RELAXED));
+}
+
+/**
+ * Export all metrics in the Prometheus text format.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return true when the response was handled.
+ */
+bool metrics_handle_request(struct client *cl, char *request)
+{
+    static const char * const types[] = {
+        [METRIC_COUNTER] = "counter",
+        [METRIC_GAUGE] = "gauge",
+        [METRIC_HISTOGRAM] = "histogram",
+    };
+    struct metric *m;
+    const char *last = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    int64_t value;
+    FILE *f;
+
+    f = open_memstream(&buf, &len);
+    if (f == NULL) {
+        client_send_error(cl, 500, "Internal Server Error", NULL);
+        return true;
+    }
+
+    list_for_each_entry(m, &metrics, list) {
+        /* Describe every metric family once */
+        if (!last || strcmp(last, m->name)) {
+            fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name, types[m->type]);
+            last = m->name;
+        }
+
+        if (m->type == METRIC_HISTOGRAM) {
+            metrics_write_histogram(f, m);
+            continue;
+        }
+
+        value = m->read ? m->read() : __atomic_load_n(&m->value, __ATOMIC_RELAXED);
+        metrics_write_sample(f, m->name, "", m->labels, NULL);
+        fprintf(f, " %" PRId64 "\n", value);
+    }
+
+    fclose(f);
+    client_write_response(cl, 200, "OK", "text/plain; version=0.0.4", NULL, buf, len);
+    free(buf);
+
+    return true;
+}
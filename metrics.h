@@ -0,0 +1,158 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   metrics.h
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libubox/list.h>
+
+struct client;
+
+#define METRIC_BUCKETS          14              /* Number of finite histogram buckets */
+
+/* Metric types */
+enum metric_type {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+};
+
+/**
+ * A metric in the registry. Values are updated with atomic operations so
+ * they can be changed from any thread without locking. The values are 64
+ * bit so byte counters and duration sums do not wrap, 32 bit targets
+ * without 64 bit atomic instructions link libatomic for them.
+ */
+struct metric {
+    struct list_head list;                      /* The metrics registry */
+    const char *name;                           /* The metric name */
+    const char *help;                           /* Description of the metric */
+    const char *labels;                         /* Label set without braces, NULL for none */
+    enum metric_type type;                      /* The metric type */
+    int64_t value;                              /* Counter or gauge value */
+    int64_t (*read)(void);                      /* Optional gauge callback, called on export */
+    uint64_t buckets[METRIC_BUCKETS + 1];       /* Histogram buckets, the last one is +Inf */
+    uint64_t count;                             /* Number of histogram observations */
+    uint64_t sum;                               /* Sum of the observations in microseconds */
+};
+
+/* Metrics updated throughout the server */
+extern struct metric metric_bytes_in;           /* Bytes received from clients */
+extern struct metric metric_bytes_out;          /* Response bytes written to clients */
+extern struct metric metric_date_hits;          /* HTTP date cache hits */
+extern struct metric metric_date_misses;        /* HTTP date cache misses */
+extern struct metric metric_not_modified;       /* Static files served as 304 */
+extern struct metric metric_api_not_modified;   /* API responses served as 304 */
+extern struct metric metric_db_duration;        /* Database statement durations */
+
+/**
+ * Register the server metrics. Must be called from the main thread
+ * before other threads are started.
+ */
+void metrics_init(void);
+
+/**
+ * Register a metric. Metrics with the same name are exported together,
+ * so they must have the same type and help text. This must be called
+ * from the main thread.
+ * @param m the metric to register.
+ */
+void metrics_register(struct metric *m);
+
+/**
+ * Get a metric by name and labels, the metric is created when it does
+ * not exist yet. This must be called from the main thread.
+ * @param type the metric type.
+ * @param name the metric name.
+ * @param help the description of the metric.
+ * @param labels the label set, for example route="gpio",method="GET".
+ * @return the metric, NULL when out of memory.
+ */
+struct metric* metrics_get(enum metric_type type, const char *name, const char *help, const char *labels);
+
+/**
+ * Record a histogram observation.
+ * @param m the histogram.
+ * @param usecs the observed duration in microseconds.
+ */
+void metric_observe(struct metric *m, uint64_t usecs);
+
+/**
+ * Count a response status code.
+ * @param code the HTTP status code.
+ */
+void metrics_count_status(int code);
+
+/**
+ * Get a monotonic timestamp for duration measurements.
+ * @return the time in microseconds.
+ */
+uint64_t metrics_now(void);
+
+/**
+ * Export all metrics in the Prometheus text format.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return true when the response was handled.
+ */
+bool metrics_handle_request(struct client *cl, char *request);
+
+/**
+ * Increment a counter.
+ * @param m the counter.
+ */
+static inline void metric_inc(struct metric *m)
+{
+    __atomic_fetch_add(&m->value, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Add to a counter or gauge.
+ * @param m the metric.
+ * @param v the value to add, may be negative for gauges.
+ */
+static inline void metric_add(struct metric *m, int64_t v)
+{
+    __atomic_fetch_add(&m->value, v, __ATOMIC_RELAXED);
+}
+
+/**
+ * Set a gauge.
+ * @param m the gauge.
+ * @param v the new value.
+ */
+static inline void metric_set(struct metric *m, int64_t v)
+{
+    __atomic_store_n(&m->value, v, __ATOMIC_RELAXED);
+}
+
+#endif
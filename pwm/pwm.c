@@ -28,160 +28,377 @@
  * Created on September 12, 2015, 1:43 AM
  */
 
-
 #include <stdio.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
 #include <time.h>
-#include <sys/mman.h>
-#include <signal.h>
 #include <sched.h>
-#include <unistd.h>
+#include <pthread.h>
 
-#include "pwm.h"
+#include "../config.h"
+#include "../logger.h"
+#include "../metrics.h"
+#include "../blackbox/blackbox.h"
 #include "../gpio/gpio.h"
+#include "pwm.h"
+
+#define NSEC_PER_SEC            1000000000ULL
+
+/**
+ * A PWM channel. The channel alternates between a rising edge at the
+ * start of every period and a falling edge after the high time. Channels
+ * at 0 or 100 percent duty have no edges and keep a static level.
+ */
+struct pwm_channel {
+    int gpio;                   /* The GPIO port, -1 when the channel is free */
+    unsigned int frequency;     /* The frequency in Hz */
+    unsigned int duty;          /* The duty cycle in per mille */
+    uint64_t period;            /* The period in nanoseconds */
+    uint64_t high;              /* The high time in nanoseconds */
+    uint64_t start;             /* Start of the current period */
+    uint64_t next;              /* Time of the next edge, 0 for a static level */
+    bool level;                 /* The level written at the next edge */
+    uint64_t periods;           /* Number of completed periods */
+    uint64_t late;              /* Number of missed edges */
+    uint64_t jitter_sum;        /* Sum of the edge lateness in nanoseconds */
+    uint64_t jitter_count;      /* Number of edges in the sum */
+    uint64_t jitter_max;        /* Maximum edge lateness in nanoseconds */
+};
+
+/* The channels, guarded by the lock, pwm_init makes it inherit priority */
+static struct pwm_channel channels[PWM_MAX_CHANNELS] = {
+    [0 ... PWM_MAX_CHANNELS - 1] = { .gpio = -1 }
+};
+static int active = 0;
+static pthread_mutex_t pwm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Wakes up the engine thread when the first channel is started */
+static pthread_cond_t pwm_cond = PTHREAD_COND_INITIALIZER;
+static bool started = false;
+
+static struct metric metric_pwm_jitter = {
+    .name = "dpt_pwm_jitter_seconds",
+    .help = "Lateness of software PWM edges.",
+    .type = METRIC_HISTOGRAM,
+};
+
+/**
+ * Get the monotonic time used for the PWM schedule.
+ * @return the time in nanoseconds.
+ */
+static uint64_t pwm_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Find the channel of a port.
+ * @param gpio the GPIO port, -1 to find a free channel.
+ * @return the channel or NULL when there is none.
+ */
+static struct pwm_channel* pwm_find(int gpio)
+{
+    int i;
+
+    for (i = 0; i < PWM_MAX_CHANNELS; ++i) {
+        if (channels[i].gpio == gpio) {
+            return &channels[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Handle the edge of a channel that is due and schedule its next edge.
+ * Must be called with the lock held.
+ * @param ch the channel.
+ * @param now the current time.
+ * @param states receives the level of the port.
+ */
+static void pwm_edge(struct pwm_channel *ch, uint64_t now, uint32_t *states)
+{
+    uint64_t jitter = now - ch->next;
+
+    ch->jitter_sum += jitter;
+    ch->jitter_count++;
+    if (jitter > ch->jitter_max) {
+        ch->jitter_max = jitter;
+    }
+    metric_observe(&metric_pwm_jitter, jitter / 1000);
 
-volatile unsigned long *gpioAddress;
+    if (ch->level) {
+        *states |= GPIO_MASK(ch->gpio);
+        ch->next = ch->start + ch->high;
+    } else {
+        ch->start += ch->period;
+        ch->next = ch->start;
+        ch->periods++;
+    }
+    ch->level = !ch->level;
+
+    /* Fell behind, restart from this edge and keep the full high or low time */
+    if (ch->next <= now) {
+        ch->late++;
+        if (ch->level) {
+            ch->start = now + ch->period - ch->high;
+            ch->next = ch->start;
+        } else {
+            ch->start = now;
+            ch->next = now + ch->high;
+        }
+    }
+}
 
-static int gpioSetup()
+/**
+ * The PWM engine thread. It sleeps until the earliest edge of all
+ * channels and writes all edges that are due with one bulk write.
+ * @param arg unused.
+ * @return never returns.
+ */
+static void* pwm_thread(void *arg)
 {
-    int  m_mfd;
-    if ((m_mfd = open("/dev/mem", O_RDWR)) < 0)
-    {
-        return -1;
+    struct sched_param param = { .sched_priority = PWM_PRIORITY };
+    struct timespec ts;
+    uint64_t deadline, now;
+    uint32_t mask, states;
+    int i, err;
+
+    /* Real-time priority keeps the jitter down, run anyway without it */
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) {
+        log_message(LOG_WARNING, "pwm: no real-time priority, edges will jitter more: %s\r\n", strerror(err));
     }
-    gpioAddress = (unsigned long*)mmap(NULL, GPIO_BLOCK, PROT_READ|PROT_WRITE, MAP_SHARED, m_mfd, GPIO_ADDR);
-    close(m_mfd);
 
-    if (gpioAddress == MAP_FAILED)
-    {
-        return -2;
+    pthread_mutex_lock(&pwm_lock);
+    while (true) {
+        while (active == 0) {
+            pthread_cond_wait(&pwm_cond, &pwm_lock);
+        }
+
+        /* Sleep until the earliest edge, bounded so changes are picked up */
+        deadline = pwm_now() + PWM_MAX_SLEEP_MS * 1000000ULL;
+        for (i = 0; i < PWM_MAX_CHANNELS; ++i) {
+            if (channels[i].gpio >= 0 && channels[i].next && channels[i].next < deadline) {
+                deadline = channels[i].next;
+            }
+        }
+        pthread_mutex_unlock(&pwm_lock);
+
+        ts.tv_sec = deadline / NSEC_PER_SEC;
+        ts.tv_nsec = deadline % NSEC_PER_SEC;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+        pthread_mutex_lock(&pwm_lock);
+        now = pwm_now();
+        mask = states = 0;
+        for (i = 0; i < PWM_MAX_CHANNELS; ++i) {
+            if (channels[i].gpio >= 0 && channels[i].next && channels[i].next <= now) {
+                mask |= GPIO_MASK(channels[i].gpio);
+                pwm_edge(&channels[i], now, &states);
+            }
+        }
+
+        /* Edges are too frequent for the blackbox, only channel changes are recorded */
+        if (mask) {
+            gpio_set_states_quiet(mask, states);
+        }
     }
 
-    return 0;
+    return NULL;
 }
 
-static void gpioDirection(int gpio, int direction)
+/**
+ * Initialize the PWM engine, this registers the jitter metric and must
+ * be called from the main thread. The engine thread is started when the
+ * first channel is set.
+ */
+void pwm_init(void)
 {
-    unsigned long value = *(gpioAddress + 0); // obtain current settings
-    if (direction == 1)
-    {
-        value |= (1 < gpio); // set bit to 1
-    }
-    else
-    {
-        value &= ~(1 < gpio); // clear bit
-    }
-    *(gpioAddress + 0) = value;
-    
-    value = *(gpioAddress + 2); // obtain current settings
-    if (direction == 1)
-    {
-        value |= (1 < gpio); // set bit to 1
-    }
-    else
-    {
-        value &= ~(1 < gpio); // clear bit
-    }
-    *(gpioAddress + 2) = value;
+    pthread_mutexattr_t attr;
+
+    /* The real-time engine shares the lock with the event loop */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&pwm_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    metrics_register(&metric_pwm_jitter);
 }
 
-static void gpioSet(int gpio, int value)
+/**
+ * Start the engine thread. Must be called with the lock held.
+ * @return true when the thread is running.
+ */
+static bool pwm_start(void)
 {
-    if (value == 0)
-    {
-        *(gpioAddress + 4) = (1 < gpio);
+    pthread_t thread;
+
+    if (!started) {
+        if (pthread_create(&thread, NULL, pwm_thread, NULL) != 0) {
+            log_message(LOG_ERROR, "pwm: could not start the engine thread\r\n");
+            return false;
+        }
+
+        pthread_detach(thread);
+        started = true;
     }
-    else
-    {
-        *(gpioAddress + 3) = (1 < gpio);
+
+    return true;
+}
+
+/**
+ * Get the highest PWM frequency of a port. Every edge on a sysfs or
+ * chardev port is a system call, only bit-banged ports go fast.
+ * @param gpio the GPIO port.
+ * @return the maximum frequency in Hz.
+ */
+unsigned int pwm_max_frequency(int gpio)
+{
+    return gpio_is_mmio(gpio) ? PWM_MAX_FREQUENCY_MMIO : PWM_MAX_FREQUENCY;
+}
+
+/**
+ * Start a PWM channel or change its frequency and duty cycle. The port is
+ * claimed exclusively and configured as output when the channel is new.
+ * @param gpio the GPIO port.
+ * @param frequency the frequency in Hz, 1 to pwm_max_frequency.
+ * @param duty the duty cycle in per mille, 0 to PWM_DUTY_MAX.
+ * @return true on success.
+ */
+bool pwm_set(int gpio, unsigned int frequency, unsigned int duty)
+{
+    struct pwm_channel *ch;
+    bool running, claimed = false;
+
+    if (gpio < 0 || gpio >= 28 || !gpio_config[gpio] ||
+        frequency == 0 || frequency > pwm_max_frequency(gpio) || duty > PWM_DUTY_MAX) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pwm_lock);
+    running = pwm_find(gpio) != NULL;
+    pthread_mutex_unlock(&pwm_lock);
+
+    /* Exporting can be slow, claim without the lock the engine thread waits on */
+    if (!running) {
+        claimed = gpio_claim(gpio, "pwm", GPIO_EXCLUSIVE);
+        if (!claimed || !gpio_set_direction(gpio, GPIO_OUT)) {
+            if (claimed) {
+                gpio_unclaim(gpio, "pwm");
+            }
+            return false;
+        }
     }
+
+    pthread_mutex_lock(&pwm_lock);
+
+    ch = pwm_find(gpio);
+    if (claimed && !ch) {
+        ch = pwm_find(-1);
+        if (ch && pwm_start()) {
+            memset(ch, 0, sizeof(*ch));
+            ch->gpio = gpio;
+            active++;
+            pthread_cond_signal(&pwm_cond);
+            claimed = false;
+        } else {
+            ch = NULL;
+        }
+    }
+
+    if (ch) {
+        ch->frequency = frequency;
+        ch->duty = duty;
+        ch->period = NSEC_PER_SEC / frequency;
+        ch->high = ch->period * duty / PWM_DUTY_MAX;
+
+        /* A full or empty duty cycle has no edges */
+        if (duty == 0 || duty == PWM_DUTY_MAX) {
+            ch->next = 0;
+            gpio_set_state(gpio, duty ? GPIO_HIGH : GPIO_LOW);
+        } else {
+            ch->start = ch->next = pwm_now();
+            ch->level = true;
+        }
+
+        blackbox_record(BB_PWM, gpio, frequency, duty);
+    }
+
+    pthread_mutex_unlock(&pwm_lock);
+
+    /* An other request started the channel meanwhile or there was no room */
+    if (claimed) {
+        gpio_unclaim(gpio, "pwm");
+    }
+
+    return ch != NULL;
 }
 
-int pwm_test() {
-  struct sched_param prio_struct;
-  int ret;
-
-  /* set real time priority for better accuracy */
-  prio_struct.__sched_priority = 99;
-
-  ret = sched_setscheduler(0, SCHED_FIFO, &prio_struct);
-  if(ret) {
-    printf("\n*** Warning ***\n");
-    perror("Could not set real time priority");
-    printf("This may reduce timing benchmark accuracy. ");
-    printf("Try running as super user (sudo).\n\n");
-  }
-
-  gpioSetup();
-  printf("Set up gpio ports\r\n");
-  gpioDirection(23, 1);
-  printf("GPIO is set to output\r\n");
-  gpioSet(23,0);
-  printf("GPIO port 23 is low\r\n");
-
- /*
-  while(1==1) {
-    
-    for(int i = 0; i < 25; ++i) {
-        gpioSet(23, 1);
-        usleep(1000);
-        gpioSet(23, 0);
-        usleep(20000);
-    }
-    printf("Servo LEFT\r\n");
-    
-    for(int i = 0; i < 25; ++i) {
-        gpioSet(23, 1);
-        usleep(1500);
-        gpioSet(23, 0);
-        usleep(1500);
-    }
-    printf("Servo MIDDLE\r\n");
-    
-    for(int i = 0; i < 25; ++i) {
-        gpioSet(23, 1);
-        usleep(2000);
-        gpioSet(23, 0);
-        usleep(2000);
-    }
-    printf("Servo RIGHT\r\n");
-    
-  };
-*/
-  gpio_reserve(23);
-  gpio_set_direction(23, GPIO_OUT);
-  
-    while(1==1) {
-    
-    for(int i = 0; i < 200; ++i) {
-        gpio_set_state(23, GPIO_HIGH);
-        usleep(900);
-        gpio_set_state(23, GPIO_LOW);
-        usleep(20000);
-    }
-    printf("Servo LEFT\r\n");
-    
-    for(int i = 0; i < 200; ++i) {
-        gpio_set_state(23, GPIO_HIGH);
-        usleep(1400);
-        gpio_set_state(23, GPIO_LOW);
-        usleep(20000);
-    }
-    printf("Servo MIDDLE\r\n");
-    
-    sleep(2);
-    
-    for(int i = 0; i < 200; ++i) {
-        gpio_set_state(23, GPIO_HIGH);
-        usleep(2400);
-        gpio_set_state(23, GPIO_LOW);
-        usleep(20000);
-    }
-    printf("Servo RIGHT\r\n");
-    
-  };
-
-  return 0;
-};
+/**
+ * Stop a PWM channel, the port is driven low and released.
+ * @param gpio the GPIO port.
+ * @return true when the port had a PWM channel.
+ */
+bool pwm_stop(int gpio)
+{
+    struct pwm_channel *ch;
+
+    if (gpio < 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pwm_lock);
+
+    ch = pwm_find(gpio);
+    if (ch) {
+        blackbox_record(BB_PWM, gpio, 0, 0);
+        ch->gpio = -1;
+        active--;
+    }
+
+    pthread_mutex_unlock(&pwm_lock);
+
+    /* The engine no longer drives the port, release it without the lock */
+    if (ch) {
+        gpio_set_state(gpio, GPIO_LOW);
+        gpio_unclaim(gpio, "pwm");
+    }
+
+    return ch != NULL;
+}
+
+/**
+ * Get the settings and statistics of all running channels.
+ * @param info array of PWM_MAX_CHANNELS entries receiving the channels.
+ * @return the number of channels.
+ */
+int pwm_get_channels(struct pwm_channel_info *info)
+{
+    struct pwm_channel *ch;
+    int i, n = 0;
+
+    pthread_mutex_lock(&pwm_lock);
+
+    for (i = 0; i < PWM_MAX_CHANNELS; ++i) {
+        ch = &channels[i];
+        if (ch->gpio < 0) {
+            continue;
+        }
+
+        info[n].gpio = ch->gpio;
+        info[n].frequency = ch->frequency;
+        info[n].duty = ch->duty;
+        info[n].periods = ch->periods;
+        info[n].late = ch->late;
+        info[n].jitter_avg = ch->jitter_count ? ch->jitter_sum / ch->jitter_count : 0;
+        info[n].jitter_max = ch->jitter_max;
+        n++;
+    }
+
+    pthread_mutex_unlock(&pwm_lock);
+    return n;
+}
@@ -31,10 +31,69 @@
 #ifndef PWM_H
 #define	PWM_H
 
-#define GPIO_ADDR 0x18040000    // base address
-#define GPIO_BLOCK 48           // memory block size
+#include <stdbool.h>
+#include <stdint.h>
 
-int pwm_test();
+#define PWM_DUTY_MAX            1000            /* Duty cycle resolution, the duty is in per mille */
 
-#endif
+/*
+ * Software PWM engine. A single real-time thread drives all channels, it
+ * sleeps until the earliest edge of the schedule and writes every edge due
+ * at that time with one bulk GPIO write. Channels on ports listed in
+ * "gpio_mmio" are toggled through the SoC registers, the others through
+ * the configured GPIO backend.
+ */
+
+/**
+ * The settings and timing statistics of a PWM channel
+ */
+struct pwm_channel_info {
+    int gpio;                   /* The GPIO port */
+    unsigned int frequency;     /* The frequency in Hz */
+    unsigned int duty;          /* The duty cycle in per mille */
+    uint64_t periods;           /* Number of completed periods */
+    uint64_t late;              /* Number of edges missed by more than an edge */
+    uint32_t jitter_avg;        /* Average lateness of the edges in nanoseconds */
+    uint32_t jitter_max;        /* Maximum lateness of the edges in nanoseconds */
+};
+
+/**
+ * Initialize the PWM engine, this registers the jitter metric and must
+ * be called from the main thread. The engine thread is started when the
+ * first channel is set.
+ */
+void pwm_init(void);
+
+/**
+ * Get the highest PWM frequency of a port. Every edge on a sysfs or
+ * chardev port is a system call, only bit-banged ports go fast.
+ * @param gpio the GPIO port.
+ * @return the maximum frequency in Hz.
+ */
+unsigned int pwm_max_frequency(int gpio);
 
+/**
+ * Start a PWM channel or change its frequency and duty cycle. The port is
+ * claimed exclusively and configured as output when the channel is new.
+ * @param gpio the GPIO port.
+ * @param frequency the frequency in Hz, 1 to pwm_max_frequency.
+ * @param duty the duty cycle in per mille, 0 to PWM_DUTY_MAX.
+ * @return true on success.
+ */
+bool pwm_set(int gpio, unsigned int frequency, unsigned int duty);
+
+/**
+ * Stop a PWM channel, the port is driven low and released.
+ * @param gpio the GPIO port.
+ * @return true when the port had a PWM channel.
+ */
+bool pwm_stop(int gpio);
+
+/**
+ * Get the settings and statistics of all running channels.
+ * @param info array of PWM_MAX_CHANNELS entries receiving the channels.
+ * @return the number of channels.
+ */
+int pwm_get_channels(struct pwm_channel_info *info);
+
+#endif
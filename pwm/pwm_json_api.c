@@ -0,0 +1,186 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   pwm_json_api.c
+ * Created on October 18, 2026, 10:40 AM
+ */
+
+#include <stdio.h>
+#include <json-c/json.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../logger.h"
+#include "../helper.h"
+#include "../config.h"
+#include "../uhttpd.h"
+#include "pwm_json_api.h"
+#include "pwm.h"
+
+/**
+ * Route all get requests concerning the pwm module.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the result of the called function.
+ */
+json_object* pwm_get_router(struct client *cl, char *request) {
+    if (helper_str_startswith(request, "channels", 0))
+    {
+        return pwm_get_channels_json(cl, request + 9);
+    }
+    else
+    {
+        log_message(LOG_WARNING, "PWM API got unknown GET request '%s'\r\n", request);
+        return NULL;
+    }
+}
+
+/**
+ * Route all put requests concerning the pwm module.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the result of the called function.
+ */
+json_object* pwm_put_router(struct client *cl, char *request) {
+    if (helper_str_startswith(request, "channel", 0))
+    {
+        return pwm_put_channel(cl, request + 8);
+    }
+    else if (helper_str_startswith(request, "stop", 0))
+    {
+        return pwm_put_stop(cl, request + 5);
+    }
+    else
+    {
+        log_message(LOG_WARNING, "PWM API got unknown PUT request '%s'\r\n", request);
+        return NULL;
+    }
+}
+
+/**
+ * Get the running PWM channels and their jitter statistics. The jitter
+ * is the lateness of the edges in nanoseconds.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the channels.
+ */
+json_object* pwm_get_channels_json(struct client *cl, char *request) {
+    struct pwm_channel_info info[PWM_MAX_CHANNELS];
+    int i, n;
+
+    /* Create the json object */
+    json_object *jobj = json_object_new_object();
+    json_object *jarray = json_object_new_array();
+
+    n = pwm_get_channels(info);
+    for(i = 0; i < n; ++i) {
+        json_object *j_channel = json_object_new_object();
+
+        json_object_object_add(j_channel, "pin", json_object_new_int(info[i].gpio));
+        json_object_object_add(j_channel, "frequency", json_object_new_int(info[i].frequency));
+        json_object_object_add(j_channel, "duty", json_object_new_int(info[i].duty));
+        json_object_object_add(j_channel, "periods", json_object_new_int64(info[i].periods));
+        json_object_object_add(j_channel, "late", json_object_new_int64(info[i].late));
+        json_object_object_add(j_channel, "jitter-avg", json_object_new_int64(info[i].jitter_avg));
+        json_object_object_add(j_channel, "jitter-max", json_object_new_int64(info[i].jitter_max));
+
+        json_object_array_add(jarray, j_channel);
+    }
+
+    /* Add the array to the json object */
+    json_object_object_add(jobj, "channels", jarray);
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Start a PWM channel or change it.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the new channel settings.
+ */
+json_object* pwm_put_channel(struct client *cl, char *request)
+{
+    /* This functions expects the following request /<gpiopin>/<frequency>/<duty per mille> */
+    int gpio_pin;
+    unsigned int frequency;
+    unsigned int duty;
+
+    /* If sscanf fails the request is malformed */
+    if (sscanf(request, "%d/%u/%u", &gpio_pin, &frequency, &duty) != 3 ||
+        frequency == 0 || frequency > pwm_max_frequency(gpio_pin) || duty > PWM_DUTY_MAX) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    if (!pwm_set(gpio_pin, frequency, duty)) {
+        cl->http_status = r_error;
+        return NULL;
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "pin", json_object_new_int(gpio_pin));
+    json_object_object_add(jobj, "frequency", json_object_new_int(frequency));
+    json_object_object_add(jobj, "duty", json_object_new_int(duty));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
+
+/**
+ * Stop a PWM channel.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the stopped port.
+ */
+json_object* pwm_put_stop(struct client *cl, char *request)
+{
+    /* This functions expects the following request /<gpiopin> */
+    int gpio_pin;
+
+    /* If sscanf fails the request is malformed */
+    if (sscanf(request, "%d", &gpio_pin) != 1) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    if (!pwm_stop(gpio_pin)) {
+        cl->http_status = r_bad_req;
+        return NULL;
+    }
+
+    /* Put data in JSON object */
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "pin", json_object_new_int(gpio_pin));
+
+    /* Return status ok */
+    cl->http_status = r_ok;
+    return jobj;
+}
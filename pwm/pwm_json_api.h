@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   pwm_json_api.h
+ * Created on October 18, 2026, 10:40 AM
+ */
+
+#ifndef PWM_JSON_API_H
+#define	PWM_JSON_API_H
+
+#include <json-c/json.h>
+#include "../uhttpd.h"
+
+/**
+ * Route all get requests concerning the pwm module.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the result of the called function.
+ */
+json_object* pwm_get_router(struct client *cl, char *request);
+
+/**
+ * Route all put requests concerning the pwm module.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the result of the called function.
+ */
+json_object* pwm_put_router(struct client *cl, char *request);
+
+/**
+ * Get the running PWM channels and their jitter statistics.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the channels.
+ */
+json_object* pwm_get_channels_json(struct client *cl, char *request);
+
+/**
+ * Start a PWM channel or change it.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the new channel settings.
+ */
+json_object* pwm_put_channel(struct client *cl, char *request);
+
+/**
+ * Stop a PWM channel.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return the stopped port.
+ */
+json_object* pwm_put_stop(struct client *cl, char *request);
+
+#endif
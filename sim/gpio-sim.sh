@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Create or remove a gpio-sim chip with the 28 GPIO lines of the board to
+# run the chardev GPIO backend without hardware. Needs root, configfs and
+# a kernel with CONFIG_GPIO_SIM. Put the printed chip in the configuration
+# as "gpio_chip" together with "gpio_backend": "chardev".
+#
+# Input levels are driven through the pull attribute of a line, e.g.
+#   echo pull-up > /sys/devices/platform/<device>/<chip>/sim_gpio7/pull
+#
+# Usage: gpio-sim.sh up|down
+
+SIM=/sys/kernel/config/gpio-sim/dpt-breakout
+
+case "$1" in
+    up)
+        modprobe gpio-sim || exit 1
+        mkdir -p "$SIM/bank0" || exit 1
+        echo 28 > "$SIM/bank0/num_lines"
+        echo 1 > "$SIM/live" || exit 1
+        echo "gpio_chip: /dev/$(cat "$SIM/bank0/chip_name")"
+        echo "device: /sys/devices/platform/$(cat "$SIM/dev_name")"
+        ;;
+    down)
+        echo 0 > "$SIM/live"
+        rmdir "$SIM/bank0" "$SIM"
+        ;;
+    *)
+        echo "Usage: $0 up|down" >&2
+        exit 1
+        ;;
+esac
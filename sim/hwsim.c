@@ -0,0 +1,533 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   hwsim.c
+ * Created on October 18, 2026, 10:15 AM
+ */
+
+/*
+ * Hardware simulator for the breakout server. It builds a fake sysfs and
+ * /dev tree below a root directory, the server uses it when "hardware_root"
+ * in its configuration points to the same directory:
+ *
+ *     <root>/sys/class/gpio/{export,unexport}
+ *     <root>/sys/class/gpio/gpioN/{direction,value,edge}
+ *     <root>/sys/devices/w1_bus_master1/28-000003ea41b5/w1_slave
+ *     <root>/dev/i2c-N, <root>/dev/spidev0.1
+ *     <root>/dev/mem
+ *
+ * All GPIO ports are permanently exported so the server never races the
+ * simulator after writing to export. Writes of the server are picked up
+ * with inotify, normalised the way sysfs would show them and logged. The
+ * w1 slave file follows a slowly drifting temperature and input ports can
+ * be toggled at random to emulate button presses.
+ *
+ * The I2C and SPI devices are FIFOs: the server opens them read/write and
+ * reads back what it wrote, as if MOSI was wired to MISO. The bus ioctls
+ * are emulated by the server itself when it runs against a hardware root.
+ *
+ * The memory device is a sparse file holding the GPIO block of an AR9331 at
+ * its physical address. Writes to the set and clear registers are folded
+ * into the output register and outputs are mirrored on the input register.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+
+#include "../config.h"
+#include "../combus/i2c.h"
+#include "../gpio/gpio_mmio.h"
+
+#define SIM_GPIO_COUNT      28          /* Number of simulated GPIO ports */
+#define SIM_W1_SLAVE        "/sys/devices/w1_bus_master1/28-000003ea41b5/w1_slave"
+#define SIM_TICK            1000        /* Temperature update interval in milliseconds */
+#define SIM_MMIO_POLL       10          /* GPIO register update interval in milliseconds */
+
+/** The simulated hardware root */
+static const char *root;
+
+/** Inotify watch descriptor of every GPIO port directory */
+static int gpio_wd[SIM_GPIO_COUNT];
+
+/** Last known direction ('i' or 'o') and value ('0' or '1') of every port */
+static char gpio_dir[SIM_GPIO_COUNT], gpio_val[SIM_GPIO_COUNT];
+
+/** Watch descriptor of the export and unexport files */
+static int export_wd, unexport_wd;
+
+/** The simulated GPIO registers, mapped from the memory device */
+static volatile uint32_t *mmio_regs;
+
+/** Cleared by the signal handler to stop the simulator */
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Build a path below the simulated root. 
+ * @param buf buffer of PATH_MAX bytes. 
+ * @param fmt printf style format of the path on real hardware. 
+ * @return the buffer. 
+ */
+static char* sim_path(char *buf, const char *fmt, ...)
+{
+    va_list args;
+    int len = snprintf(buf, PATH_MAX, "%s", root);
+
+    va_start(args, fmt);
+    vsnprintf(buf + len, PATH_MAX - len, fmt, args);
+    va_end(args);
+
+    return buf;
+}
+
+/**
+ * Create a directory and all its parents. 
+ * @param path the directory to create. 
+ * @return true on success. 
+ */
+static bool sim_mkdirs(const char *path)
+{
+    char buf[PATH_MAX];
+    char *p;
+
+    snprintf(buf, sizeof(buf), "%s", path);
+    for(p = buf + 1; *p; ++p) {
+        if(*p == '/') {
+            *p = '\0';
+            if(mkdir(buf, 0755) < 0 && errno != EEXIST) {
+                return false;
+            }
+            *p = '/';
+        }
+    }
+
+    return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * Replace the contents of a file. 
+ * @param path the file to write. 
+ * @param data the new contents. 
+ * @return true on success. 
+ */
+static bool sim_write_file(const char *path, const char *data)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    size_t len = strlen(data);
+    bool ok;
+
+    if(fd < 0) {
+        return false;
+    }
+
+    ok = write(fd, data, len) == (ssize_t) len;
+    close(fd);
+
+    return ok;
+}
+
+/**
+ * Read the start of a file. 
+ * @param path the file to read. 
+ * @param buf the buffer to read into. 
+ * @param len the size of the buffer. 
+ * @return the number of bytes read or -1 on error. 
+ */
+static int sim_read_file(const char *path, char *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY);
+    int r;
+
+    if(fd < 0) {
+        return -1;
+    }
+
+    r = read(fd, buf, len - 1);
+    close(fd);
+    buf[r < 0 ? 0 : r] = '\0';
+
+    return r;
+}
+
+/**
+ * Create a FIFO device node. 
+ * @param path the node to create. 
+ * @return true on success. 
+ */
+static bool sim_mkfifo(const char *path)
+{
+    struct stat st;
+
+    if(stat(path, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        return true;
+    }
+
+    unlink(path);
+    return mkfifo(path, 0666) == 0;
+}
+
+/**
+ * Write the w1 slave file for a given temperature. The layout matches the
+ * w1_therm driver, the server reads the value at a fixed offset. 
+ * @param millideg the temperature in thousandths of a degree celcius. 
+ */
+static void sim_w1_update(int millideg)
+{
+    char path[PATH_MAX];
+    char data[128];
+
+    snprintf(data, sizeof(data),
+            "72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n"
+            "72 01 4b 46 7f ff 0e 10 57 t=%05d\n", millideg);
+    sim_write_file(sim_path(path, SIM_W1_SLAVE), data);
+}
+
+/**
+ * Create the memory device holding the GPIO registers. The file is sparse,
+ * only the page of the GPIO block takes up space. 
+ * @return true on success. 
+ */
+static bool sim_mmio_create(void)
+{
+    char path[PATH_MAX];
+    long page = sysconf(_SC_PAGESIZE);
+    off_t base = GPIO_MMIO_BASE & ~(page - 1);
+    void *map;
+    int fd;
+
+    fd = open(sim_path(path, "/dev/mem"), O_RDWR | O_CREAT, 0666);
+    if(fd < 0 || ftruncate(fd, base + page) < 0) {
+        fprintf(stderr, "hwsim: could not create %s: %s\n", path, strerror(errno));
+        if(fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    map = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+    close(fd);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "hwsim: could not map %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    mmio_regs = (volatile uint32_t*) ((char*) map + (GPIO_MMIO_BASE & (page - 1)));
+    memset((void*) mmio_regs, 0, GPIO_MMIO_REGS * sizeof(uint32_t));
+    return true;
+}
+
+/**
+ * Fold the writes to the set and clear registers into the output register
+ * and mirror the outputs on the input register. An output enable bit set
+ * to one makes the port an output, as on the AR9331. 
+ */
+static void sim_mmio_update(void)
+{
+    uint32_t set = __atomic_exchange_n(&mmio_regs[GPIO_MMIO_SET], 0, __ATOMIC_SEQ_CST);
+    uint32_t clear = __atomic_exchange_n(&mmio_regs[GPIO_MMIO_CLEAR], 0, __ATOMIC_SEQ_CST);
+    uint32_t oe = mmio_regs[GPIO_MMIO_OE];
+    uint32_t out = mmio_regs[GPIO_MMIO_OUT];
+    uint32_t now = (out | set) & ~clear;
+
+    if(now != out) {
+        mmio_regs[GPIO_MMIO_OUT] = now;
+    }
+    mmio_regs[GPIO_MMIO_IN] = (mmio_regs[GPIO_MMIO_IN] & ~oe) | (now & oe);
+}
+
+/**
+ * Build the simulated sysfs and /dev tree. 
+ * @return true on success. 
+ */
+static bool sim_build_tree(int inotify_fd)
+{
+    char path[PATH_MAX];
+    int i;
+
+    if(!sim_mkdirs(sim_path(path, "/sys/class/gpio")) ||
+       !sim_mkdirs(sim_path(path, "/sys/devices/w1_bus_master1/28-000003ea41b5")) ||
+       !sim_mkdirs(sim_path(path, "/dev"))) {
+        fprintf(stderr, "hwsim: could not create the tree below %s: %s\n", root, strerror(errno));
+        return false;
+    }
+
+    sim_write_file(sim_path(path, "/sys/class/gpio/export"), "");
+    export_wd = inotify_add_watch(inotify_fd, path, IN_CLOSE_WRITE);
+    sim_write_file(sim_path(path, "/sys/class/gpio/unexport"), "");
+    unexport_wd = inotify_add_watch(inotify_fd, path, IN_CLOSE_WRITE);
+
+    for(i = 0; i < SIM_GPIO_COUNT; ++i) {
+        sim_mkdirs(sim_path(path, "/sys/class/gpio/gpio%d", i));
+        gpio_wd[i] = inotify_add_watch(inotify_fd, path, IN_CLOSE_WRITE | IN_MODIFY);
+        sim_write_file(sim_path(path, "/sys/class/gpio/gpio%d/direction", i), "in\n");
+        sim_write_file(sim_path(path, "/sys/class/gpio/gpio%d/value", i), "0\n");
+        sim_write_file(sim_path(path, "/sys/class/gpio/gpio%d/edge", i), "none\n");
+        gpio_dir[i] = 'i';
+        gpio_val[i] = '0';
+    }
+
+    sim_w1_update(21500);
+
+    for(i = 0; i < I2C_MAX_BUSES; ++i) {
+        if(!sim_mkfifo(sim_path(path, "/dev/i2c-%d", i))) {
+            fprintf(stderr, "hwsim: could not create %s: %s\n", path, strerror(errno));
+            return false;
+        }
+    }
+
+    if(!sim_mkfifo(sim_path(path, SPI_DEVICE))) {
+        fprintf(stderr, "hwsim: could not create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    return sim_mmio_create();
+}
+
+/**
+ * Handle a write of the server to a GPIO port file. The file is rewritten
+ * the way sysfs would present it, the server writes without truncating
+ * and keeps the files open so writes are seen as modifications. 
+ * @param gpio the GPIO port. 
+ * @param name the file that was written. 
+ */
+static void sim_gpio_written(int gpio, const char *name)
+{
+    char path[PATH_MAX];
+    char buf[16];
+    const char *normal;
+    char *state;
+    char now;
+
+    sim_path(path, "/sys/class/gpio/gpio%d/%s", gpio, name);
+    if(sim_read_file(path, buf, sizeof(buf)) <= 0) {
+        return;
+    }
+
+    if(strcmp(name, "direction") == 0) {
+        state = &gpio_dir[gpio];
+        now = buf[0] == 'o' ? 'o' : 'i';
+        normal = now == 'o' ? "out\n" : "in\n";
+    } else if(strcmp(name, "value") == 0) {
+        state = &gpio_val[gpio];
+        now = buf[0] == '1' ? '1' : '0';
+        normal = now == '1' ? "1\n" : "0\n";
+    } else {
+        return;
+    }
+
+    /* Our own rewrites trigger events too, those leave the contents normal */
+    if(strcmp(buf, normal) != 0) {
+        sim_write_file(path, normal);
+    }
+
+    if(*state != now) {
+        *state = now;
+        printf("gpio%d %s %s", gpio, name, normal);
+        fflush(stdout);
+    }
+}
+
+/**
+ * Handle a write of the server to the export or unexport file. 
+ * @param name export or unexport. 
+ */
+static void sim_export_written(const char *name)
+{
+    char path[PATH_MAX];
+    char buf[16];
+
+    sim_path(path, "/sys/class/gpio/%s", name);
+    if(sim_read_file(path, buf, sizeof(buf)) > 0) {
+        printf("%s %d\n", name, atoi(buf));
+        fflush(stdout);
+        sim_write_file(path, "");
+    }
+}
+
+/**
+ * Process pending inotify events. 
+ * @param inotify_fd the inotify instance. 
+ */
+static void sim_handle_events(int inotify_fd)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t len;
+    char *p;
+    int i;
+
+    len = read(inotify_fd, buf, sizeof(buf));
+    for(p = buf; len > 0 && p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+        ev = (const struct inotify_event*) p;
+
+        if(ev->wd == export_wd) {
+            sim_export_written("export");
+        } else if(ev->wd == unexport_wd) {
+            sim_export_written("unexport");
+        } else if(ev->len > 0) {
+            for(i = 0; i < SIM_GPIO_COUNT; ++i) {
+                if(gpio_wd[i] == ev->wd) {
+                    sim_gpio_written(i, ev->name);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Flip the value of a random GPIO port configured as input. 
+ */
+static void sim_toggle_input(void)
+{
+    char path[PATH_MAX];
+    int gpio = rand() % SIM_GPIO_COUNT;
+
+    if(gpio_dir[gpio] != 'i') {
+        return;
+    }
+
+    /* Update the known value first so the resulting event is not logged */
+    gpio_val[gpio] = gpio_val[gpio] == '1' ? '0' : '1';
+    sim_write_file(sim_path(path, "/sys/class/gpio/gpio%d/value", gpio), gpio_val[gpio] == '1' ? "1\n" : "0\n");
+}
+
+/**
+ * Get a monotonic timestamp. 
+ * @return the time in milliseconds. 
+ */
+static long long sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Stop the simulator on SIGINT and SIGTERM. 
+ */
+static void sim_stop(int sig)
+{
+    running = 0;
+}
+
+/**
+ * Print the usage of the simulator.
+ * @param name the program name.
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t toggle interval ms] <hardware root>\n", name);
+}
+
+/**
+ * Hardware simulator entry point. 
+ */
+int main(int argc, char **argv)
+{
+    struct pollfd pfd;
+    long long next_tick, next_toggle, now;
+    int toggle = 0;
+    int ticks = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:")) != -1) {
+        switch(opt) {
+            case 't': toggle = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    root = argv[optind];
+
+    pfd.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    pfd.events = POLLIN;
+    if(pfd.fd < 0 || !sim_build_tree(pfd.fd)) {
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, sim_stop);
+    signal(SIGTERM, sim_stop);
+    printf("hwsim: simulating hardware below %s\n", root);
+    fflush(stdout);
+
+    next_tick = next_toggle = sim_now();
+    while(running) {
+        now = sim_now();
+
+        if(now >= next_tick) {
+            /* Drift between 19 and 24 degrees with a period of ten minutes */
+            sim_w1_update(21500 + (int) (2500 * sin(ticks++ * 2 * M_PI / 600)));
+            next_tick += SIM_TICK;
+        }
+
+        if(toggle > 0 && now >= next_toggle) {
+            sim_toggle_input();
+            next_toggle += toggle;
+        }
+
+        sim_mmio_update();
+
+        now = sim_now();
+        if(toggle > 0 && next_toggle < next_tick) {
+            now = next_toggle - now;
+        } else {
+            now = next_tick - now;
+        }
+        if(now > SIM_MMIO_POLL) {
+            now = SIM_MMIO_POLL;
+        }
+
+        if(poll(&pfd, 1, now > 0 ? (int) now : 0) > 0) {
+            sim_handle_events(pfd.fd);
+        }
+    }
+
+    close(pfd.fd);
+    return EXIT_SUCCESS;
+}
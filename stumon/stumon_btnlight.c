@@ -29,11 +29,14 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "stumon_btnlight.h"
 #include "../gpio/gpio.h"
+#include "../gpio/gpio_debounce.h"
+#include "../config.h"
 #include "../logger.h"
-#include "../longrunner.h"
+#include "../events/events.h"
 
 /**
  * @brief True when the WiFi light is on.
@@ -56,6 +59,45 @@ int _status_score_last = GPIO_LOW;
  */
 int last_score = 1;
 
+/**
+ * @brief The buttons watched by the longrunner, the score buttons first.
+ */
+static const int buttons[7] = { BTN1, BTN2, BTN3, BTN4, BTN5, BTN_WIFI, BTN_SCORE };
+
+/**
+ * @brief The last read state of every watched button.
+ */
+static int button_states[7] = { GPIO_LOW, GPIO_LOW, GPIO_LOW, GPIO_LOW, GPIO_LOW, GPIO_LOW, GPIO_LOW };
+
+/**
+ * @brief Publish a button state change.
+ * 
+ * @param pin The GPIO pin of the button.
+ * @param state The new state of the button.
+ * 
+ * @return None.
+ */
+static void _stumon_publish_button(int pin, int state)
+{
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "pin", json_object_new_int(pin));
+    json_object_object_add(jobj, "state", json_object_new_int(state));
+    events_publish(EVENT_TOPIC_GPIO, jobj);
+}
+
+/**
+ * @brief Publish the current score selection.
+ * 
+ * @return None.
+ */
+static void _stumon_publish_score(void)
+{
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "score", json_object_new_int(last_score));
+    json_object_object_add(jobj, "score_mode", json_object_new_boolean(status_score));
+    events_publish(EVENT_TOPIC_STUMON, jobj);
+}
+
 /**
  * @brief Set the WiFi status light.
  * 
@@ -185,21 +227,13 @@ void light_status_blink()
  */
 void setup_button_inputs()
 {
-    gpio_release(BTN1);
-    gpio_release(BTN2);
-    gpio_release(BTN3);
-    gpio_release(BTN4);
-    gpio_release(BTN5);
-    gpio_release(BTN_WIFI);
-    gpio_release(BTN_SCORE);
-    
-    gpio_reserve(BTN1);
-    gpio_reserve(BTN2);
-    gpio_reserve(BTN3);
-    gpio_reserve(BTN4);
-    gpio_reserve(BTN5);
-    gpio_reserve(BTN_WIFI);
-    gpio_reserve(BTN_SCORE);
+    gpio_claim(BTN1, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN2, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN3, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN4, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN5, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN_WIFI, "stumon", GPIO_EXCLUSIVE);
+    gpio_claim(BTN_SCORE, "stumon", GPIO_EXCLUSIVE);
     
     gpio_set_direction(BTN1, GPIO_IN);
     gpio_set_direction(BTN2, GPIO_IN);
@@ -211,52 +245,95 @@ void setup_button_inputs()
 }
 
 /**
- * @brief Initialize the btn_light longrunner.
+ * @brief Update the score after a button change.
  * 
- * This function initializes the buttons and lights and adds their control
- * loop to the program.
+ * This function selects the score of the first pressed score button and
+ * toggles the score mode on a press of the score button.
  * 
  * @return None.
  */
-void stumon_btnlight_longrunner_init(void)
+static void _stumon_update_score(void)
 {
-    setup_button_inputs();
+    int i;
+    int score = last_score;
     
-    /* Add the stumon button and light longrunner entrypoint */
-    longrunner_add(stumon_btnlight_longrunner_entrypoint, 50);
-    log_message(LOG_INFO, "StuMON button and light longrunner initialised\r\n");
+    /* Save the score */
+    for(i = 0; i < 5; ++i) {
+        if(button_states[i] == GPIO_HIGH) {
+            score = i + 1;
+            break;
+        }
+    }
+    
+    if(score != last_score) {
+        last_score = score;
+        _stumon_publish_score();
+    }
+    
+    if(button_states[6] == GPIO_HIGH) {
+        if(_status_score_last == GPIO_LOW) {
+            status_score = !status_score;
+            set_light_score(status_score);
+            _stumon_publish_score();
+        }
+        _status_score_last = GPIO_HIGH;
+    } else {
+        _status_score_last = GPIO_LOW;
+    }
 }
 
 /**
- * @brief The button and lights longrunner entrypoint.
+ * @brief Handle a button event.
+ * 
+ * This function is called from the event loop when a debounced button is
+ * pressed or released, it publishes the change and updates the score.
  * 
- * This function processes buttons presses and switches lights on and off
- * based on the boolean statuses.
+ * @param gpio The GPIO pin of the button.
+ * @param event The button event.
+ * @param timestamp The time of the event in nanoseconds.
+ * @param ctx The index of the button.
  * 
  * @return None.
  */
-void stumon_btnlight_longrunner_entrypoint(void)
+static void _stumon_button_event(int gpio, int event, uint64_t timestamp, void *ctx)
 {
-    /* Save the score */
-    if(gpio_get_state(BTN1) == GPIO_HIGH) {
-        last_score = 1;
-    } else if (gpio_get_state(BTN2) == GPIO_HIGH) {
-        last_score = 2;
-    } else if (gpio_get_state(BTN3) == GPIO_HIGH) {
-        last_score = 3;
-    } else if (gpio_get_state(BTN4) == GPIO_HIGH) {
-        last_score = 4;
-    } else if (gpio_get_state(BTN5) == GPIO_HIGH) {
-        last_score = 5;
+    int i = (int) (intptr_t) ctx;
+    
+    /* Long and double presses are only published by the debouncer */
+    if(event != GPIO_BUTTON_PRESS && event != GPIO_BUTTON_RELEASE) {
+        return;
     }
     
-    if(gpio_get_state(BTN_SCORE) == GPIO_HIGH) {
-        if(_status_score_last == GPIO_LOW) {
-            status_score = !status_score;
-            set_light_score(status_score);
+    button_states[i] = event == GPIO_BUTTON_PRESS ? GPIO_HIGH : GPIO_LOW;
+    _stumon_publish_button(gpio, button_states[i]);
+    _stumon_update_score();
+}
+
+/**
+ * @brief Initialize the buttons and lights.
+ * 
+ * This function initializes the buttons and debounces them, the presses
+ * and releases are handled from the event loop.
+ * 
+ * @return None.
+ */
+void stumon_btnlight_longrunner_init(void)
+{
+    int i, state;
+    
+    setup_button_inputs();
+    
+    for(i = 0; i < 7; ++i) {
+        state = gpio_get_state(buttons[i]);
+        if(state != GPIO_ERR) {
+            button_states[i] = state;
+        }
+        
+        if(!gpio_debounce(buttons[i], STUMON_DEBOUNCE_MS, GPIO_DEBOUNCE_WINDOW, false,
+                _stumon_button_event, (void*) (intptr_t) i)) {
+            log_message(LOG_ERROR, "Could not watch StuMON button on GPIO %d\r\n", buttons[i]);
         }
-        _status_score_last = GPIO_HIGH;
-    } else {
-        _status_score_last = GPIO_LOW;
     }
-}
\ No newline at end of file
+    
+    log_message(LOG_INFO, "StuMON buttons and lights initialised\r\n");
+}
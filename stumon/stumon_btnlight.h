@@ -48,7 +48,5 @@ void setup_button_inputs();
 
 void stumon_btnlight_longrunner_init(void);
 
-void stumon_btnlight_longrunner_entrypoint(void);
-
 #endif
 
@@ -40,6 +40,7 @@
 #include "../logger.h"
 #include "../config.h"
 #include "../rfid/pn532/rfid_pn532.h"
+#include "../events/events.h"
 #include "stumon_longrunner.h"
 #include "stumon_btnlight.h"
 
@@ -232,6 +233,13 @@ void stumon_longrunner_entrypoint(void)
             log_message(LOG_INFO, "NFC-tag found with UID: %s\r\n", uidstrbuf);
             light_status_blink();
             
+            /* Let event stream listeners know about the tag */
+            json_object *j_event = json_object_new_object();
+            json_object_object_add(j_event, "uid", json_object_new_string(uidstrbuf));
+            json_object_object_add(j_event, "score_mode", json_object_new_boolean(get_status_score()));
+            json_object_object_add(j_event, "score", json_object_new_int(get_latest_score()));
+            events_publish(EVENT_TOPIC_RFID, j_event);
+            
             if(get_status_score()) {
                 /* Post the tag and score */
                 _stumon_longrunner_post_score(uidstrbuf, get_latest_score());
@@ -33,8 +33,10 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include "../logger.h"
+#include "../helper.h"
 #include "tempsensor.h"
 
 /**
@@ -48,9 +50,13 @@ float tempsensor_current_temp(int sensor)
     char buf[80];       /* Write buffer */
     int raw;            /* Temperature in RAW form */
     float temp;         /* Temperature in degrees celcius */
+    char path[PATH_MAX]; /* Path to the w1 slave file */
 
     /* Try to open GPIO port */
-    fd = open("/sys/devices/w1_bus_master1/28-000003ea41b5/w1_slave", O_RDONLY);
+    if(!helper_hw_path(path, sizeof(path), "/sys/devices/w1_bus_master1/28-000003ea41b5/w1_slave")) {
+        return -1;
+    }
+    fd = open(path, O_RDONLY);
     if(fd < 0) {
         /* The file could not be opened */
         return -1;
@@ -0,0 +1,191 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   timerwheel.c
+ * Created on October 18, 2026, 11:40 AM
+ */
+
+#include <time.h>
+
+#include <libubox/uloop.h>
+
+#include "timerwheel.h"
+
+/**
+ * The hashed timer wheel. Timers are placed in the slot of the tick on
+ * which they expire, one uloop timeout drives the wheel while timers are
+ * armed.
+ */
+static struct {
+    struct list_head slots[TW_SLOTS];   /* Timers per tick */
+    struct uloop_timeout ticker;        /* Event loop timer driving the wheel */
+    uint64_t cur_tick;                  /* The last processed tick */
+    int count;                          /* The number of armed timers */
+    bool initialized;                   /* True when the slots are set up */
+} wheel;
+
+/**
+ * Get the current monotonic time in milliseconds.
+ * @return the monotonic time in milliseconds.
+ */
+uint64_t tw_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Place a timer in the slot of the tick it expires on. Deadlines beyond
+ * the wheel span go into the furthest slot and are moved again later.
+ * @param t the timer to place.
+ */
+static void tw_insert(struct tw_timer *t)
+{
+    uint64_t tick = (t->deadline + TW_TICK_MS - 1) / TW_TICK_MS;
+
+    if (tick <= wheel.cur_tick)
+        tick = wheel.cur_tick + 1;
+    else if (tick > wheel.cur_tick + TW_SLOTS)
+        tick = wheel.cur_tick + TW_SLOTS;
+
+    t->slot_tick = tick;
+    list_add_tail(&t->list, &wheel.slots[tick % TW_SLOTS]);
+}
+
+/**
+ * Expire all timers in the slot of a tick and move timers that were
+ * pushed back since they were placed.
+ * @param tick the tick to process.
+ * @param now the current monotonic time.
+ */
+static void tw_process_slot(uint64_t tick, uint64_t now)
+{
+    struct list_head *slot = &wheel.slots[tick % TW_SLOTS];
+    struct list_head expired;
+    struct tw_timer *t;
+
+    /* Detach the slot, callbacks may arm or cancel other timers */
+    if (list_empty(slot))
+        return;
+
+    expired = *slot;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    INIT_LIST_HEAD(slot);
+
+    while (!list_empty(&expired)) {
+        t = list_first_entry(&expired, struct tw_timer, list);
+        list_del(&t->list);
+
+        /* The deadline was moved, place the timer again */
+        if (t->deadline > now) {
+            tw_insert(t);
+            continue;
+        }
+
+        t->pending = false;
+        wheel.count--;
+        if (t->cb)
+            t->cb(t);
+    }
+}
+
+/**
+ * Advance the wheel up to the current time.
+ * @param timeout the ticker of the wheel.
+ */
+static void tw_tick(struct uloop_timeout *timeout)
+{
+    uint64_t now = tw_now();
+    uint64_t target = now / TW_TICK_MS;
+
+    /* Every slot is visited at most once when the loop was stalled */
+    if (target > wheel.cur_tick + TW_SLOTS)
+        wheel.cur_tick = target - TW_SLOTS;
+
+    while (wheel.cur_tick < target)
+        tw_process_slot(++wheel.cur_tick, now);
+
+    /* Only keep ticking while there are timers */
+    if (wheel.count)
+        uloop_timeout_set(timeout, TW_TICK_MS - now % TW_TICK_MS);
+}
+
+/**
+ * Arm or re-arm a timer. Pushing an armed timer further into the future
+ * only stores the new deadline, the timer is moved when its slot fires.
+ * @param t the timer to arm.
+ * @param msecs the number of milliseconds from now.
+ */
+void tw_timer_set(struct tw_timer *t, int msecs)
+{
+    uint64_t now = tw_now();
+    int i;
+
+    t->deadline = now + msecs;
+
+    /* Lazy re-arm, the slot fires before the new deadline */
+    if (t->pending && t->slot_tick * TW_TICK_MS <= t->deadline)
+        return;
+
+    if (!wheel.initialized) {
+        for (i = 0; i < TW_SLOTS; ++i)
+            INIT_LIST_HEAD(&wheel.slots[i]);
+        wheel.ticker.cb = tw_tick;
+        wheel.initialized = true;
+    }
+
+    if (t->pending) {
+        list_del(&t->list);
+    } else {
+        /* Start the wheel at the current tick when it was idle */
+        if (!wheel.count++) {
+            wheel.cur_tick = now / TW_TICK_MS;
+            uloop_timeout_set(&wheel.ticker, TW_TICK_MS - now % TW_TICK_MS);
+        }
+        t->pending = true;
+    }
+
+    tw_insert(t);
+}
+
+/**
+ * Disarm a timer.
+ * @param t the timer to disarm.
+ */
+void tw_timer_cancel(struct tw_timer *t)
+{
+    if (!t->pending)
+        return;
+
+    list_del(&t->list);
+    t->pending = false;
+
+    if (!--wheel.count)
+        uloop_timeout_cancel(&wheel.ticker);
+}
@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   timerwheel.h
+ * Created on October 18, 2026, 11:40 AM
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libubox/list.h>
+
+#define TW_TICK_MS              250     /* Resolution of the timer wheel */
+#define TW_SLOTS                256     /* Number of slots, one tick each */
+
+struct tw_timer;
+
+typedef void (*tw_timer_handler)(struct tw_timer *t);
+
+/**
+ * A timer managed by the timer wheel
+ */
+struct tw_timer {
+    struct list_head list;      /* The wheel slot this timer is placed in */
+    tw_timer_handler cb;        /* The function to call on expiry */
+    uint64_t deadline;          /* Monotonic expiry time in milliseconds */
+    uint64_t slot_tick;         /* The tick at which the slot is processed */
+    bool pending;               /* True when the timer is armed */
+};
+
+/**
+ * Arm or re-arm a timer. Pushing an armed timer further into the future
+ * only stores the new deadline, the timer is moved when its slot fires.
+ * @param t the timer to arm.
+ * @param msecs the number of milliseconds from now.
+ */
+void tw_timer_set(struct tw_timer *t, int msecs);
+
+/**
+ * Disarm a timer.
+ * @param t the timer to disarm.
+ */
+void tw_timer_cancel(struct tw_timer *t);
+
+/**
+ * Get the current monotonic time in milliseconds.
+ * @return the monotonic time in milliseconds.
+ */
+uint64_t tw_now(void);
+
+#endif
@@ -0,0 +1,188 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   trace.c
+ * Created on October 18, 2026, 2:10 PM
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libubox/blobmsg.h>
+
+#include "uhttpd.h"
+#include "trace.h"
+
+/**
+ * A finished request in the trace ring
+ */
+struct trace_record {
+    unsigned long seq;                          /* Sequence number, 0 for an empty slot */
+    int client;                                 /* The client id */
+    int method;                                 /* The HTTP method */
+    char url[TRACE_URL_LEN];                    /* The (truncated) request url */
+    struct client_trace ts;                     /* The lifecycle timestamps */
+};
+
+/** The trace ring, only used from the main loop */
+static struct trace_record ring[TRACE_RING_SIZE];
+
+/** Sequence number of the last record */
+static unsigned long ring_seq;
+
+/**
+ * Get the duration between two lifecycle points. 
+ * @param from the first point. 
+ * @param to the second point. 
+ * @return the duration in microseconds, -1 when a point was not reached. 
+ */
+static long trace_duration(uint64_t from, uint64_t to)
+{
+    return from && to && to >= from ? (long) (to - from) : -1;
+}
+
+/**
+ * Record a finished request in the trace ring. When the response is still
+ * queued on the stream the record is completed by trace_flushed().
+ * @param cl the client who made the request. 
+ */
+void trace_request_done(struct client *cl)
+{
+    struct trace_record *rec;
+    const char *url;
+
+    if (!conf->tracing || !cl->trace.request)
+        return;
+
+    /* A previous response that is still queued is taken as flushed */
+    trace_flushed(cl);
+
+    rec = &ring[++ring_seq % TRACE_RING_SIZE];
+    rec->seq = ring_seq;
+    rec->client = cl->id;
+    rec->method = cl->request.method;
+    rec->ts = cl->trace;
+
+    url = cl->hdr.head ? blobmsg_data(blob_data(cl->hdr.head)) : "";
+    snprintf(rec->url, sizeof(rec->url), "%s", url);
+
+    if (cl->us && ustream_pending_data(cl->us, true)) {
+        cl->trace_seq = ring_seq;
+    } else {
+        rec->ts.flushed = metrics_now();
+        cl->trace_seq = 0;
+    }
+
+    /* The connection stays, the next request starts from scratch */
+    memset(&cl->trace, 0, sizeof(cl->trace));
+    cl->trace.accept = rec->ts.accept;
+}
+
+/**
+ * Complete the trace record of a client once its stream is drained. 
+ * @param cl the client whose stream was written. 
+ */
+void trace_flushed(struct client *cl)
+{
+    struct trace_record *rec;
+
+    if (!cl->trace_seq)
+        return;
+
+    /* The record may have been overwritten in the mean time */
+    rec = &ring[cl->trace_seq % TRACE_RING_SIZE];
+    if (rec->seq == cl->trace_seq)
+        rec->ts.flushed = metrics_now();
+
+    cl->trace_seq = 0;
+}
+
+/**
+ * Format the Server-Timing header of the current request. 
+ * @param cl the client to write the response to. 
+ * @param buf the buffer to place the header line in. 
+ * @param len the size of the buffer. 
+ * @return the number of characters placed in the buffer. 
+ */
+int trace_server_timing(struct client *cl, char *buf, int len)
+{
+    struct client_trace *t = &cl->trace;
+    int n;
+
+    if (!conf->tracing || !t->request || len <= 0)
+        return 0;
+
+    n = snprintf(buf, len, "Server-Timing: parse;dur=%.3f, body;dur=%.3f, handler;dur=%.3f, total;dur=%.3f\r\n",
+            trace_duration(t->request, t->headers) / 1000.0,
+            trace_duration(t->headers, t->handler_start) / 1000.0,
+            trace_duration(t->handler_start, t->handler_end) / 1000.0,
+            trace_duration(t->request, t->handler_end) / 1000.0);
+
+    /* Leave out a truncated header */
+    return n < len ? n : 0;
+}
+
+/**
+ * Dump the trace ring, oldest record first. 
+ * @param cl the client who made the request. 
+ * @param request the request part of the url. 
+ * @return the trace records. 
+ */
+json_object* trace_get_records(struct client *cl, char *request)
+{
+    json_object *jobj = json_object_new_object();
+    json_object *jarray = json_object_new_array();
+    unsigned long seq;
+
+    seq = ring_seq >= TRACE_RING_SIZE ? ring_seq - TRACE_RING_SIZE + 1 : 1;
+    for (; seq && seq <= ring_seq; ++seq) {
+        struct trace_record *rec = &ring[seq % TRACE_RING_SIZE];
+        json_object *j_rec;
+
+        if (rec->seq != seq)
+            continue;
+
+        j_rec = json_object_new_object();
+        json_object_object_add(j_rec, "seq", json_object_new_int64(rec->seq));
+        json_object_object_add(j_rec, "client", json_object_new_int(rec->client));
+        json_object_object_add(j_rec, "method", json_object_new_string(http_methods[rec->method]));
+        json_object_object_add(j_rec, "url", json_object_new_string(rec->url));
+        json_object_object_add(j_rec, "status", json_object_new_int(rec->ts.status));
+        json_object_object_add(j_rec, "start_us", json_object_new_int64(rec->ts.request));
+        json_object_object_add(j_rec, "connection_us", json_object_new_int64(trace_duration(rec->ts.accept, rec->ts.request)));
+        json_object_object_add(j_rec, "parse_us", json_object_new_int64(trace_duration(rec->ts.request, rec->ts.headers)));
+        json_object_object_add(j_rec, "body_us", json_object_new_int64(trace_duration(rec->ts.headers, rec->ts.handler_start)));
+        json_object_object_add(j_rec, "handler_us", json_object_new_int64(trace_duration(rec->ts.handler_start, rec->ts.handler_end)));
+        json_object_object_add(j_rec, "write_us", json_object_new_int64(trace_duration(rec->ts.handler_end, rec->ts.flushed)));
+        json_object_object_add(j_rec, "total_us", json_object_new_int64(trace_duration(rec->ts.request, rec->ts.flushed)));
+        json_object_array_add(jarray, j_rec);
+    }
+
+    json_object_object_add(jobj, "enabled", json_object_new_boolean(conf->tracing));
+    json_object_object_add(jobj, "records", jarray);
+
+    cl->http_status = r_ok;
+    return jobj;
+}
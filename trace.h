@@ -0,0 +1,99 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   trace.h
+ * Created on October 18, 2026, 2:10 PM
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <json-c/json.h>
+
+#include "config.h"
+#include "metrics.h"
+
+struct client;
+
+#define TRACE_RING_SIZE         128             /* Number of request records kept */
+#define TRACE_URL_LEN           64              /* Maximum recorded url length */
+
+/**
+ * Timestamps of the lifecycle of a request in microseconds of the
+ * monotonic clock, zero when the point was not reached.
+ */
+struct client_trace {
+    uint64_t accept;                            /* The connection was accepted */
+    uint64_t request;                           /* The request line was parsed */
+    uint64_t headers;                           /* The request headers are complete */
+    uint64_t handler_start;                     /* The request was dispatched */
+    uint64_t handler_end;                       /* The response header was produced */
+    uint64_t flushed;                           /* The last response byte left the stream */
+    int status;                                 /* The response status code */
+};
+
+/**
+ * Mark a point in the lifecycle of a request. 
+ * @param ts the timestamp to set. 
+ */
+static inline void trace_mark(uint64_t *ts)
+{
+    if (conf->tracing)
+        *ts = metrics_now();
+}
+
+/**
+ * Record a finished request in the trace ring. When the response is still
+ * queued on the stream the record is completed by trace_flushed().
+ * @param cl the client who made the request. 
+ */
+void trace_request_done(struct client *cl);
+
+/**
+ * Complete the trace record of a client once its stream is drained. 
+ * @param cl the client whose stream was written. 
+ */
+void trace_flushed(struct client *cl);
+
+/**
+ * Format the Server-Timing header of the current request. 
+ * @param cl the client to write the response to. 
+ * @param buf the buffer to place the header line in. 
+ * @param len the size of the buffer. 
+ * @return the number of characters placed in the buffer. 
+ */
+int trace_server_timing(struct client *cl, char *buf, int len);
+
+/**
+ * Dump the trace ring, oldest record first. 
+ * @param cl the client who made the request. 
+ * @param request the request part of the url. 
+ * @return the trace records. 
+ */
+json_object* trace_get_records(struct client *cl, char *request);
+
+#endif
@@ -36,6 +36,8 @@
 
 #include "utils.h"
 #include "config.h"
+#include "timerwheel.h"
+#include "trace.h"
 
 #define UH_LIMIT_CLIENTS	64
 
@@ -95,6 +97,7 @@ enum client_state {
     CLIENT_STATE_DONE,
     CLIENT_STATE_CLOSE,
     CLIENT_STATE_CLEANUP,
+    CLIENT_STATE_UPGRADED,
 };
 
 struct interpreter {
@@ -200,10 +203,12 @@ struct client {
     struct ustream *us;
     struct ustream_fd sfd;
     struct uloop_timeout timeout;
+    struct tw_timer idle;
     int requests;
 
     enum client_state state;
     bool tls;
+    bool corked;
 
     struct http_request request;
     struct uh_addr srv_addr, peer_addr;
@@ -213,8 +218,11 @@ struct client {
     char *response;
     struct http_response http_status;
     int readidx;
-    bool ispostdata;
-    char *postdata;
+    struct json_tokener *tok;
+    struct json_object *body;
+    int body_len;
+    struct client_trace trace;
+    unsigned long trace_seq;
 };
 
 extern char uh_buf[WORKING_BUFF_SIZE];
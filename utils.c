@@ -20,6 +20,7 @@
 #include <ctype.h>
 #include "uhttpd.h"
 #include "config.h"
+#include "metrics.h"
 
 bool uh_use_chunked(struct client *cl)
 {
@@ -39,7 +40,8 @@ void uh_chunk_write(struct client *cl, const void *data, int len)
 	if (cl->state == CLIENT_STATE_CLEANUP)
 		return;
 
-	uloop_timeout_set(&cl->timeout, conf->network_timeout * 1000);
+	tw_timer_set(&cl->idle, conf->network_timeout * 1000);
+	metric_add(&metric_bytes_out, len);
 	if (chunked)
 		ustream_printf(cl->us, "%X\r\n", len);
 	ustream_write(cl->us, data, len, true);
@@ -56,15 +58,17 @@ void uh_chunk_vprintf(struct client *cl, const char *format, va_list arg)
 	if (cl->state == CLIENT_STATE_CLEANUP)
 		return;
 
-	uloop_timeout_set(&cl->timeout, conf->network_timeout * 1000);
+	tw_timer_set(&cl->idle, conf->network_timeout * 1000);
 	if (!uh_use_chunked(cl)) {
-		ustream_vprintf(cl->us, format, arg);
+		len = ustream_vprintf(cl->us, format, arg);
+		metric_add(&metric_bytes_out, len);
 		return;
 	}
 
 	va_copy(arg2, arg);
 	len = vsnprintf(buf, sizeof(buf), format, arg2);
 	va_end(arg2);
+	metric_add(&metric_bytes_out, len);
 
 	ustream_printf(cl->us, "%X\r\n", len);
 	if (len < sizeof(buf))
@@ -157,6 +161,40 @@ int uh_urlencode(char *buf, int blen, const char *src, int slen)
 	return (i == slen) ? len : -1;
 }
 
+/* blen is the size of buf; slen is the length of src. The output string
+** is null-terminated. Returns the length of the encoded string, or -1 on
+** buffer overflow. */
+int uh_b64encode(char *buf, int blen, const void *src, int slen)
+{
+	static const char b64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const unsigned char *str = src;
+	unsigned int cin;
+	int len = 0;
+	int i;
+
+	if (((slen + 2) / 3) * 4 >= blen)
+		return -1;
+
+	for (i = 0; i < slen; i += 3)
+	{
+		cin = str[i] << 16;
+		if (i + 1 < slen)
+			cin |= str[i + 1] << 8;
+		if (i + 2 < slen)
+			cin |= str[i + 2];
+
+		buf[len++] = b64[(cin >> 18) & 0x3f];
+		buf[len++] = b64[(cin >> 12) & 0x3f];
+		buf[len++] = (i + 1 < slen) ? b64[(cin >> 6) & 0x3f] : '=';
+		buf[len++] = (i + 2 < slen) ? b64[cin & 0x3f] : '=';
+	}
+
+	buf[len] = 0;
+
+	return len;
+}
+
 int uh_b64decode(char *buf, int blen, const void *src, int slen)
 {
 	const unsigned char *str = src;
@@ -0,0 +1,135 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   sha1.c
+ * Created on October 18, 2026, 9:40 AM
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sha1.h"
+
+/* Rotate a 32 bit word to the left */
+#define ROL(x, n)       (((x) << (n)) | ((x) >> (32 - (n))))
+
+/**
+ * Process one 64 byte block.
+ * @param h the hash state.
+ * @param block the block to process.
+ */
+static void sha1_block(uint32_t h[5], const uint8_t *block)
+{
+    uint32_t w[80];
+    uint32_t a, b, c, d, e, f, k, tmp;
+    int i;
+
+    for (i = 0; i < 16; ++i) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 |
+               (uint32_t) block[i * 4 + 2] << 8 | (uint32_t) block[i * 4 + 3];
+    }
+    for (i = 16; i < 80; ++i) {
+        w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+
+    for (i = 0; i < 80; ++i) {
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        tmp = ROL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL(b, 30);
+        b = a;
+        a = tmp;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/**
+ * Calculate the SHA-1 digest of a buffer. This is only used for the
+ * WebSocket handshake and not meant for large amounts of data.
+ * @param data the data to hash.
+ * @param len the length of the data.
+ * @param digest buffer receiving the digest.
+ */
+void sha1(const void *data, size_t len, uint8_t digest[SHA1_DIGEST_LEN])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    const uint8_t *p = data;
+    uint8_t block[64];
+    uint64_t bits = (uint64_t) len * 8;
+    size_t rest;
+    int i;
+
+    /* Hash all complete blocks */
+    for (; len >= 64; len -= 64, p += 64) {
+        sha1_block(h, p);
+    }
+
+    /* Pad the last block with a one bit and the message length */
+    rest = len;
+    memset(block, 0, sizeof(block));
+    memcpy(block, p, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    for (i = 0; i < 8; ++i) {
+        block[63 - i] = (uint8_t) (bits >> (i * 8));
+    }
+    sha1_block(h, block);
+
+    for (i = 0; i < 5; ++i) {
+        digest[i * 4] = (uint8_t) (h[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t) (h[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t) (h[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t) h[i];
+    }
+}
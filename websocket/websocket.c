@@ -0,0 +1,638 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   websocket.c
+ * Created on October 18, 2026, 9:40 AM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include <libubox/blobmsg.h>
+#include <json-c/json.h>
+
+#include "../uhttpd.h"
+#include "../client.h"
+#include "../logger.h"
+#include "../events/events.h"
+#include "../gpio/gpio.h"
+#include "../gpio/gpio_json_api.h"
+#include "sha1.h"
+#include "websocket.h"
+
+/* The GUID appended to the client key, see RFC 6455 */
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/**
+ * A client connected over a WebSocket
+ */
+struct ws_client {
+    struct event_subscriber sub;        /* The event bus subscription */
+    struct tw_timer ping;               /* Timer sending ping frames */
+    struct client *cl;                  /* The client owning the socket */
+    bool subscribed;                    /* The subscription is active */
+    bool alive;                         /* Data was received since the last ping */
+    bool closing;                       /* A close frame was sent */
+    int opcode;                         /* Opcode of the message being reassembled */
+    int msg_len;                        /* Length of the message being reassembled */
+    char msg[WS_MAX_MESSAGE + 1];       /* The message being reassembled */
+    int frame_len;                      /* Bytes received of the frame being read */
+    uint8_t frame[14 + WS_MAX_PAYLOAD]; /* The frame being read, header included */
+};
+
+/**
+ * Write a frame header. Frames sent by the server are never masked.
+ * @param us the stream to write to.
+ * @param opcode the frame opcode.
+ * @param len the length of the payload following the header.
+ */
+static void ws_write_header(struct ustream *us, int opcode, size_t len)
+{
+    uint8_t hdr[10];
+    int hlen = 2;
+    int i;
+
+    hdr[0] = 0x80 | opcode;
+    if (len < 126) {
+        hdr[1] = len;
+    } else if (len <= 0xffff) {
+        hdr[1] = 126;
+        hdr[2] = len >> 8;
+        hdr[3] = len & 0xff;
+        hlen = 4;
+    } else {
+        /* 64-bit length in network byte order */
+        hdr[1] = 127;
+        for (i = 0; i < 8; ++i)
+            hdr[2 + i] = (uint64_t) len >> (56 - 8 * i);
+        hlen = 10;
+    }
+
+    ustream_write(us, (char*) hdr, hlen, true);
+}
+
+/**
+ * Send a complete frame.
+ * @param ws the WebSocket client.
+ * @param opcode the frame opcode.
+ * @param data the payload.
+ * @param len the length of the payload.
+ */
+static void ws_send(struct ws_client *ws, int opcode, const char *data, size_t len)
+{
+    ws_write_header(ws->cl->us, opcode, len);
+    if (len) {
+        ustream_write(ws->cl->us, data, len, false);
+    }
+}
+
+/**
+ * Send a JSON object as text frame, the reference is released.
+ * @param ws the WebSocket client.
+ * @param jobj the object to send.
+ */
+static void ws_send_json(struct ws_client *ws, json_object *jobj)
+{
+    const char *str = json_object_to_json_string(jobj);
+
+    ws_send(ws, WS_OP_TEXT, str, strlen(str));
+    json_object_put(jobj);
+}
+
+/**
+ * Send a close frame and close the connection when it is written.
+ * @param ws the WebSocket client.
+ * @param code the close status code.
+ */
+static void ws_close(struct ws_client *ws, int code)
+{
+    char payload[2] = { code >> 8, code & 0xff };
+
+    if (ws->closing)
+        return;
+
+    ws->closing = true;
+    ws_send(ws, WS_OP_CLOSE, payload, 2);
+    close_connection(ws->cl);
+}
+
+/**
+ * Deliver an event to a subscribed socket.
+ * @param sub the subscription of the socket.
+ * @param ev the event to send.
+ */
+static void ws_send_event(struct event_subscriber *sub, const struct event *ev)
+{
+    struct ws_client *ws = container_of(sub, struct ws_client, sub);
+    struct ustream *us = ws->cl->us;
+    char prefix[64];
+    int plen;
+
+    if (ws->closing || ws->cl->state != CLIENT_STATE_UPGRADED)
+        return;
+
+    /* Drop events for clients that do not keep up */
+    if (ustream_pending_data(us, true) > WS_MAX_PENDING)
+        return;
+
+    plen = snprintf(prefix, sizeof(prefix), "{\"event\":\"%s\",\"seq\":%u,\"data\":",
+            events_topic_name(ev->topic), ev->id);
+
+    ws_write_header(us, WS_OP_TEXT, plen + ev->len + 1);
+    ustream_write(us, prefix, plen, true);
+    ustream_write(us, ev->data, ev->len, true);
+    ustream_write(us, "}", 1, false);
+}
+
+/**
+ * Get an integer member of a command.
+ * @param cmd the command object.
+ * @param key the member name.
+ * @param value receives the member value.
+ * @return true when the member exists.
+ */
+static bool ws_get_int(json_object *cmd, const char *key, int *value)
+{
+    json_object *j_val;
+
+    if (!json_object_object_get_ex(cmd, key, &j_val))
+        return false;
+
+    *value = json_object_get_int(j_val);
+    return true;
+}
+
+/**
+ * Execute a command message.
+ * @param ws the WebSocket client.
+ * @param msg the message, null terminated.
+ */
+static void ws_handle_message(struct ws_client *ws, const char *msg)
+{
+    json_object *cmd = json_tokener_parse(msg);
+    json_object *reply = json_object_new_object();
+    json_object *j_op, *j_id, *j_topics;
+    const char *op = NULL;
+    const char *error = NULL;
+    int pin, state, ms, mode = GPIO_ACT_HIGH;
+
+    if (cmd && json_object_object_get_ex(cmd, "op", &j_op))
+        op = json_object_get_string(j_op);
+
+    if (cmd && json_object_object_get_ex(cmd, "id", &j_id))
+        json_object_object_add(reply, "id", json_object_get(j_id));
+
+    if (op == NULL) {
+        error = "Malformed command";
+    } else if (!strcmp(op, "set")) {
+        if (!ws_get_int(cmd, "pin", &pin) || !ws_get_int(cmd, "state", &state)) {
+            error = "Expected pin and state";
+        } else if (!gpio_write_and_close(pin, state ? GPIO_HIGH : GPIO_LOW)) {
+            error = "Could not set pin";
+        } else {
+            gpio_publish_change(pin, "state", state ? GPIO_HIGH : GPIO_LOW);
+        }
+    } else if (!strcmp(op, "get")) {
+        if (!ws_get_int(cmd, "pin", &pin)) {
+            error = "Expected pin";
+        } else if ((state = gpio_read_and_close(pin)) < 0 || state == GPIO_ERR) {
+            error = "Could not read pin";
+        } else {
+            json_object_object_add(reply, "pin", json_object_new_int(pin));
+            json_object_object_add(reply, "state", json_object_new_int(state));
+        }
+    } else if (!strcmp(op, "pulse")) {
+        ws_get_int(cmd, "mode", &mode);
+        if (!ws_get_int(cmd, "pin", &pin) || !ws_get_int(cmd, "ms", &ms) || ms <= 0) {
+            error = "Expected pin and ms";
+        } else if (!gpio_pulse(pin, ms * 1000, mode)) {
+            error = "Could not pulse pin";
+        }
+    } else if (!strcmp(op, "subscribe")) {
+        ws->sub.topics = EVENT_TOPIC_ALL;
+        if (json_object_object_get_ex(cmd, "topics", &j_topics))
+            ws->sub.topics = events_parse_topics(json_object_get_string(j_topics));
+
+        if (!ws->sub.topics) {
+            error = "Unknown event topic";
+        } else if (!ws->subscribed) {
+            events_subscribe(&ws->sub);
+            ws->subscribed = true;
+        }
+    } else if (!strcmp(op, "unsubscribe")) {
+        if (ws->subscribed) {
+            events_unsubscribe(&ws->sub);
+            ws->subscribed = false;
+        }
+    } else {
+        error = "Unknown command";
+    }
+
+    json_object_object_add(reply, "ok", json_object_new_boolean(error == NULL));
+    if (error)
+        json_object_object_add(reply, "error", json_object_new_string(error));
+
+    ws_send_json(ws, reply);
+    if (cmd)
+        json_object_put(cmd);
+}
+
+/**
+ * Check that a text message is valid UTF-8. Overlong forms, surrogates
+ * and code points above U+10FFFF are refused, see RFC 3629.
+ * @param data the message.
+ * @param len the length of the message.
+ * @return true when the message is valid.
+ */
+static bool ws_utf8_valid(const uint8_t *data, int len)
+{
+    uint32_t cp;
+    int i = 0, n, j;
+
+    while (i < len) {
+        if (data[i] < 0x80) {
+            i++;
+            continue;
+        } else if ((data[i] & 0xe0) == 0xc0) {
+            n = 1;
+            cp = data[i] & 0x1f;
+        } else if ((data[i] & 0xf0) == 0xe0) {
+            n = 2;
+            cp = data[i] & 0x0f;
+        } else if ((data[i] & 0xf8) == 0xf0) {
+            n = 3;
+            cp = data[i] & 0x07;
+        } else {
+            return false;
+        }
+
+        /* The continuation bytes must all be there */
+        if (i + n >= len)
+            return false;
+
+        for (j = 1; j <= n; ++j) {
+            if ((data[i + j] & 0xc0) != 0x80)
+                return false;
+            cp = (cp << 6) | (data[i + j] & 0x3f);
+        }
+
+        /* The shortest form only, no surrogates and nothing past Unicode */
+        if ((n == 1 && cp < 0x80) || (n == 2 && cp < 0x800) || (n == 3 && cp < 0x10000) ||
+            (cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff)
+            return false;
+
+        i += n + 1;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a complete frame.
+ * @param ws the WebSocket client.
+ * @param fin true when this is the last frame of the message.
+ * @param opcode the frame opcode.
+ * @param data the unmasked payload.
+ * @param len the length of the payload.
+ */
+static void ws_handle_frame(struct ws_client *ws, bool fin, int opcode, const char *data, int len)
+{
+    int code = WS_CLOSE_NORMAL;
+
+    /* Control frames can be sent in between fragments */
+    if (opcode & 0x8) {
+        if (!fin || len > 125) {
+            ws_close(ws, WS_CLOSE_PROTOCOL);
+            return;
+        }
+
+        switch (opcode) {
+        case WS_OP_CLOSE:
+            if (len >= 2)
+                code = ((uint8_t) data[0] << 8) | (uint8_t) data[1];
+            ws_close(ws, code);
+            break;
+        case WS_OP_PING:
+            ws_send(ws, WS_OP_PONG, data, len);
+            break;
+        case WS_OP_PONG:
+            break;
+        default:
+            ws_close(ws, WS_CLOSE_PROTOCOL);
+            break;
+        }
+        return;
+    }
+
+    /* Data frames start or continue a message */
+    if (opcode == WS_OP_CONTINUATION) {
+        if (!ws->opcode) {
+            ws_close(ws, WS_CLOSE_PROTOCOL);
+            return;
+        }
+    } else if (ws->opcode) {
+        ws_close(ws, WS_CLOSE_PROTOCOL);
+        return;
+    } else {
+        ws->opcode = opcode;
+        ws->msg_len = 0;
+    }
+
+    if (ws->msg_len + len > WS_MAX_MESSAGE) {
+        ws_close(ws, WS_CLOSE_TOO_BIG);
+        return;
+    }
+
+    memcpy(ws->msg + ws->msg_len, data, len);
+    ws->msg_len += len;
+
+    if (!fin)
+        return;
+
+    ws->msg[ws->msg_len] = 0;
+    if (ws->opcode == WS_OP_TEXT) {
+        if (!ws_utf8_valid((uint8_t*) ws->msg, ws->msg_len)) {
+            ws_close(ws, WS_CLOSE_INVALID_DATA);
+            return;
+        }
+        ws_handle_message(ws, ws->msg);
+    } else {
+        ws_close(ws, WS_CLOSE_UNSUPPORTED);
+    }
+    ws->opcode = 0;
+}
+
+/**
+ * Parse frames received from the client. The bytes are copied into the
+ * frame buffer as they arrive, so a frame split over several reads or
+ * stream buffers is completed by the next call.
+ * @param cl the client who sent the data.
+ * @param data the received data.
+ * @param len the length of the received data.
+ * @return the number of bytes handled, 0 when reading is blocked.
+ */
+static int ws_data_send(struct client *cl, const char *data, int len)
+{
+    struct ws_client *ws = cl->dispatch.req_data;
+    uint8_t *buf = ws->frame;
+    uint64_t plen;
+    bool full;
+    int used = 0;
+    int hlen, need, n, i;
+
+    /* Ignore everything after a close frame */
+    if (ws->closing)
+        return len;
+
+    /* The replies are not written yet, leave the rest in the stream */
+    if (ustream_read_blocked(cl->us))
+        return 0;
+
+    while (used < len && !ws->closing) {
+        /* Work out how much of the frame is needed from what is known */
+        need = 2;
+        hlen = 2;
+        plen = 0;
+        full = false;
+        if (ws->frame_len >= 2) {
+            /* Reserved bits are not used without extensions, clients must mask */
+            if ((buf[0] & 0x70) || !(buf[1] & 0x80)) {
+                ws_close(ws, WS_CLOSE_PROTOCOL);
+                return len;
+            }
+
+            plen = buf[1] & 0x7f;
+            hlen = plen == 126 ? 4 : plen == 127 ? 10 : 2;
+            need = hlen;
+
+            if (ws->frame_len >= hlen) {
+                if (hlen == 4) {
+                    plen = (buf[2] << 8) | buf[3];
+                } else if (hlen == 10) {
+                    plen = 0;
+                    for (i = 2; i < 10; ++i)
+                        plen = (plen << 8) | buf[i];
+                }
+
+                if (plen > WS_MAX_PAYLOAD) {
+                    ws_close(ws, WS_CLOSE_TOO_BIG);
+                    return len;
+                }
+
+                need = hlen + 4 + plen;
+                full = true;
+            }
+        }
+
+        n = need - ws->frame_len;
+        if (n > len - used)
+            n = len - used;
+        memcpy(buf + ws->frame_len, data + used, n);
+        ws->frame_len += n;
+        used += n;
+
+        if (!full || ws->frame_len < need)
+            continue;
+
+        /* Unmask the payload in place */
+        for (i = 0; i < plen; ++i)
+            buf[hlen + 4 + i] ^= buf[hlen + (i & 3)];
+
+        ws->frame_len = 0;
+        ws->alive = true;
+        ws_handle_frame(ws, buf[0] & 0x80, buf[0] & 0x0f, (char*) buf + hlen + 4, plen);
+
+        /* Stop reading commands until the replies are written */
+        if (ustream_pending_data(cl->us, true) > WS_MAX_PENDING) {
+            ustream_set_read_blocked(cl->us, true);
+            break;
+        }
+    }
+
+    return ws->closing ? len : used;
+}
+
+/**
+ * Resume reading when the output buffer drained.
+ * @param cl the client owning the socket.
+ */
+static void ws_write_cb(struct client *cl)
+{
+    if (!ustream_read_blocked(cl->us) ||
+        ustream_pending_data(cl->us, true) > WS_MAX_PENDING / 2)
+        return;
+
+    ustream_set_read_blocked(cl->us, false);
+
+    /* Handle the commands which were buffered in the meantime */
+    read_from_client(cl);
+}
+
+/**
+ * Send a ping and close the connection when the previous one was not
+ * answered.
+ * @param timeout the ping timer.
+ */
+static void ws_ping(struct tw_timer *timeout)
+{
+    struct ws_client *ws = container_of(timeout, struct ws_client, ping);
+
+    if (ws->closing || ws->cl->state != CLIENT_STATE_UPGRADED)
+        return;
+
+    if (!ws->alive) {
+        log_message(LOG_DEBUG, "WebSocket client %d did not answer ping\r\n", ws->cl->id);
+        ws_close(ws, WS_CLOSE_NORMAL);
+        return;
+    }
+
+    ws->alive = false;
+    ws_send(ws, WS_OP_PING, NULL, 0);
+    tw_timer_set(timeout, WS_PING_TIME);
+}
+
+/**
+ * Free the socket when the client goes away.
+ * @param cl the client owning the socket.
+ */
+static void ws_free(struct client *cl)
+{
+    struct ws_client *ws = cl->dispatch.req_data;
+
+    if (ws->subscribed)
+        events_unsubscribe(&ws->sub);
+    tw_timer_cancel(&ws->ping);
+    free(ws);
+    cl->dispatch.req_data = NULL;
+}
+
+/**
+ * Check if a comma separated header value holds a token.
+ * @param value the header value.
+ * @param token the token, compared without case.
+ * @return true when the token is in the list.
+ */
+static bool ws_has_token(const char *value, const char *token)
+{
+    size_t len = strlen(token);
+    size_t n;
+
+    while (*value) {
+        value += strspn(value, " \t,");
+        n = strcspn(value, ",");
+        while (n > 0 && (value[n - 1] == ' ' || value[n - 1] == '\t'))
+            n--;
+
+        if (n == len && !strncasecmp(value, token, len))
+            return true;
+
+        value += strcspn(value, ",");
+    }
+
+    return false;
+}
+
+/**
+ * Upgrade the connection to a WebSocket.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return true when the response was handled.
+ */
+bool websocket_handle_request(struct client *cl, char *request)
+{
+    enum {
+        HDR_UPGRADE,
+        HDR_CONNECTION,
+        HDR_KEY,
+        HDR_VERSION,
+        __HDR_MAX,
+    };
+    static const struct blobmsg_policy hdr_policy[__HDR_MAX] = {
+        [HDR_UPGRADE] = { "upgrade", BLOBMSG_TYPE_STRING },
+        [HDR_CONNECTION] = { "connection", BLOBMSG_TYPE_STRING },
+        [HDR_KEY] = { "sec-websocket-key", BLOBMSG_TYPE_STRING },
+        [HDR_VERSION] = { "sec-websocket-version", BLOBMSG_TYPE_STRING },
+    };
+    struct blob_attr *tb[__HDR_MAX];
+    struct ws_client *ws;
+    char key[128];
+    char accept[32];
+    uint8_t digest[SHA1_DIGEST_LEN];
+    int len;
+
+    blobmsg_parse(hdr_policy, __HDR_MAX, tb, blob_data(cl->hdr.head), blob_len(cl->hdr.head));
+
+    if (!tb[HDR_UPGRADE] || strcasecmp(blobmsg_data(tb[HDR_UPGRADE]), "websocket") || !tb[HDR_KEY] ||
+        !tb[HDR_CONNECTION] || !ws_has_token(blobmsg_data(tb[HDR_CONNECTION]), "upgrade")) {
+        client_send_error(cl, 400, "Bad Request", "Expected a WebSocket upgrade");
+        return true;
+    }
+
+    if (!tb[HDR_VERSION] || strcmp(blobmsg_data(tb[HDR_VERSION]), "13")) {
+        client_send_error(cl, 426, "Upgrade Required", "Only WebSocket version 13 is supported");
+        return true;
+    }
+
+    /* The accept key is the base64 encoded SHA-1 of the key and GUID */
+    len = snprintf(key, sizeof(key), "%s" WS_GUID, (char*) blobmsg_data(tb[HDR_KEY]));
+    if (len >= sizeof(key)) {
+        client_send_error(cl, 400, "Bad Request", "Invalid WebSocket key");
+        return true;
+    }
+    sha1(key, len, digest);
+    uh_b64encode(accept, sizeof(accept), digest, SHA1_DIGEST_LEN);
+
+    ws = calloc(1, sizeof(*ws));
+    if (ws == NULL) {
+        client_send_error(cl, 500, "Internal Server Error", NULL);
+        return true;
+    }
+
+    ustream_printf(cl->us, "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+
+    /* The ping timer replaces the idle timer */
+    tw_timer_cancel(&cl->idle);
+    cl->state = CLIENT_STATE_UPGRADED;
+
+    ws->cl = cl;
+    ws->alive = true;
+    ws->sub.cb = ws_send_event;
+    ws->ping.cb = ws_ping;
+    tw_timer_set(&ws->ping, WS_PING_TIME);
+
+    cl->dispatch.data_send = ws_data_send;
+    cl->dispatch.write_cb = ws_write_cb;
+    cl->dispatch.req_data = ws;
+    cl->dispatch.req_free = ws_free;
+
+    log_message(LOG_DEBUG, "Client %d upgraded to WebSocket\r\n", cl->id);
+    return true;
+}
@@ -0,0 +1,73 @@
+/* 
+ * Copyright (c) 2014, Daan Pape
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     1. Redistributions of source code must retain the above copyright 
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     2. Redistributions in binary form must reproduce the above copyright 
+ *        notice, this list of conditions and the following disclaimer in the 
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * File:   websocket.h
+ * Created on October 18, 2026, 9:40 AM
+ */
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stdbool.h>
+#include "../uhttpd.h"
+
+#define WS_MAX_PAYLOAD          2048            /* Largest accepted frame payload */
+#define WS_MAX_MESSAGE          4096            /* Largest accepted (fragmented) message */
+#define WS_MAX_PENDING          65536           /* Stop reading when this much output is pending */
+#define WS_PING_TIME            30000           /* Milliseconds between ping frames */
+
+/* Frame opcodes */
+#define WS_OP_CONTINUATION      0x0
+#define WS_OP_TEXT              0x1
+#define WS_OP_BINARY            0x2
+#define WS_OP_CLOSE             0x8
+#define WS_OP_PING              0x9
+#define WS_OP_PONG              0xA
+
+/* Close status codes */
+#define WS_CLOSE_NORMAL         1000
+#define WS_CLOSE_PROTOCOL       1002
+#define WS_CLOSE_UNSUPPORTED    1003
+#define WS_CLOSE_INVALID_DATA   1007
+#define WS_CLOSE_TOO_BIG        1009
+
+/**
+ * Upgrade the connection to a WebSocket. Every text message is a JSON
+ * command with an "op" member, an optional "id" member is echoed in the
+ * reply:
+ *   {"op":"set","pin":7,"state":1}
+ *   {"op":"get","pin":7}
+ *   {"op":"pulse","pin":7,"ms":100,"mode":1}
+ *   {"op":"subscribe","topics":"gpio,rfid"}
+ *   {"op":"unsubscribe"}
+ * Subscribed events are sent as {"event":"gpio","seq":1,"data":{...}}.
+ * @param cl the client who made the request.
+ * @param request the request part of the url.
+ * @return true when the response was handled.
+ */
+bool websocket_handle_request(struct client *cl, char *request);
+
+#endif
@@ -702,6 +702,7 @@ void nl_wifi_start_edit(struct nl_wifi_network_list *w_list)
     
     w_list->list = NULL;
     w_list->editing = true;
+    w_list->version++;
     
     pthread_mutex_unlock(&(w_list->lock));
 }
@@ -739,6 +740,7 @@ void nl_wifi_list_stop_edit(struct nl_wifi_network_list *w_list)
 {
     pthread_mutex_lock(&(w_list->lock));
     w_list->editing = false;
+    w_list->version++;
     pthread_mutex_unlock(&(w_list->lock));    
 }
 
@@ -79,6 +79,7 @@ struct nl_wifi_network {
 struct nl_wifi_network_list {
     pthread_mutex_t lock;
     bool editing;
+    unsigned int version;       /* Changes whenever the list or editing state changes */
     struct nl_wifi_network *list;
 };
 
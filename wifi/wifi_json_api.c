@@ -37,6 +37,7 @@
 #include <pthread.h>
 
 #include "../uhttpd.h"
+#include "../client.h"
 #include "../logger.h"
 #include "../api.h"
 #include "../helper.h"
@@ -166,6 +167,21 @@ json_object* wifi_get_scan(struct client *cl, char *request)
     return result;
 }
 
+/**
+ * Get the version of the wifi scan response. 
+ * @return a counter that changes whenever the scan results change.
+ */
+unsigned int wifi_scan_version(void)
+{
+    unsigned int version;
+    
+    pthread_mutex_lock(&(wifi_list.lock));
+    version = wifi_list.version;
+    pthread_mutex_unlock(&(wifi_list.lock));
+    
+    return version;
+}
+
 /**
  * Entry point for the WiFi network scan thread
  * @param args the thread arguments
@@ -283,7 +299,7 @@ json_object* wifi_get_info(struct client *cl, char *request)
 json_object* wifi_post_connect(struct client *cl, char *request)
 {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_ssid = NULL;
     json_object *j_security = NULL;
@@ -346,7 +362,7 @@ json_object* wifi_post_connect(struct client *cl, char *request)
 json_object* wifi_post_ssid_change(struct client *cl, char *request) 
 {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_network = NULL;
     json_object *j_ssid = NULL;
@@ -395,7 +411,7 @@ json_object* wifi_post_ssid_change(struct client *cl, char *request)
 json_object* wifi_post_state_change(struct client *cl, char *request)
 {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_network = NULL;
     json_object *j_state = NULL;
@@ -468,7 +484,7 @@ error:
 json_object* wifi_post_simplesettings_change(struct client *cl, char *request)
 {
     /* Parse JSON post data */
-    json_object *in_obj = json_tokener_parse(cl->postdata);
+    json_object *in_obj = client_get_json_body(cl);
     
     json_object *j_network = NULL;
     json_object *j_ssid = NULL;
@@ -67,6 +67,12 @@ json_object* wifi_post_router(struct client *cl, char *request);
  */
 json_object* wifi_get_scan(struct client *cl, char *request);
 
+/**
+ * Get the version of the wifi scan response. 
+ * @return a counter that changes whenever the scan results change.
+ */
+unsigned int wifi_scan_version(void);
+
 /**
  * Request a WiFi scan, this will go async, and return immediately. 
  * @param cl the client who made the request. 
@@ -37,6 +37,7 @@
 #include "wifi_longrunner.h"
 #include "wifi.h"
 #include "wifi_json_api.h"
+#include "../events/events.h"
 
 #define WIFI_ERR_TIME   30              /* Number of seconds the client WiFi can be down */
 #define WIFI_RETRY_TIME 180             /* Number of seconds before WiFi will retry to connect */ 
@@ -46,6 +47,23 @@ time_t bad_conn_start;                  /* Start of bad WiFi connection time, on
 bool new_wifi_attempt = false;          /* External bool from wifi.h */
 bool clear_new_wifi_command = false;    /* External bool from wifi.h */  
 bool marked_for_restart = false;        /* If try the WiFi connection will try to recover after timeout */
+static const char* last_state = NULL;   /* The last published client WiFi state */
+
+/**
+ * Publish the client WiFi state when it changed.
+ * @param state the current client WiFi state.
+ */
+static void wifi_longrunner_publish_state(const char* state)
+{
+    if(state == last_state) {
+        return;
+    }
+    last_state = state;
+    
+    json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "state", json_object_new_string(state));
+    events_publish(EVENT_TOPIC_WIFI, jobj);
+}
 
 /**
  * The WiFi longrunner initializer
@@ -83,6 +101,7 @@ void wifi_longrunner_entrypoint(void)
                     wifi_set_state(UCI_CLIENT_WIFI, false);
                     wifi_restart();
                     log_message(LOG_INFO, "Disabled client WiFi connection because of bad connection\r\n");
+                    wifi_longrunner_publish_state("disabled");
                     
                     if(!new_wifi_attempt) {
                         /* This is not a new client WiFi connection attempt, try to restore connection after timeout */
@@ -101,10 +120,12 @@ void wifi_longrunner_entrypoint(void)
                 bad_connection = true;
                 clear_new_wifi_command = true;
                 log_message(LOG_DEBUG, "Marked client WiFi connection as bad\r\n");
+                wifi_longrunner_publish_state("bad");
             }
         } else {
             log_message(LOG_DEBUG, "Client WiFi network is connected\r\n");
             bad_connection = false;
+            wifi_longrunner_publish_state("connected");
             
             if(clear_new_wifi_command) {
                 new_wifi_attempt = false;
@@ -113,6 +134,7 @@ void wifi_longrunner_entrypoint(void)
     } else {
         log_message(LOG_INFO, "Client WiFi interface is disabled\r\n");
         bad_connection = false;
+        wifi_longrunner_publish_state("disabled");
         
         if(marked_for_restart) {
             double diff = difftime(time(NULL), bad_conn_start);
@@ -120,6 +142,7 @@ void wifi_longrunner_entrypoint(void)
                 wifi_set_state(UCI_CLIENT_WIFI, true);
                 wifi_restart();
                 log_message(LOG_INFO, "Attempted to reconnect client WiFi connection\r\n");
+                wifi_longrunner_publish_state("reconnecting");
             } else {
                 log_message(LOG_DEBUG, "WiFi marked for restart in %.2f seconds\r\n", WIFI_RETRY_TIME - diff);
             }